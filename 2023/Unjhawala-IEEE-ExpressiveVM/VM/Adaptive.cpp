@@ -0,0 +1,409 @@
+#include <iostream>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include "Adaptive.h"
+#include "Simulator.h"
+#include "../utils.h"
+
+using namespace EightDOF;
+
+/*
+Code for the adaptive integrator. The right hand side is put together from the same pieces
+the fixed step functions use - tireSlip/tireForceRates for the tires, powertrainRates for the
+drive line and vehAccelerations for the chassis - so both integrate the same model, but for
+the switches at standstill, which are smoothed over _omegaSmooth and _uSmooth
+*/
+
+// Rosenbrock 2(3) constants (Shampine and Reichelt, the ode23s method)
+static const double ROS_D = 1. / (2. + std::sqrt(2.));
+static const double ROS_E32 = 6. + std::sqrt(2.);
+
+// LU factorization with partial pivoting of the n x n row major matrix a, in place. Returns
+// false if a is singular, the factors are of no use then
+static bool luFactor(double* a, int* piv, int n){
+    for(int k = 0; k < n; k++){
+        int p = k;
+        for(int i = k + 1; i < n; i++){
+            if(std::abs(a[i*n + k]) > std::abs(a[p*n + k])){
+                p = i;
+            }
+        }
+        piv[k] = p;
+        if(p != k){
+            for(int j = 0; j < n; j++){
+                std::swap(a[k*n + j], a[p*n + j]);
+            }
+        }
+        if(!(a[k*n + k] != 0.)){
+            return false;
+        }
+        for(int i = k + 1; i < n; i++){
+            double l = a[i*n + k] / a[k*n + k];
+            a[i*n + k] = l;
+            for(int j = k + 1; j < n; j++){
+                a[i*n + j] -= l * a[k*n + j];
+            }
+        }
+    }
+    return true;
+}
+
+// solves a x = b with the factors from luFactor, b is overwritten with x. luFactor swaps whole
+// rows, so the multipliers are in the order of the last swap and b has to be in it too before
+// the forward substitution
+static void luSolve(const double* a, const int* piv, int n, double* b){
+    for(int k = 0; k < n; k++){
+        std::swap(b[k], b[piv[k]]);
+    }
+    for(int k = 0; k < n; k++){
+        for(int i = k + 1; i < n; i++){
+            b[i] -= a[i*n + k] * b[k];
+        }
+    }
+    for(int k = n - 1; k >= 0; k--){
+        for(int j = k + 1; j < n; j++){
+            b[k] -= a[k*n + j] * b[j];
+        }
+        b[k] /= a[k*n + k];
+    }
+}
+
+AdaptiveSimulator::AdaptiveSimulator() : _controls(4, 0.), _time(0.), _h(1e-3), _cursor(0) {}
+
+AdaptiveSimulator::AdaptiveSimulator(const VehicleParam& v_params, const TMeasyParam& t_params, const AdaptiveParam& a_params)
+    : _controls(4, 0.), _time(0.), _h(1e-3), _cursor(0) {
+    init(v_params, t_params, a_params);
+}
+
+void AdaptiveSimulator::init(const VehicleParam& v_params, const TMeasyParam& t_params, const AdaptiveParam& a_params){
+    _v_params = v_params;
+    _t_params = t_params;
+    _a_params = a_params;
+    mapsInit(_v_params);
+    tireInit(_t_params);
+    reset();
+}
+
+void AdaptiveSimulator::reset(){
+    _v_states = VehicleState();
+    vehInit(_v_states, _v_params);
+    for(int i = 0; i < 4; i++){
+        _tires[i] = TMeasyState();
+    }
+    _time = 0.;
+    _h = _a_params._hInit;
+    _cursor = 0;
+    _jacAge = _a_params._jacReuse;
+    _stats = AdaptiveStats();
+}
+
+double AdaptiveSimulator::getOutput(int channel) const{
+    return EightDOF::getOutput(channel, _time, _v_states, _tires);
+}
+
+void AdaptiveSimulator::pack(double* y) const{
+    y[0] = _v_states._x;
+    y[1] = _v_states._y;
+    y[2] = _v_states._u;
+    y[3] = _v_states._v;
+    y[4] = _v_states._psi;
+    y[5] = _v_states._phi;
+    y[6] = _v_states._wx;
+    y[7] = _v_states._wz;
+    for(int i = 0; i < 4; i++){
+        y[8 + i] = _tires[i]._xe;
+        y[12 + i] = _tires[i]._ye;
+        y[16 + i] = _tires[i]._omega;
+    }
+    y[20] = _v_states._crankOmega;
+}
+
+void AdaptiveSimulator::unpack(const double* y, VehicleState& v_states, TMeasyState* tires) const{
+    // gear, vertical forces and everything else not integrated come from the current state
+    v_states = _v_states;
+    v_states._x = y[0];
+    v_states._y = y[1];
+    v_states._u = y[2];
+    v_states._v = y[3];
+    v_states._psi = y[4];
+    v_states._phi = y[5];
+    v_states._wx = y[6];
+    v_states._wz = y[7];
+    for(int i = 0; i < 4; i++){
+        tires[i] = _tires[i];
+        tires[i]._xe = y[8 + i];
+        tires[i]._ye = y[12 + i];
+        tires[i]._omega = y[16 + i];
+    }
+    v_states._crankOmega = y[20];
+}
+
+void AdaptiveSimulator::rhs(double t, const double* y, double* dy, const std::vector<Entry>& driverData){
+    _stats._rhsEvals++;
+
+    unpack(y, _work_v, _work_tires);
+    getControls(_controls.data(), driverData, t);
+
+    // tire frame velocities and the vertical forces
+    vehToTireTransform(_work_tires[0], _work_tires[1], _work_tires[2], _work_tires[3], _work_v, _v_params, _controls);
+
+    // rear tires do not take the steering
+    double delta_front = steerAngle(_v_params, _controls[1]);
+    double delta_rear = steerAngle(_v_params, 0.);
+    for(int i = 0; i < 4; i++){
+        TireSlip slip;
+        tireSlip(slip, _work_tires[i], _t_params, i < 2 ? delta_front : delta_rear);
+        tireForceRates(_work_tires[i], _t_params, slip);
+        dy[8 + i] = _work_tires[i]._xedot;
+        dy[12 + i] = _work_tires[i]._yedot;
+    }
+
+    // drive line - the tire forces are still in the tire frame here
+    double dOmega[4];
+    double shaft_speed;
+    double dOmega_crank = powertrainRates(_work_v, _work_tires[0], _work_tires[1], _work_tires[2], _work_tires[3],
+                                            _v_params, _t_params, _controls[2], _controls[3], dOmega, shaft_speed);
+    // a negative drive torque is dropped once the vehicle stands (u < 1e-9) - blended in over
+    // _uSmooth around u = 0 instead. Nothing else in the drive line depends on u, so the end
+    // points are the drive line evaluated with the vehicle rolling (u = 1) and standing (u = 0)
+    double u = _work_v._u;
+    if(std::abs(u) < 20. * _a_params._uSmooth){
+        VehicleState v = _work_v;
+        TMeasyState tires[4] = {_work_tires[0], _work_tires[1], _work_tires[2], _work_tires[3]};
+        double rolling[4], standing[4];
+        v._u = 1.;
+        powertrainRates(v, tires[0], tires[1], tires[2], tires[3], _v_params, _t_params, _controls[2], _controls[3],
+                        rolling, shaft_speed);
+        v._u = 0.;
+        powertrainRates(v, tires[0], tires[1], tires[2], tires[3], _v_params, _t_params, _controls[2], _controls[3],
+                        standing, shaft_speed);
+        double weight = 0.5 * (1. + std::tanh(u / _a_params._uSmooth));
+        for(int i = 0; i < 4; i++){
+            dOmega[i] = standing[i] + weight * (rolling[i] - standing[i]);
+        }
+    }
+    // the brake and the rolling resistance act against sgn(omega) - replaced by a smooth sign,
+    // as their switch at standstill makes every step around it fail the error test
+    double brake = brakeTorque(_v_params, _controls[3]);
+    for(int i = 0; i < 4; i++){
+        double omega = _work_tires[i]._omega;
+        double smooth = std::tanh(omega / _a_params._omegaSmooth);
+        // rolling resistance torque of tireSlip without the sign
+        double roll = _t_params._rr * std::min(_work_tires[i]._fz, _t_params._pnmax) * _work_tires[i]._rStat;
+        _work_tires[i]._My = -roll * smooth;
+        dy[16 + i] = dOmega[i] + (sgn(omega) - smooth) * (brake + roll) / _t_params._jw;
+    }
+    // without a torque converter the crank speed is not a state, powertrainRates sets it
+    dy[20] = _v_params._tcbool ? dOmega_crank : 0.;
+
+    // chassis
+    tireToVehTransform(_work_tires[0], _work_tires[1], _work_tires[2], _work_tires[3], _work_v, _v_params, _controls);
+    double fx[4], fy[4];
+    for(int i = 0; i < 4; i++){
+        fx[i] = _work_tires[i]._fx;
+        fy[i] = _work_tires[i]._fy;
+    }
+    vehAccelerations(_work_v, _v_params, fx, fy);
+
+    dy[0] = _work_v._u * std::cos(_work_v._psi) - _work_v._v * std::sin(_work_v._psi);
+    dy[1] = _work_v._u * std::sin(_work_v._psi) + _work_v._v * std::cos(_work_v._psi);
+    dy[2] = _work_v._udot;
+    dy[3] = _work_v._vdot;
+    dy[4] = _work_v._wz;
+    dy[5] = _work_v._wx;
+    dy[6] = _work_v._wxdot;
+    dy[7] = _work_v._wzdot;
+}
+
+void AdaptiveSimulator::events(const double* y, double* g) const{
+    int gr = _v_states._current_gr;
+    int top = _v_params._gearRatios.size() - 1;
+    int bottom = _v_params._tcbool ? 0 : 1; // same limits as gearShift
+
+    // both drive lines shift on the mean wheel speed through the gear box
+    double shaft_speed = 0.25 * (y[16] + y[17] + y[18] + y[19]) / _v_params._gearRatios[gr];
+
+    g[0] = (gr < top) ? shaft_speed - _v_params._upshift_RPS : 1.;
+    g[1] = (gr > bottom) ? shaft_speed - _v_params._downshift_RPS : 1.;
+    // torque converter reverse flow starts when the wheel side overtakes the crank
+    g[2] = _v_params._tcbool ? shaft_speed - y[20] : 1.;
+}
+
+double AdaptiveSimulator::nextBreakpoint(const std::vector<Entry>& driverData, double t){
+    if(_cursor > 0 && driverData[_cursor - 1].m_time > t){
+        _cursor = 0;
+    }
+    while(_cursor < driverData.size() && driverData[_cursor].m_time <= t){
+        _cursor++;
+    }
+    return (_cursor < driverData.size()) ? driverData[_cursor].m_time : 1e300;
+}
+
+void AdaptiveSimulator::jacobian(double t, const double* y, const double* f0, const std::vector<Entry>& driverData){
+    const int n = NUM_STATES;
+    double yp[NUM_STATES], fp[NUM_STATES];
+    std::copy(y, y + n, yp);
+    for(int j = 0; j < n; j++){
+        // the right hand side does not depend on the position, nor on the crank speed when
+        // there is no torque converter
+        if(j < 2 || (j == 20 && !_v_params._tcbool)){
+            for(int i = 0; i < n; i++){
+                _J[i*n + j] = 0.;
+            }
+            continue;
+        }
+        double dy = 1.5e-8 * std::max(std::abs(y[j]), 1e-3);
+        yp[j] = y[j] + dy;
+        rhs(t, yp, fp, driverData);
+        for(int i = 0; i < n; i++){
+            _J[i*n + j] = (fp[i] - f0[i]) / dy;
+        }
+        yp[j] = y[j];
+    }
+    // time derivative - the controls are the only explicit time dependence
+    double dt = 1.5e-8 * std::max(std::abs(t), 1.);
+    rhs(t + dt, y, fp, driverData);
+    for(int i = 0; i < n; i++){
+        _dfdt[i] = (fp[i] - f0[i]) / dt;
+    }
+}
+
+bool AdaptiveSimulator::advance(const std::vector<Entry>& driverData, double tEnd){
+    const int n = NUM_STATES;
+    double y0[NUM_STATES], y1[NUM_STATES], ys[NUM_STATES];
+    double f0[NUM_STATES], f1[NUM_STATES], f2[NUM_STATES];
+    double k1[NUM_STATES], k2[NUM_STATES], k3[NUM_STATES];
+    double g0[3], g1[3];
+
+    while(_time < tEnd){
+        double t = _time;
+
+        // the step has to stop at tEnd and at the next kink of the controls
+        double tStop = std::min(tEnd, nextBreakpoint(driverData, t));
+        double h = std::min(std::min(_h, _a_params._hMax), tStop - t);
+
+        pack(y0);
+        rhs(t, y0, f0, driverData);
+        if(_jacAge >= _a_params._jacReuse){
+            jacobian(t, y0, f0, driverData);
+            _jacAge = 0;
+        }
+        events(y0, g0);
+
+        double err;
+        while(true){
+            // W = I - h d J
+            for(int i = 0; i < n*n; i++){
+                _W[i] = -h * ROS_D * _J[i];
+            }
+            for(int i = 0; i < n; i++){
+                _W[i*n + i] += 1.;
+            }
+            if(!luFactor(_W, _piv, n)){
+                // W goes to I as h goes to 0
+                if(h > _a_params._hMin){
+                    _stats._rejected++;
+                    h = std::max(_a_params._hMin, 0.2 * h);
+                    continue;
+                }
+                std::cout << __FILE__ << ":" << __LINE__ << " singular iteration matrix at t = " << t
+                          << " with the minimum step " << h << std::endl;
+                return false;
+            }
+
+            for(int i = 0; i < n; i++){
+                k1[i] = f0[i] + h * ROS_D * _dfdt[i];
+            }
+            luSolve(_W, _piv, n, k1);
+
+            for(int i = 0; i < n; i++){
+                ys[i] = y0[i] + 0.5 * h * k1[i];
+            }
+            rhs(t + 0.5 * h, ys, f1, driverData);
+            for(int i = 0; i < n; i++){
+                k2[i] = f1[i] - k1[i];
+            }
+            luSolve(_W, _piv, n, k2);
+            for(int i = 0; i < n; i++){
+                k2[i] += k1[i];
+                y1[i] = y0[i] + h * k2[i];
+            }
+
+            rhs(t + h, y1, f2, driverData);
+            for(int i = 0; i < n; i++){
+                k3[i] = f2[i] - ROS_E32 * (k2[i] - f1[i]) - 2. * (k1[i] - f0[i]) + h * ROS_D * _dfdt[i];
+            }
+            luSolve(_W, _piv, n, k3);
+
+            // scaled rms of the error estimate
+            err = 0.;
+            for(int i = 0; i < n; i++){
+                double e = h / 6. * (k1[i] - 2. * k2[i] + k3[i]);
+                double sc = _a_params._atol + _a_params._rtol * std::max(std::abs(y0[i]), std::abs(y1[i]));
+                err += (e / sc) * (e / sc);
+            }
+            err = std::sqrt(err / n);
+
+            if(!(err <= 1.)){
+                if(h <= _a_params._hMin){
+                    std::cout << __FILE__ << ":" << __LINE__ << " the error test fails at t = " << t
+                              << " with the minimum step " << h << std::endl;
+                    return false;
+                }
+                _stats._rejected++;
+                // an old Jacobian is the first suspect
+                if(_jacAge > 0){
+                    jacobian(t, y0, f0, driverData);
+                    _jacAge = 0;
+                }
+                double factor = (err == err) ? std::max(0.2, 0.8 * std::pow(err, -1./3.)) : 0.2;
+                h = std::max(_a_params._hMin, h * factor);
+                continue;
+            }
+
+            // land on the first event in the step
+            events(y1, g1);
+            double theta = 1.;
+            for(int k = 0; k < 3; k++){
+                if((g0[k] > 0.) != (g1[k] > 0.)){
+                    theta = std::min(theta, g0[k] / (g0[k] - g1[k]));
+                }
+            }
+            if((1. - theta) * h > _a_params._eventTol){
+                _stats._events++;
+                h = theta * h + 0.5 * _a_params._eventTol;
+                continue;
+            }
+            break;
+        }
+
+        // accept - the last right hand side was evaluated at the new state, so the work
+        // structures hold its forces, torques and accelerations
+        _stats._steps++;
+        _time = (t + h >= tStop) ? tStop : t + h;
+        _v_states = _work_v;
+        for(int i = 0; i < 4; i++){
+            _tires[i] = _work_tires[i];
+        }
+
+        // load transfer and gear shift for the next step
+        vehLoads(_v_states, _v_params, _tires[0]._rStat, _tires[3]._rStat);
+        double shaft_speed = 0.25 * (y1[16] + y1[17] + y1[18] + y1[19]) / _v_params._gearRatios[_v_states._current_gr];
+        int gear = _v_states._current_gr;
+        gearShift(_v_states, _v_params, shaft_speed);
+        _jacAge = (_v_states._current_gr != gear) ? _a_params._jacReuse : _jacAge + 1;
+
+        double factor = (err > 0.) ? std::min(5., 0.8 * std::pow(err, -1./3.)) : 5.;
+        if(t + h >= tStop){
+            // a step cut short by tEnd or a breakpoint says little about the next one
+            _h = std::max(_h, h * factor);
+        }
+        else{
+            _h = h * factor;
+        }
+        _h = std::max(_a_params._hMin, std::min(_h, _a_params._hMax));
+    }
+    return true;
+}
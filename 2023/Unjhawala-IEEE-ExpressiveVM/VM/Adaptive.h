@@ -0,0 +1,128 @@
+#ifndef ADAPTIVE_H
+#define ADAPTIVE_H
+#include <stdint.h>
+#include <vector>
+#include "../utils.h"
+#include "Eightdof.h"
+/*
+Header file for the adaptive integrator of the 8 DOF model. Instead of the fixed step half
+implicit Euler of vehAdv/tireAdv/evalPowertrain, the chassis, tire deflection, wheel spin and
+crank shaft states are integrated together with the linearly implicit Rosenbrock 2(3) method
+of Shampine and Reichelt (ode23s) and a step size that follows its error estimate. The tire
+deflections and the wheel spin are stiff, which rules out explicit methods - the Jacobian is
+found by finite differences and kept for _jacReuse steps.
+Steps end on the driver input breakpoints (the controls have kinks there), on gear shift
+speeds and on torque converter reverse flow transitions. The vertical tire forces are
+updated after every accepted step, like the fixed step model does after every step
+*/
+
+namespace EightDOF{
+
+    // settings of the adaptive integrator
+    struct AdaptiveParam{
+        AdaptiveParam() : _rtol(1e-4), _atol(1e-6), _hInit(1e-3), _hMin(1e-8), _hMax(0.05), _eventTol(1e-5),
+                            _jacReuse(10), _omegaSmooth(1e-3), _uSmooth(1e-3) {}
+
+        double _rtol, _atol; // relative and absolute tolerance on every state
+        double _hInit; // first step size
+        double _hMin, _hMax; // step size limits - advance gives up when a step of _hMin fails the error test
+        double _eventTol; // how close (in time) a step has to end to a gear shift or TC transition
+        int _jacReuse; // accepted steps a Jacobian is kept for - it is always redone after a rejected step
+        // wheel speed (rad/s) over which the sign of the brake and rolling resistance torques goes
+        // from -1 to 1 (as tanh(omega / _omegaSmooth)) instead of switching at 0
+        double _omegaSmooth;
+        // vehicle speed (m/s) over which a negative drive torque goes from dropped to applied
+        // (as 0.5 (1 + tanh(u / _uSmooth))) instead of switching at u = 0
+        double _uSmooth;
+    };
+
+    // counters of the work done
+    struct AdaptiveStats{
+        AdaptiveStats() : _steps(0), _rejected(0), _rhsEvals(0), _events(0) {}
+
+        unsigned long _steps; // accepted steps
+        unsigned long _rejected; // steps redone because of the error estimate or a singular iteration matrix
+        unsigned long _rhsEvals; // evaluations of the right hand side
+        unsigned long _events; // steps shortened to land on an event
+    };
+
+
+    class AdaptiveSimulator{
+      public:
+        // number of integrated states - chassis, 4 x and 4 y tire deflections, 4 wheel speeds, crank speed
+        static const int NUM_STATES = 21;
+
+        AdaptiveSimulator();
+
+        // copies the parameters and initializes the states
+        AdaptiveSimulator(const VehicleParam& v_params, const TMeasyParam& t_params,
+                            const AdaptiveParam& a_params = AdaptiveParam());
+
+        void init(const VehicleParam& v_params, const TMeasyParam& t_params,
+                    const AdaptiveParam& a_params = AdaptiveParam());
+
+        // puts the vehicle back at rest at the origin
+        void reset();
+
+        // integrates from the current time to exactly tEnd with the controls from driverData. Returns
+        // false if even a step of _hMin fails - the iteration matrix I - h d J is singular or the
+        // error test fails (values that are not finite fail it too). The states are then those of
+        // the last accepted step, at getTime()
+        bool advance(const std::vector<Entry>& driverData, double tEnd);
+
+        double getTime() const { return _time; }
+
+        // step size the next step will try
+        double getStepSize() const { return _h; }
+
+        const VehicleState& getVehicleState() const { return _v_states; }
+        const TMeasyState& getTireState(int i) const { return _tires[i]; }
+
+        // value of one of the output channels (see OUTPUT_NAMES in Simulator.h)
+        double getOutput(int channel) const;
+
+        const AdaptiveStats& getStats() const { return _stats; }
+
+      private:
+        // copy between the state vector and the state structures
+        void pack(double* y) const;
+        void unpack(const double* y, VehicleState& v_states, TMeasyState* tires) const;
+
+        // dy/dt at time t - the work structures hold the evaluated forces and torques afterwards
+        void rhs(double t, const double* y, double* dy, const std::vector<Entry>& driverData);
+
+        // Jacobian of the right hand side (_J) and its time derivative (_dfdt) at t, y with f0 = f(t, y)
+        void jacobian(double t, const double* y, const double* f0, const std::vector<Entry>& driverData);
+
+        // switching functions of the events - gear shift speeds and TC reverse flow
+        void events(const double* y, double* g) const;
+
+        // time of the first driver input breakpoint after t (or a very large number)
+        double nextBreakpoint(const std::vector<Entry>& driverData, double t);
+
+        VehicleParam _v_params;
+        TMeasyParam _t_params;
+        AdaptiveParam _a_params;
+
+        VehicleState _v_states;
+        TMeasyState _tires[4];
+
+        // scratch for the right hand side
+        VehicleState _work_v;
+        TMeasyState _work_tires[4];
+        std::vector<double> _controls;
+
+        double _time;
+        double _h;
+        size_t _cursor; // driver input entry searched last
+        int _jacAge; // accepted steps since _J was evaluated
+        double _J[NUM_STATES*NUM_STATES]; // row major Jacobian
+        double _W[NUM_STATES*NUM_STATES]; // LU factors of I - h d J
+        int _piv[NUM_STATES];
+        double _dfdt[NUM_STATES];
+
+        AdaptiveStats _stats;
+    };
+}
+
+#endif
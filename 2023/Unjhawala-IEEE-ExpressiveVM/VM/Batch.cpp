@@ -0,0 +1,252 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include "Batch.h"
+#include "Simulator.h"
+#include "ThreadPool.h"
+#include "Eightdof_impl.h"
+#include "Dual.h"
+
+using namespace EightDOF;
+
+/*
+Code for the batch runs. Every run has its own Simulator built from copies of the
+parameters, the driver data is shared read only by all of them
+*/
+
+bool EightDOF::parseParamGroups(ParamGroups& groups, const std::vector<std::string>& specs, std::string& bad){
+    VehicleParam v;
+    TMeasyParam t;
+    groups._names.clear();
+    for(const std::string& spec : specs){
+        std::vector<std::string> names;
+        std::stringstream ss(spec);
+        std::string name;
+        while(std::getline(ss, name, ',')){
+            if(name.empty()){
+                continue;
+            }
+            if(getParamPtr(v, t, name) == nullptr){
+                bad = name;
+                return false;
+            }
+            names.push_back(name);
+        }
+        groups._names.push_back(names);
+    }
+    return true;
+}
+
+// number of steps taken by the usual time loop
+static int batchSteps(double endTime, double step){
+    int n = 0;
+    double t = 0;
+    while(t < (endTime - step/10)){
+        t += step;
+        n++;
+    }
+    return n;
+}
+
+int EightDOF::batchSamples(double endTime, double step, int decimation){
+    return (batchSteps(endTime, step) + decimation - 1) / decimation;
+}
+
+void EightDOF::scaleParams(VehicleParam& v_params, TMeasyParam& t_params, const ParamGroups& groups, const double* theta){
+    for(size_t g = 0; g < groups._names.size(); g++){
+        for(const std::string& name : groups._names[g]){
+            double* p = getParamPtr(v_params, t_params, name);
+            *p = *p * theta[g];
+        }
+    }
+}
+
+void EightDOF::cloneParams(VehicleParam& v_params, TMeasyParam& t_params, const char* vehJSON, const char* tireJSON,
+                            const ParamGroups& groups, const double* theta){
+    setVehParamsCached(v_params, vehJSON);
+    setTireParamsCached(t_params, tireJSON);
+    scaleParams(v_params, t_params, groups, theta);
+}
+
+// one run of the batch
+static void simulateRun(double* out, int run, int nRuns, int nSamples, int nSteps,
+                        const VehicleParam& v_params, const TMeasyParam& t_params,
+                        const std::vector<Entry>& driverData, const ParamGroups& groups,
+                        const double* theta, const std::vector<int>& outputs, int decimation){
+
+    VehicleParam veh_param = v_params;
+    TMeasyParam tire_param = t_params;
+    scaleParams(veh_param, tire_param, groups, theta + run*groups._names.size());
+
+    Simulator sim(veh_param, tire_param);
+    Driver_input input(driverData);
+    Controls controls;
+    double step = veh_param._step;
+    double t = 0;
+    int s = 0;
+    for(int i = 0; i < nSteps; i++){
+        getControls(controls, input, t);
+        sim.step(controls);
+        t += step;
+
+        if(i % decimation == 0){
+            for(size_t o = 0; o < outputs.size(); o++){
+                out[(o*nRuns + run)*nSamples + s] = sim.getOutput(outputs[o]);
+            }
+            s++;
+        }
+    }
+}
+
+void EightDOF::simulateBatch(double* out, const VehicleParam& v_params, const TMeasyParam& t_params,
+                                const std::vector<Entry>& driverData, double endTime,
+                                const ParamGroups& groups, const double* theta, int nRuns,
+                                const std::vector<int>& outputs, int decimation, unsigned int num_threads){
+
+    int nSteps = batchSteps(endTime, v_params._step);
+    int nSamples = (nSteps + decimation - 1) / decimation;
+
+    if(nRuns == 1 || num_threads == 1){
+        for(int r = 0; r < nRuns; r++){
+            simulateRun(out, r, nRuns, nSamples, nSteps, v_params, t_params, driverData, groups, theta, outputs, decimation);
+        }
+        return;
+    }
+
+    ThreadPool pool(num_threads);
+    pool.parallelFor(nRuns, 1, [&](size_t r){
+        simulateRun(out, r, nRuns, nSamples, nSteps, v_params, t_params, driverData, groups, theta, outputs, decimation);
+    });
+}
+
+
+// the time loop of gradientPass with the model variant F - the step of Simulator::step (stepT)
+template <int F, int N>
+static void gradientSteps(double* out, double* grad, int nSamples, int nSteps,
+                            const VehicleParamT<Dual<N>>& veh_d, const TMeasyParamT<Dual<N>>& tire_d,
+                            const std::vector<Entry>& driverData, size_t numGroups,
+                            const std::vector<int>& outputs, int decimation, const std::vector<size_t>& seeded){
+
+    typedef Dual<N> D;
+    VehicleInvariantsT<D> inv;
+    vehInvariants(inv, veh_d);
+    VehicleStateT<D> v_states;
+    vehInit(v_states, veh_d);
+    TMeasyStateT<D> tires[4];
+
+    double c[4];
+    Driver_input input(driverData);
+    double step = primal(veh_d._step);
+    double t = 0;
+    int s = 0;
+    for(int i = 0; i < nSteps; i++){
+        input.getControls(c, t);
+        stepT<F>(v_states, tires, veh_d, tire_d, inv, c[1], c[2], c[3], c[0]);
+        t += step;
+
+        if(i % decimation == 0){
+            for(size_t o = 0; o < outputs.size(); o++){
+                D y = getOutput(outputs[o], c[0] + step, v_states, tires);
+                out[o*nSamples + s] = y._v;
+                for(size_t k = 0; k < seeded.size(); k++){
+                    grad[(o*numGroups + seeded[k])*nSamples + s] = y._d[k];
+                }
+            }
+            s++;
+        }
+    }
+}
+
+// One run of the dual number model carrying the derivatives with respect to the groups in
+// seeded (at most N of them). The parameters are scaled in double first, so the values are
+// exactly those of simulateRun, and then seeded with their derivatives with respect to theta
+template <int N>
+static void gradientPass(double* out, double* grad, int nSamples, int nSteps,
+                            const VehicleParam& v_params, const TMeasyParam& t_params,
+                            const std::vector<Entry>& driverData, const ParamGroups& groups,
+                            const double* theta, const std::vector<int>& outputs, int decimation,
+                            const std::vector<size_t>& seeded){
+
+    typedef Dual<N> D;
+    size_t numGroups = groups._names.size();
+
+    VehicleParam veh_param = v_params;
+    TMeasyParam tire_param = t_params;
+    scaleParams(veh_param, tire_param, groups, theta);
+
+    VehicleParamT<D> veh_d;
+    TMeasyParamT<D> tire_d;
+    convertParams(veh_d, veh_param);
+    convertParams(tire_d, tire_param);
+
+    // a parameter p = p0 * theta_g * (the entries of the other groups it is in) so that
+    // dp/dtheta_g = p0 * (the entries of the other groups)
+    VehicleParam base_v = v_params;
+    TMeasyParam base_t = t_params;
+    for(size_t k = 0; k < seeded.size(); k++){
+        size_t g = seeded[k];
+        for(const std::string& name : groups._names[g]){
+            double d = *getParamPtr(base_v, base_t, name);
+            for(size_t h = 0; h < numGroups; h++){
+                if(h != g && std::find(groups._names[h].begin(), groups._names[h].end(), name) != groups._names[h].end()){
+                    d *= theta[h];
+                }
+            }
+            getParamPtr(veh_d, tire_d, name)->_d[k] += d;
+        }
+    }
+
+    mapsInit(veh_d);
+    tireInit(tire_d);
+
+    // every combination of the feature flags is compiled as its own variant, as in the Simulator
+    switch(modelFeatures(veh_param)){
+        case 0: gradientSteps<0>(out, grad, nSamples, nSteps, veh_d, tire_d, driverData, numGroups, outputs, decimation, seeded); break;
+        case 1: gradientSteps<1>(out, grad, nSamples, nSteps, veh_d, tire_d, driverData, numGroups, outputs, decimation, seeded); break;
+        case 2: gradientSteps<2>(out, grad, nSamples, nSteps, veh_d, tire_d, driverData, numGroups, outputs, decimation, seeded); break;
+        case 3: gradientSteps<3>(out, grad, nSamples, nSteps, veh_d, tire_d, driverData, numGroups, outputs, decimation, seeded); break;
+        case 4: gradientSteps<4>(out, grad, nSamples, nSteps, veh_d, tire_d, driverData, numGroups, outputs, decimation, seeded); break;
+        case 5: gradientSteps<5>(out, grad, nSamples, nSteps, veh_d, tire_d, driverData, numGroups, outputs, decimation, seeded); break;
+        case 6: gradientSteps<6>(out, grad, nSamples, nSteps, veh_d, tire_d, driverData, numGroups, outputs, decimation, seeded); break;
+        case 7: gradientSteps<7>(out, grad, nSamples, nSteps, veh_d, tire_d, driverData, numGroups, outputs, decimation, seeded); break;
+        default: gradientSteps<FEATURES_RUNTIME>(out, grad, nSamples, nSteps, veh_d, tire_d, driverData, numGroups, outputs,
+                                                    decimation, seeded); break;
+    }
+}
+
+void EightDOF::simulateGradient(double* out, double* grad, const VehicleParam& v_params, const TMeasyParam& t_params,
+                                const std::vector<Entry>& driverData, double endTime,
+                                const ParamGroups& groups, const double* theta,
+                                const std::vector<int>& outputs, int decimation){
+
+    int nSteps = batchSteps(endTime, v_params._step);
+    int nSamples = (nSteps + decimation - 1) / decimation;
+    size_t numGroups = groups._names.size();
+    std::fill(grad, grad + outputs.size()*numGroups*nSamples, 0.);
+
+    std::vector<size_t> seeded;
+    for(size_t g = 0; g < numGroups; g++){
+        if(!groups._names[g].empty()){
+            seeded.push_back(g);
+        }
+    }
+
+    // 8 groups per run, the last run (or the only one) with 4, 5 or 6 if that is enough - every
+    // group carried costs about one more model run
+    size_t first = 0;
+    do{
+        size_t n = std::min<size_t>(8, seeded.size() - first);
+        std::vector<size_t> pass(seeded.begin() + first, seeded.begin() + first + n);
+        if(n <= 4){
+            gradientPass<4>(out, grad, nSamples, nSteps, v_params, t_params, driverData, groups, theta, outputs, decimation, pass);
+        } else if(n <= 5){
+            gradientPass<5>(out, grad, nSamples, nSteps, v_params, t_params, driverData, groups, theta, outputs, decimation, pass);
+        } else if(n <= 6){
+            gradientPass<6>(out, grad, nSamples, nSteps, v_params, t_params, driverData, groups, theta, outputs, decimation, pass);
+        } else {
+            gradientPass<8>(out, grad, nSamples, nSteps, v_params, t_params, driverData, groups, theta, outputs, decimation, pass);
+        }
+        first += n;
+    } while(first < seeded.size());
+}
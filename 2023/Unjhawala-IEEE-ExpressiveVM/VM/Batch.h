@@ -0,0 +1,63 @@
+#ifndef BATCH_H
+#define BATCH_H
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "../utils.h"
+#include "Eightdof.h"
+/*
+Header file for running many simulations of the same driver input with different parameter
+multipliers in one call - used by the simulate function of the python module
+*/
+
+namespace EightDOF{
+
+    // Parameter groups - entry j of a theta row multiplies every parameter of group j.
+    // A group is written as comma separated parameter names (see getParamPtr in Eightdof.h),
+    // e.g. "dfy0Pn,dfy0P2n". An empty group ignores its column of theta
+    struct ParamGroups{
+        std::vector<std::vector<std::string>> _names;
+    };
+
+    // parses the group strings, returns false and the offending name in bad if a name is unknown
+    bool parseParamGroups(ParamGroups& groups, const std::vector<std::string>& specs, std::string& bad);
+
+    // multiplies the parameters of every group by its entry of theta
+    void scaleParams(VehicleParam& v_params, TMeasyParam& t_params, const ParamGroups& groups, const double* theta);
+
+    // copies of the parameters of the JSON files, parsed only once per process (see
+    // setVehParamsCached), with the groups multiplied by theta - the setup of one sample of a
+    // calibration loop without any file reading or parsing
+    void cloneParams(VehicleParam& v_params, TMeasyParam& t_params, const char* vehJSON, const char* tireJSON,
+                        const ParamGroups& groups, const double* theta);
+
+    // number of samples simulateBatch writes per run
+    int batchSamples(double endTime, double step, int decimation);
+
+    // Runs nRuns simulations of driverData up to endTime. Run r uses the parameters multiplied
+    // by theta[r*numGroups .. r*numGroups + numGroups). The state is recorded after every step
+    // whose index is a multiple of decimation (the first step included), the same as the
+    // python calibration scripts do. out has to hold outputs.size() * nRuns * batchSamples()
+    // doubles and is filled as out[(o*nRuns + r)*nSamples + s], so every output channel is one
+    // contiguous nRuns x nSamples block. Runs are spread over num_threads threads (0 - all cores)
+    void simulateBatch(double* out, const VehicleParam& v_params, const TMeasyParam& t_params,
+                        const std::vector<Entry>& driverData, double endTime,
+                        const ParamGroups& groups, const double* theta, int nRuns,
+                        const std::vector<int>& outputs, int decimation, unsigned int num_threads);
+
+    // Runs driverData up to endTime once with the parameters multiplied by theta[0 .. numGroups)
+    // and records the outputs like simulateBatch does for a single run, along with their
+    // derivatives with respect to every entry of theta. The model (stepT, with the variant of
+    // the feature flags) runs on dual numbers (Dual.h), carrying the derivatives with respect to
+    // up to 8 groups at a time. Every group carried costs about one more model run, about what
+    // one sided differences cost, but the derivatives are exact. out has to hold
+    // outputs.size() * batchSamples() doubles, filled as out[o*nSamples + s], and grad
+    // outputs.size() * numGroups * batchSamples(), filled as grad[(o*numGroups + g)*nSamples + s].
+    // The derivatives of an empty group are 0
+    void simulateGradient(double* out, double* grad, const VehicleParam& v_params, const TMeasyParam& t_params,
+                            const std::vector<Entry>& driverData, double endTime,
+                            const ParamGroups& groups, const double* theta,
+                            const std::vector<int>& outputs, int decimation);
+}
+
+#endif
@@ -0,0 +1,210 @@
+#ifndef DUAL_H
+#define DUAL_H
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "../utils.h"
+/*
+Forward mode automatic differentiation. A Dual<N> carries a value and its derivatives with
+respect to N parameters, every operation applies the chain rule to all N of them. The model
+instantiated with Dual<N> (see Eightdof_impl.h) thus returns the states together with their
+derivatives with respect to the parameters that were seeded. The values are computed with
+exactly the same operations as the double model
+*/
+
+template <int N>
+struct Dual{
+    Dual() : _v(0.) {
+        for(int i = 0; i < N; i++) _d[i] = 0.;
+    }
+
+    // a constant - all derivatives 0
+    Dual(double v) : _v(v) {
+        for(int i = 0; i < N; i++) _d[i] = 0.;
+    }
+
+    double _v; // value
+    double _d[N]; // derivatives with respect to the N parameters
+
+    Dual& operator+=(const Dual& b){ *this = *this + b; return *this; }
+    Dual& operator-=(const Dual& b){ *this = *this - b; return *this; }
+    Dual& operator*=(const Dual& b){ *this = *this * b; return *this; }
+    Dual& operator/=(const Dual& b){ *this = *this / b; return *this; }
+
+    friend Dual operator-(const Dual& a){
+        Dual r(-a._v);
+        for(int i = 0; i < N; i++) r._d[i] = -a._d[i];
+        return r;
+    }
+    friend Dual operator+(const Dual& a){ return a; }
+
+    friend Dual operator+(const Dual& a, const Dual& b){
+        Dual r(a._v + b._v);
+        for(int i = 0; i < N; i++) r._d[i] = a._d[i] + b._d[i];
+        return r;
+    }
+    friend Dual operator+(const Dual& a, double b){
+        Dual r = a;
+        r._v = a._v + b;
+        return r;
+    }
+    friend Dual operator+(double a, const Dual& b){
+        Dual r = b;
+        r._v = a + b._v;
+        return r;
+    }
+
+    friend Dual operator-(const Dual& a, const Dual& b){
+        Dual r(a._v - b._v);
+        for(int i = 0; i < N; i++) r._d[i] = a._d[i] - b._d[i];
+        return r;
+    }
+    friend Dual operator-(const Dual& a, double b){
+        Dual r = a;
+        r._v = a._v - b;
+        return r;
+    }
+    friend Dual operator-(double a, const Dual& b){
+        Dual r(a - b._v);
+        for(int i = 0; i < N; i++) r._d[i] = -b._d[i];
+        return r;
+    }
+
+    friend Dual operator*(const Dual& a, const Dual& b){
+        Dual r(a._v * b._v);
+        for(int i = 0; i < N; i++) r._d[i] = a._d[i] * b._v + a._v * b._d[i];
+        return r;
+    }
+    friend Dual operator*(const Dual& a, double b){
+        Dual r(a._v * b);
+        for(int i = 0; i < N; i++) r._d[i] = a._d[i] * b;
+        return r;
+    }
+    friend Dual operator*(double a, const Dual& b){
+        Dual r(a * b._v);
+        for(int i = 0; i < N; i++) r._d[i] = a * b._d[i];
+        return r;
+    }
+
+    // the value is divided as in double, the derivatives are multiplied by the reciprocal,
+    // which costs one division instead of N+1
+    friend Dual operator/(const Dual& a, const Dual& b){
+        Dual r(a._v / b._v);
+        double inv = 1. / b._v;
+        for(int i = 0; i < N; i++) r._d[i] = (a._d[i] - r._v * b._d[i]) * inv;
+        return r;
+    }
+    friend Dual operator/(const Dual& a, double b){
+        Dual r(a._v / b);
+        double inv = 1. / b;
+        for(int i = 0; i < N; i++) r._d[i] = a._d[i] * inv;
+        return r;
+    }
+    friend Dual operator/(double a, const Dual& b){
+        Dual r(a / b._v);
+        double dr = -r._v / b._v;
+        for(int i = 0; i < N; i++) r._d[i] = dr * b._d[i];
+        return r;
+    }
+
+    // comparisons only look at the values
+    friend bool operator<(const Dual& a, const Dual& b){ return a._v < b._v; }
+    friend bool operator>(const Dual& a, const Dual& b){ return a._v > b._v; }
+    friend bool operator<=(const Dual& a, const Dual& b){ return a._v <= b._v; }
+    friend bool operator>=(const Dual& a, const Dual& b){ return a._v >= b._v; }
+    friend bool operator==(const Dual& a, const Dual& b){ return a._v == b._v; }
+    friend bool operator!=(const Dual& a, const Dual& b){ return a._v != b._v; }
+};
+
+// value of a dual number
+template <int N>
+inline double primal(const Dual<N>& x){ return x._v; }
+
+// value f and derivative df of a function of x
+template <int N>
+inline Dual<N> chain(const Dual<N>& x, double f, double df){
+    Dual<N> r(f);
+    for(int i = 0; i < N; i++) r._d[i] = df * x._d[i];
+    return r;
+}
+
+// the derivative of abs at 0 is taken as 0, so are those of hypot at the origin
+template <int N>
+inline Dual<N> abs(const Dual<N>& x){
+    return chain(x, std::abs(x._v), (x._v > 0.) - (x._v < 0.));
+}
+
+template <int N>
+inline Dual<N> sqrt(const Dual<N>& x){
+    double s = std::sqrt(x._v);
+    return chain(x, s, 0.5 / s);
+}
+
+template <int N>
+inline Dual<N> pow(const Dual<N>& x, double n){
+    return chain(x, std::pow(x._v, n), n == 2. ? 2. * x._v : n * std::pow(x._v, n - 1.));
+}
+
+template <int N>
+inline Dual<N> sin(const Dual<N>& x){
+    return chain(x, std::sin(x._v), std::cos(x._v));
+}
+
+template <int N>
+inline Dual<N> cos(const Dual<N>& x){
+    return chain(x, std::cos(x._v), -std::sin(x._v));
+}
+
+template <int N>
+inline Dual<N> tan(const Dual<N>& x){
+    double t = std::tan(x._v);
+    return chain(x, t, 1. + t * t);
+}
+
+template <int N>
+inline Dual<N> atan2(const Dual<N>& y, const Dual<N>& x){
+    Dual<N> r(std::atan2(y._v, x._v));
+    double r2 = x._v * x._v + y._v * y._v;
+    if(r2 > 0.){
+        double dy = x._v / r2, dx = -y._v / r2;
+        for(int i = 0; i < N; i++) r._d[i] = dy * y._d[i] + dx * x._d[i];
+    }
+    return r;
+}
+
+template <int N>
+inline Dual<N> hypot(const Dual<N>& x, const Dual<N>& y){
+    Dual<N> r(std::hypot(x._v, y._v));
+    if(r._v > 0.){
+        double dx = x._v / r._v, dy = y._v / r._v;
+        for(int i = 0; i < N; i++) r._d[i] = dx * x._d[i] + dy * y._d[i];
+    }
+    return r;
+}
+
+// getMapY of utils.h - the derivative is the slope of the segment, 0 outside the map
+template <int N>
+inline Dual<N> getMapY(const std::vector<MapEntry>& map, const MapLUT& lut, const Dual<N>& x){
+    double y = getMapY(map, lut, x._v);
+    if(x._v <= map[0]._x || x._v >= map.back()._x){
+        return Dual<N>(y);
+    }
+    std::vector<MapEntry>::const_iterator right =
+        std::lower_bound(map.begin(), map.end(), MapEntry(x._v, 0), compareRPM);
+    std::vector<MapEntry>::const_iterator left = right - 1;
+    return chain(x, y, (right->_y - left->_y) / (right->_x - left->_x));
+}
+
+// sineStep of utils.h
+template <int N>
+inline Dual<N> sineStep(const Dual<N>& x, double x1, double y1, double x2, double y2){
+    double y = sineStep(x._v, x1, y1, x2, y2);
+    if(x._v <= x1 || x._v >= x2){
+        return Dual<N>(y);
+    }
+    double dx = x2 - x1;
+    double dy = y2 - y1;
+    return chain(x, y, (dy / dx) * (1. - std::cos(C_2PI * (x._v - x1) / dx)));
+}
+
+#endif
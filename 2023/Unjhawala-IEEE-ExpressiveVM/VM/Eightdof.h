@@ -1,6 +1,9 @@
 #ifndef EIGHTDOF_H
 #define EIGHTDOF_H
 #include <stdint.h>
+#include <memory>
+#include <type_traits>
+#include <utility>
 #include "../utils.h"
 /*
 Header file for the 8 DOF model implemented in cpp
@@ -8,11 +11,12 @@ Header file for the 8 DOF model implemented in cpp
 
 namespace EightDOF{
 
-    // TMeasy parameter structure
-    struct TMeasyParam{
+    // TMeasy parameter structure - templated on the scalar type, TMeasyParam is the double version
+    template <typename T>
+    struct TMeasyParamT{
 
         // constructor that takes default values of HMMWV
-        TMeasyParam()
+        TMeasyParamT()
             : _jw(6.69), _rr(0.015), _mu(0.8), _r0(0.4699), _pn(8562.8266),
             _pnmax(29969.893), _cx(185004.42), _cy(164448.37),  _kt(411121.0), 
             _dx(3700.), _dy(3488.), _rdyncoPn(0.375), _rdyncoP2n(0.75), _fzRdynco(0), _rdyncoCrit(0),
@@ -23,13 +27,13 @@ namespace EightDOF{
             _symPn(0.38786), _symP2n(0.38786), _sysPn(0.82534), _sysP2n(0.91309), _step(1e-2) {}
 
         // constructor that takes given values - ugly looking code - can this be beutified?
-        TMeasyParam(double jw, double rr, double mu, double r0, double pn,
-            double pnmax, double cx, double cy, double dx, double dy, double kt, 
-            double rdyncoPn, double rdyncoP2n, double fzRdynco, double rdyncoCrit, double dfx0Pn, double dfx0P2n, 
-            double fxmPn, double fxmP2n, double fxsPn, double fxsP2n, double sxmPn, 
-            double sxmP2n, double sxsPn, double sxsP2n, double dfy0Pn, double dfy0P2n, 
-            double fymPn, double fymP2n, double fysPn, double fysP2n, double symPn, 
-            double symP2n, double sysPn, double sysP2n, double step)
+        TMeasyParamT(T jw, T rr, T mu, T r0, T pn,
+            T pnmax, T cx, T cy, T dx, T dy, T kt, 
+            T rdyncoPn, T rdyncoP2n, T fzRdynco, T rdyncoCrit, T dfx0Pn, T dfx0P2n, 
+            T fxmPn, T fxmP2n, T fxsPn, T fxsP2n, T sxmPn, 
+            T sxmP2n, T sxsPn, T sxsP2n, T dfy0Pn, T dfy0P2n, 
+            T fymPn, T fymP2n, T fysPn, T fysP2n, T symPn, 
+            T symP2n, T sysPn, T sysP2n, T step)
             : _jw(jw), _rr(rr), _mu(mu), _r0(r0), _pn(pn),
             _pnmax(pnmax), _cx(cx), _cy(cy), _kt(kt), _dx(dx),
             _dy(dy), _rdyncoPn(rdyncoPn), _rdyncoP2n(rdyncoP2n), _fzRdynco(fzRdynco),
@@ -41,38 +45,38 @@ namespace EightDOF{
 
 
         // basic tire parameters
-        double _jw; // wheel inertia
-        double _rr; // rolling resistance of tire
-        double _mu; // friction constant
-        double _r0; // unloaded tire radius
+        T _jw; // wheel inertia
+        T _rr; // rolling resistance of tire
+        T _mu; // friction constant
+        T _r0; // unloaded tire radius
 
         // TM easy specific tire params
-        double _pn, _pnmax; // nominal and max vertical force
-        double _cx, _cy, _kt; // longitudinal, lateral and vertical stiffness
-        double _dx, _dy; // longitudinal and lateral damping coeffs. No vertical damping
+        T _pn, _pnmax; // nominal and max vertical force
+        T _cx, _cy, _kt; // longitudinal, lateral and vertical stiffness
+        T _dx, _dy; // longitudinal and lateral damping coeffs. No vertical damping
 
 
         // TM easy force characteristic params 
         // 2 values - one at nominal load and one at max load
 
         // dynamic radius weighting coefficient and a critical value for the vertical force
-        double _rdyncoPn, _rdyncoP2n, _fzRdynco, _rdyncoCrit;
+        T _rdyncoPn, _rdyncoP2n, _fzRdynco, _rdyncoCrit;
 
         // Longitudinal
-        double _dfx0Pn, _dfx0P2n; // intial longitudinal slopes dFx/dsx [N]
-        double _fxmPn,_fxmP2n; // maximum longituidnal force [N]
-        double _fxsPn, _fxsP2n; // Longitudinal load at sliding [N]
-        double _sxmPn, _sxmP2n; // slip sx at maximum longitudinal load Fx
-        double _sxsPn, _sxsP2n; // slip sx where sliding begins
+        T _dfx0Pn, _dfx0P2n; // intial longitudinal slopes dFx/dsx [N]
+        T _fxmPn,_fxmP2n; // maximum longituidnal force [N]
+        T _fxsPn, _fxsP2n; // Longitudinal load at sliding [N]
+        T _sxmPn, _sxmP2n; // slip sx at maximum longitudinal load Fx
+        T _sxsPn, _sxsP2n; // slip sx where sliding begins
 
         // Lateral
-        double _dfy0Pn, _dfy0P2n; // intial lateral slopes dFx/dsx [N]
-        double _fymPn,_fymP2n; // maximum lateral force [N]
-        double _fysPn, _fysP2n; // Lateral load at sliding [N]
-        double _symPn, _symP2n; // slip sx at maximum lateral load Fx
-        double _sysPn, _sysP2n; // slip sx where sliding begins
+        T _dfy0Pn, _dfy0P2n; // intial lateral slopes dFx/dsx [N]
+        T _fymPn,_fymP2n; // maximum lateral force [N]
+        T _fysPn, _fysP2n; // Lateral load at sliding [N]
+        T _symPn, _symP2n; // slip sx at maximum lateral load Fx
+        T _sysPn, _sysP2n; // slip sx where sliding begins
 
-        double _step; // integration time step
+        T _step; // integration time step
 
 
 
@@ -80,41 +84,42 @@ namespace EightDOF{
     };
 
     // Tm easy state structure - actual states + things that we need to keep track of
-    struct TMeasyState{
+    template <typename T>
+    struct TMeasyStateT{
         // default contructor to 0's
-        TMeasyState ()
+        TMeasyStateT ()
             : _xe(0.), _ye(0.), _xedot(0.), _yedot(0.), _omega(0.),
             _xt(0.), _rStat(0.), _fx(0.), _fy(0.), _fz(0.), _vsx(0.), _vsy(0.), _My(0.), _engTor(0.) {}
 
 
         // special constructor in case we want to start the simualtion at
         // some other time step
-        TMeasyState(double xe, double ye, double xedot, double yedot,
-            double omega, double xt, double rStat, double fx, double fy,
-            double fz, double vsx, double vsy, double init_ratio)
+        TMeasyStateT(T xe, T ye, T xedot, T yedot,
+            T omega, T xt, T rStat, T fx, T fy,
+            T fz, T vsx, T vsy, T init_ratio)
             : _xe(xe), _ye(ye), _xedot(xedot), _yedot(yedot),
             _omega(omega), _xt(xt), _rStat(rStat), _fx(fx), _fy(fy),
             _fz(fz), _vsx(vsx), _vsy(vsy) {}
 
 
         // the actual state that are intgrated
-        double _xe, _ye; // long and lat tire deflection
-        double _xedot, _yedot; // long and lat tire deflection velocity
-        double _omega; // angular velocity of wheel
+        T _xe, _ye; // long and lat tire deflection
+        T _xedot, _yedot; // long and lat tire deflection velocity
+        T _omega; // angular velocity of wheel
 
 
         // other "states" that we need to keep track of
-        double _xt; // vertical tire compression
-        double _rStat; // loaded tire radius
-        double _fx, _fy, _fz; // long, lateral and vertical force in tire frame
+        T _xt; // vertical tire compression
+        T _rStat; // loaded tire radius
+        T _fx, _fy, _fz; // long, lateral and vertical force in tire frame
 
         // velocities in tire frame
-        double _vsx, _vsy;
+        T _vsx, _vsy;
 
-        double _My; // Rolling resistance moment (negetive)
+        T _My; // Rolling resistance moment (negetive)
 
         // torque from engine that we keep track of
-        double _engTor;
+        T _engTor;
 
 
 
@@ -122,42 +127,43 @@ namespace EightDOF{
 
 
     };
-    // vehicle Parameters structure
-    struct VehicleParam{
+    // vehicle Parameters structure - the maps stay in double whatever the scalar type
+    template <typename T>
+    struct VehicleParamT{
         
         // default constructor with pre tuned values from HMMVW calibration
-        VehicleParam() 
+        VehicleParamT() 
             : _a(1.6889), _b(1.6889), _h(0.713), _m(2097.85), _jz(4519.), _jx(1289.),
             _jxz(3.265), _cf(1.82), _cr(1.82), _muf(127.866),
             _mur(129.98), _hrcf(0.379), _hrcr(0.327), _krof(31000),
             _kror(31000), _brof(3300), _bror(3300),_nonLinearSteer(false), _maxSteer(0.6525249), _crankInertia(1.1), _upshift_RPS(10000),
             _downshift_RPS(0), _tcbool(false), _maxBrakeTorque(4000.), 
-            _c1(0.), _c0(0.), _step(1e-2), _throttleMod(0)  {}
+            _c1(0.), _c0(0.), _step(1e-2), _throttleMod(0), _powertrainScale(1.), _lossesScale(1.)  {}
         
         
         // constructor
-        VehicleParam(double a, double b, double h, double m, double Jz
-            , double Jx, double Jxz, double cf, double cr, double muf,
-            double mur, double hrcf, double hrcr, double krof, double kror,
-            double brof, double bror,bool steer_bool, double maxSteer, double crank_inertia, double up_RPS, double down_RPS, bool tc_bool,
-            double maxTorque, double brakeTorque, double maxSpeed, double c1, double c0, double step, bool throttle_mod)
+        VehicleParamT(T a, T b, T h, T m, T Jz
+            , T Jx, T Jxz, T cf, T cr, T muf,
+            T mur, T hrcf, T hrcr, T krof, T kror,
+            T brof, T bror,bool steer_bool, T maxSteer, T crank_inertia, T up_RPS, T down_RPS, bool tc_bool,
+            T maxTorque, T brakeTorque, T maxSpeed, T c1, T c0, T step, bool throttle_mod)
             : _a(a), _b(b), _h(h), _m(m), _jz(Jz), _jx(Jx), _jxz(Jxz),
             _cf(cf), _cr(cr), _muf(muf), _mur(mur), _hrcf(hrcf), _hrcr(hrcr),
             _krof(krof), _kror(kror), _brof(bror), _bror(bror),_nonLinearSteer(steer_bool), _maxSteer(maxSteer), _crankInertia(crank_inertia),
             _upshift_RPS(up_RPS), _downshift_RPS(down_RPS), _tcbool(tc_bool), _maxBrakeTorque(brakeTorque),
-            _c1(c1), _c0(c0), _step(step), _throttleMod(throttle_mod) {}
+            _c1(c1), _c0(c0), _step(step), _throttleMod(throttle_mod), _powertrainScale(1.), _lossesScale(1.) {}
 
 
-        double _a, _b; // distance c.g. - front axle & distance c.g. - rear axle (m)
-        double _h; // height of c.g
-        double _m; // total vehicle mass (kg)
-        double _jz; // yaw moment inertia (kg.m^2)
-        double _jx; // roll inertia 
-        double _jxz; // XZ inertia
-        double _cf, _cr; // front and rear track width
-        double _muf,_mur; // front and rear unsprung mass
-        double _hrcf,_hrcr; //front and rear roll centre height below C.g
-        double _krof,_kror,_brof,_bror; // front and rear roll stiffness and damping
+        T _a, _b; // distance c.g. - front axle & distance c.g. - rear axle (m)
+        T _h; // height of c.g
+        T _m; // total vehicle mass (kg)
+        T _jz; // yaw moment inertia (kg.m^2)
+        T _jx; // roll inertia 
+        T _jxz; // XZ inertia
+        T _cf, _cr; // front and rear track width
+        T _muf,_mur; // front and rear unsprung mass
+        T _hrcf,_hrcr; //front and rear roll centre height below C.g
+        T _krof,_kror,_brof,_bror; // front and rear roll stiffness and damping
 
         // Bool that checks if the steering is non linea
         // 1 -> Steering is non linear, requires a steering map defined - example in json
@@ -167,14 +173,14 @@ namespace EightDOF{
         // Non linear steering map in case the steering mechanism is not linear
         std::vector<MapEntry> _steerMap;
         // max steer angle parameters of the vehicle
-        double _maxSteer;
+        T _maxSteer;
 
         // crank shaft inertia
-        double _crankInertia;
+        T _crankInertia;
         // some gear parameters
-        double _upshift_RPS;
-        double _downshift_RPS;
-        std::vector<double> _gearRatios; // gear ratio
+        T _upshift_RPS;
+        T _downshift_RPS;
+        std::vector<T> _gearRatios; // gear ratio
 
         // boolean for torque converter presense
         bool _tcbool;
@@ -182,11 +188,11 @@ namespace EightDOF{
 
         
         // double _maxTorque; // Max torque
-        double _maxBrakeTorque; // max brake torque
+        T _maxBrakeTorque; // max brake torque
         // double _maxSpeed; // Max speed
-        double _c1, _c0; // motor resistance - mainly needed for rc car 
+        T _c1, _c0; // motor resistance - mainly needed for rc car 
         
-        double _step; // vehicle integration time step
+        T _step; // vehicle integration time step
 
         // Bool that defines how the throttle modulates the maps
         // 1 -> Modulates like in a motor -> Modifies the entire torque and RPM map
@@ -196,78 +202,249 @@ namespace EightDOF{
         std::vector<MapEntry> _powertrainMap;
         std::vector<MapEntry> _lossesMap;
 
+        // multipliers on the y values of the powertrain and losses maps - lets a 
+        // calibration scale the maps without touching (or copying) the map entries
+        T _powertrainScale, _lossesScale;
+
         // torque converter maps
         std::vector<MapEntry> _CFmap; // capacity factor map
         std::vector<MapEntry> _TRmap; // Torque ratio map
 
+        // uniform grid lookups of the maps above - built by mapsInit
+        MapLUT _steerLUT, _powertrainLUT, _lossesLUT, _CFLUT, _TRLUT;
+
         
     };
 
+#ifndef SWIG
+    // type of the comparisons of T - bool for float, double and Dual, one flag per lane for Lanes
+    template <typename T>
+    using FlagT = decltype(std::declval<T>() < std::declval<T>());
+
+    // type of the gear index - an int, or a T that holds the gear of each lane where the
+    // comparisons of T give one flag per lane, so that each vehicle of a Lanes block has its own gear
+    template <typename T>
+    using GearT = typename std::conditional<std::is_same<FlagT<T>, bool>::value, int, T>::type;
+#endif
+
     // vehicle states structure
-    struct VehicleState{
+    template <typename T>
+    struct VehicleStateT{
         
         // default constructor just assigns zero to all members
-        VehicleState() 
+        VehicleStateT() 
             : _x(0.), _y(0.), _u(0.), _v(0.), _psi(0.), _wz(0.), 
             _phi(0.), _wx(0.), _udot(0.), _vdot(0.), _wxdot(0.), _wzdot(0.),
-            _fzlf(0.), _fzrf(0.), _fzlr(0.), _fzrr(0.), _tor(0.), _crankOmega(0.), _current_gr(0), _tc_reverse_flow(false) {}
+            _fzlf(0.), _fzrf(0.), _fzlr(0.), _fzrr(0.), _tor(0.), _crankOmega(0.), _debugtor(0.), _current_gr(),
+            _tc_inp_tor(0.), _tc_out_tor(0.), _tc_out_omg(0.), _tc_reverse_flow(), _sr(0.) {}
 
 
         // special constructor in case need to start simulation
         // from some other state
-        double _x, _y; // x and y position
-        double _u, _v; // x and y velocity
-        double _psi, _wz; // yaw angle and yaw rate
-        double _phi, _wx; // roll angle and roll rate
+        T _x, _y; // x and y position
+        T _u, _v; // x and y velocity
+        T _psi, _wz; // yaw angle and yaw rate
+        T _phi, _wx; // roll angle and roll rate
         
 
         // acceleration 'states'
-        double _udot, _vdot; 
-        double _wxdot, _wzdot;
+        T _udot, _vdot; 
+        T _wxdot, _wzdot;
 
 
         // vertical forces on each tire
-        double _fzlf, _fzrf, _fzlr, _fzrr;
+        T _fzlf, _fzrf, _fzlr, _fzrr;
 
         // crank torque (used to transmit torque to tires) and crank angular velocity state
-        double _tor;
-        double _crankOmega;
-        double _debugtor;
+        T _tor;
+        T _crankOmega;
+        T _debugtor;
+#ifndef SWIG
+        GearT<T> _current_gr;
+#else
         int _current_gr;
-        double _tc_inp_tor;
-        double _tc_out_tor;
-        double _tc_out_omg;
+#endif
+        T _tc_inp_tor;
+        T _tc_out_tor;
+        T _tc_out_omg;
+#ifndef SWIG
+        FlagT<T> _tc_reverse_flow;
+#else
         bool _tc_reverse_flow;
-        double _sr;
+#endif
+        T _sr;
 
 
     };
 
-////////////////////////////////////////////////////////////////////////// Vehicle Functions /////////////////////////////////////////////////
-    // sets the vertical forces based on the vehicle weight
-    void vehInit(VehicleState& v_state, const VehicleParam& v_params);
+    // the double versions used everywhere else and the float versions for single precision runs
+    typedef TMeasyParamT<double> TMeasyParam;
+    typedef TMeasyStateT<double> TMeasyState;
+    typedef VehicleParamT<double> VehicleParam;
+    typedef VehicleStateT<double> VehicleState;
+
+    typedef TMeasyParamT<float> TMeasyParamF;
+    typedef TMeasyStateT<float> TMeasyStateF;
+    typedef VehicleParamT<float> VehicleParamF;
+    typedef VehicleStateT<float> VehicleStateF;
+
+    // copies parameters between scalar types, e.g. the float parameters from ones read with setVehParamsJSON
+    template <typename T, typename U>
+    void convertParams(VehicleParamT<T>& out, const VehicleParamT<U>& in);
+    template <typename T, typename U>
+    void convertParams(TMeasyParamT<T>& out, const TMeasyParamT<U>& in);
+
+/////////////////////////////////////////////////////////////////////// Model variants ///////////////////////////////////////////////////////////
+
+    // Feature flags of a vehicle. The model functions below also come as variants with the flags
+    // fixed at compile time (the template parameter F, a combination of the flags), where the
+    // branches on _tcbool, _nonLinearSteer and _throttleMod are resolved by the compiler. The
+    // usual functions are the variant FEATURES_RUNTIME, which reads the flags from the parameters
+    static const int FEATURE_TC = 1; // _tcbool
+    static const int FEATURE_NONLINEAR_STEER = 2; // _nonLinearSteer
+    static const int FEATURE_THROTTLE_MOD = 4; // _throttleMod
+    static const int FEATURES_RUNTIME = -1;
+
+    // the flags of a vehicle
+    template <typename T>
+    inline int modelFeatures(const VehicleParamT<T>& v_params){
+        return (v_params._tcbool ? FEATURE_TC : 0) | (v_params._nonLinearSteer ? FEATURE_NONLINEAR_STEER : 0) |
+                (v_params._throttleMod ? FEATURE_THROTTLE_MOD : 0);
+    }
 
-    double driveTorque(VehicleParam& v_params, const double throttle, const double omega);
+    // whether variant F has the flag FLAG - known at compile time unless F is FEATURES_RUNTIME
+    template <int F, int FLAG, typename T>
+    inline bool hasFeature(const VehicleParamT<T>& v_params){
+        if(F != FEATURES_RUNTIME){
+            return (F & FLAG) != 0;
+        }
+        switch(FLAG){
+            case FEATURE_TC: return v_params._tcbool;
+            case FEATURE_NONLINEAR_STEER: return v_params._nonLinearSteer;
+            default: return v_params._throttleMod;
+        }
+    }
 
-    inline double brakeTorque(const VehicleParam& v_params, const double brake){
+    // quantities of the chassis equations that only depend on the parameters - see vehInvariants
+    template <typename T>
+    struct VehicleInvariantsT{
+        T _mt, _invMt; // total mass and 1 / total mass
+        T _hrc; // height of the roll axis below the c.g.
+        T _A1, _A2, _A3; // the coefficients of the chassis equations
+        T _A1sq, _A3sq, _jxzsq, _A1A2, _A1A3; // and their products
+        T _denom; // common denominator of the chassis equations
+        T _mGhrc, _kro, _bro; // roll moment coefficients
+        T _udotWz, _e2Wz; // unsprung mass coefficients of the yaw rate terms
+        T _twoHrcM;
+        T _Z1f, _Z1r; // static vertical loads
+        T _Z2f, _Z2r; // sprung mass part of the lateral load transfer
+        T _mh, _twoL; // m*h and 2*(a+b)
+    };
+    typedef VehicleInvariantsT<double> VehicleInvariants;
+
+    // computes the invariants - needs to be called again when the parameters change
+    template <typename T>
+    void vehInvariants(VehicleInvariantsT<T>& inv, const VehicleParamT<T>& v_params);
+
+/*
+All the model functions below are templates on the scalar type T. They are defined in
+Eightdof_impl.h and instantiated for float and double in Eightdof.cpp - include Eightdof_impl.h
+to use them with any other type. The controls stay double for every T. The functions of a step
+(see stepT) take the parameters with a scalar type P of their own, which is T except in
+StepJacobian, whose parameters stay double as they carry no derivatives
+*/
+
+////////////////////////////////////////////////////////////////////////// Vehicle Functions /////////////////////////////////////////////////
+    // sets the vertical forces based on the vehicle weight
+    template <typename T>
+    void vehInit(VehicleStateT<T>& v_state, const VehicleParamT<T>& v_params);
+
+    // builds the uniform grid lookups of all the maps - called by setVehParamsJSON
+    // Needs to be called again if the breakpoints (x values) of a map are changed
+    template <typename T>
+    void mapsInit(VehicleParamT<T>& v_params);
+
+    // drive torque of the engine/motor at the given crank speed including the losses
+    template <typename T>
+    T driveTorque(const VehicleParamT<T>& v_params, const double throttle, const T omega);
+
+    // the brake and steering inputs are of type U - double in the model, and the same type as T
+    // for the derivatives with respect to the controls (see StepJacobian). The result is of the
+    // type of the parameters times U
+#ifndef SWIG
+    template <typename P, typename U>
+    inline decltype(std::declval<P>() * std::declval<U>()) brakeTorque(const VehicleParamT<P>& v_params, const U brake){
         return v_params._maxBrakeTorque * brake;
     }
-    void differentialSplit(double torque,
-                        double max_bias,
-                        double speed_left,
-                        double speed_right,
-                        double& torque_left,
-                        double& torque_right);
 
+    // steering angle of the front wheels for a normalized steering input
+    template <int F, typename P, typename U>
+    inline decltype(std::declval<P>() * std::declval<U>()) steerAngle(const VehicleParamT<P>& v_params, const U steering){
+        if(hasFeature<F, FEATURE_NONLINEAR_STEER>(v_params)){
+            return getMapY(v_params._steerMap, v_params._steerLUT, steering);
+        }
+        return steering * v_params._maxSteer;
+    }
+#endif
+    template <typename T>
+    inline T steerAngle(const VehicleParamT<T>& v_params, const double steering){
+        return steerAngle<FEATURES_RUNTIME>(v_params, steering);
+    }
 
-    void evalPowertrain(VehicleState& v_states, TMeasyState& tirelf_st,
-                        TMeasyState& tirerf_st, TMeasyState& tirelr_st, 
-                        TMeasyState& tirerr_st, VehicleParam& v_params, const TMeasyParam& t_params,
+    template <typename T>
+    void differentialSplit(T torque,
+                        T max_bias,
+                        T speed_left,
+                        T speed_right,
+                        T& torque_left,
+                        T& torque_right);
+
+
+    // drive line torques for the current states without integrating anything - returns the crank
+    // shaft acceleration, the wheel accelerations go in dOmega[4] and the speed used for the
+    // gear shifts in shaft_speed
+    template <typename T>
+    T powertrainRates(VehicleStateT<T>& v_states, TMeasyStateT<T>& tirelf_st,
+                        TMeasyStateT<T>& tirerf_st, TMeasyStateT<T>& tirelr_st, 
+                        TMeasyStateT<T>& tirerr_st, const VehicleParamT<T>& v_params, const TMeasyParamT<T>& t_params,
+                        const double throttle, const double brake, T* dOmega, T& shaft_speed);
+
+    // up or down shift based on the shaft speed from powertrainRates
+    template <typename T>
+    void gearShift(VehicleStateT<T>& v_states, const VehicleParamT<T>& v_params, const T shaft_speed);
+
+    template <typename T>
+    void evalPowertrain(VehicleStateT<T>& v_states, TMeasyStateT<T>& tirelf_st,
+                        TMeasyStateT<T>& tirerf_st, TMeasyStateT<T>& tirelr_st, 
+                        TMeasyStateT<T>& tirerr_st, const VehicleParamT<T>& v_params, const TMeasyParamT<T>& t_params,
                         const std::vector <double>& controls);
 
     // function to advance the time step of the vehicle
-    void vehAdv(VehicleState& v_states, const VehicleParam& v_params,
-                const std::vector <double>& fx, const std::vector <double>& fy, const double huf, const double hur);
+    template <typename T>
+    void vehAdv(VehicleStateT<T>& v_states, const VehicleParamT<T>& v_params,
+                const std::vector <T>& fx, const std::vector <T>& fy, const T huf, const T hur);
+
+    // chassis accelerations (_udot, _vdot, _wxdot, _wzdot) for the 4 tire forces in the vehicle frame
+    template <typename T>
+    void vehAccelerations(VehicleStateT<T>& v_states, const VehicleParamT<T>& v_params, const T* fx, const T* fy);
+
+    // vertical tire forces from the chassis states and accelerations (load transfer)
+    template <typename T>
+    void vehLoads(VehicleStateT<T>& v_states, const VehicleParamT<T>& v_params, const T huf, const T hur);
+
+    // the same three with the invariants computed beforehand by vehInvariants - the functions
+    // above compute them on every call
+#ifndef SWIG
+    template <typename T, typename P>
+    void vehAdv(VehicleStateT<T>& v_states, const VehicleParamT<P>& v_params, const VehicleInvariantsT<P>& inv,
+                const T* fx, const T* fy, const T huf, const T hur);
+    template <typename T, typename P>
+    void vehAccelerations(VehicleStateT<T>& v_states, const VehicleParamT<P>& v_params, const VehicleInvariantsT<P>& inv,
+                            const T* fx, const T* fy);
+    template <typename T, typename P>
+    void vehLoads(VehicleStateT<T>& v_states, const VehicleParamT<P>& v_params, const VehicleInvariantsT<P>& inv,
+                    const T huf, const T hur);
+#endif
 
 
 
@@ -275,14 +452,15 @@ namespace EightDOF{
     void setVehParamsJSON(VehicleParam& v_params, const char *fileName);
 
 
+    template <typename T>
+    void vehToTireTransform(TMeasyStateT<T>& tirelf_st,TMeasyStateT<T>& tirerf_st,
+                                TMeasyStateT<T>& tirelr_st, TMeasyStateT<T>& tirerr_st, 
+                                const VehicleStateT<T>& v_states, const VehicleParamT<T>& v_params, const std::vector <double>& controls);
 
-    void vehToTireTransform(TMeasyState& tirelf_st,TMeasyState& tirerf_st,
-                                TMeasyState& tirelr_st, TMeasyState& tirerr_st, 
-                                const VehicleState& v_states, const VehicleParam& v_params, const std::vector <double>& controls);
-
-    void tireToVehTransform(TMeasyState& tirelf_st,TMeasyState& tirerf_st,
-                                TMeasyState& tirelr_st, TMeasyState& tirerr_st,
-                                const VehicleState& v_states, const VehicleParam& v_params, const std::vector <double>& controls);
+    template <typename T>
+    void tireToVehTransform(TMeasyStateT<T>& tirelf_st,TMeasyStateT<T>& tirerf_st,
+                                TMeasyStateT<T>& tirelr_st, TMeasyStateT<T>& tirerr_st,
+                                const VehicleStateT<T>& v_states, const VehicleParamT<T>& v_params, const std::vector <double>& controls);
 
 
 /////////////////////////////////////////////////////////////////////// Tire Functions ///////////////////////////////////////////////////////////
@@ -290,21 +468,166 @@ namespace EightDOF{
 
     // sets the vertical tire deflection based on the vehicle weight 
     // template based on which tire
-    void tireInit(TMeasyParam& t_params);
+    template <typename T>
+    void tireInit(TMeasyParamT<T>& t_params);
+
+
+    // slip quantities of a tire that stay fixed over a vehicle time step
+    template <typename T>
+    struct TireSlipT{
+        T _vsx; // longitudinal slip velocity
+        T _vta; // transport velocity
+        T _sy; // lateral slip
+        T _fos; // force over combined slip from the force characteristics
+        T _vtxs, _vtys; // normalized transport velocities
+    };
+    typedef TireSlipT<double> TireSlip;
+
+    // slips of the tire for the steering angle delta - also updates _xt, _rStat and _My
+    template <typename T>
+    void tireSlip(TireSlipT<T>& slip, TMeasyStateT<T>& t_states, const TMeasyParamT<T>& t_params, const T delta);
 
+    // deflection rates (_xedot, _yedot) and tire forces (_fx, _fy) for the current deflections
+    template <typename T>
+    void tireForceRates(TMeasyStateT<T>& t_states, const TMeasyParamT<T>& t_params, const TireSlipT<T>& slip);
 
     // function to calculate the force from the force charactristics
     // used by tireSync
-    void tmxy_combined(double& f, double& fos, double s, double df0, double sm, double fm, double ss, double fs);
+    template <typename T>
+    void tmxy_combined(T& f, T& fos, T s, T df0, T sm, T fm, T ss, T fs);
+
+    // same force and force over slip as tmxy_combined, bit for bit, along with dfds, the derivative
+    // of the force with respect to s (0 where tmxy_combined gives 0 or full sliding). Evaluates
+    // every branch and picks the result with selects, so that a loop of calls over tires or
+    // vehicles has no data dependent branches
+    template <typename T>
+    void tmxy_combined_select(T& f, T& fos, T& dfds, T s, T df0, T sm, T fm, T ss, T fs);
 
     // Advances the time step
     // updates the tire forces which is then used by the vehicle model 
-    void tireAdv(TMeasyState& t_states, const TMeasyParam& t_params, const VehicleState& v_states, 
-                    const VehicleParam& v_params, const std::vector <double>& controls);
+    template <typename T>
+    void tireAdv(TMeasyStateT<T>& t_states, const TMeasyParamT<T>& t_params, const VehicleStateT<T>& v_states, 
+                    const VehicleParamT<T>& v_params, const std::vector <double>& controls);
+
+    // Advances all 4 tires (lf, rf, lr, rr, one after the other in tires) to t + the vehicle step,
+    // tire c with the steering angle delta[c]. Same as 4 calls of tireAdv, bit for bit. With
+    // double the 4 corners go in the 4 lanes of one Lanes<4> (see Lanes.h), so every stage is one
+    // pass of vector operations, with the force characteristics of tmxy_combined_select and the
+    // math functions lane by lane. With other scalar types (Lanes for the vehicles of an Ensemble,
+    // Dual) every stage is a loop over the 4 corners
+#ifndef SWIG
+    template <typename T, typename P>
+    void tireAdv4(TMeasyStateT<T>* tires, const TMeasyParamT<P>& t_params, const VehicleParamT<P>& v_params,
+                    const T* delta, double t);
+
+    // the stages of tireAdv4 for NC corners - 4 tires, or one with the 4 corners in its lanes
+    template <int NC, typename T, typename P>
+    void tireCorners(TMeasyStateT<T>* tires, const TMeasyParamT<P>& t_params, const VehicleParamT<P>& v_params,
+                    const T* delta, double t);
+#endif
 
 
     // setting tire parameters using a JSON file
     void setTireParamsJSON(TMeasyParam& t_params, const char * fileName);
+
+
+    // Same as setVehParamsJSON and setTireParamsJSON, but every file is parsed only once per
+    // process (and again when its modification time changes) and later calls copy the stored
+    // parameters. The parameters are replaced by those of the file. Safe to call from several threads
+    void setVehParamsCached(VehicleParam& v_params, const char *fileName);
+    void setTireParamsCached(TMeasyParam& t_params, const char *fileName);
+
+    // forgets all the files parsed by the functions above
+    void clearParamCache();
+
+#ifndef SWIG
+    // the stored parameters of a file, parsed if needed - shared, so they are read only
+    std::shared_ptr<const VehicleParam> cachedVehParams(const char *fileName);
+    std::shared_ptr<const TMeasyParam> cachedTireParams(const char *fileName);
+#endif
+
+
+    // the variants of the functions with feature flags (see FEATURE_TC), called as for example
+    // evalPowertrain<FEATURE_TC>(...)
+#ifndef SWIG
+    // the throttle and brake are of type U, as for brakeTorque
+    template <int F, typename T, typename U, typename P>
+    T driveTorque(const VehicleParamT<P>& v_params, const U throttle, const T omega);
+
+    template <int F, typename T, typename U, typename P>
+    T powertrainRates(VehicleStateT<T>& v_states, TMeasyStateT<T>& tirelf_st,
+                        TMeasyStateT<T>& tirerf_st, TMeasyStateT<T>& tirelr_st,
+                        TMeasyStateT<T>& tirerr_st, const VehicleParamT<P>& v_params, const TMeasyParamT<P>& t_params,
+                        const U throttle, const U brake, T* dOmega, T& shaft_speed);
+
+    template <int F, typename T, typename P>
+    void gearShift(VehicleStateT<T>& v_states, const VehicleParamT<P>& v_params, const T shaft_speed);
+
+    template <int F, typename T>
+    void evalPowertrain(VehicleStateT<T>& v_states, TMeasyStateT<T>& tirelf_st,
+                        TMeasyStateT<T>& tirerf_st, TMeasyStateT<T>& tirelr_st,
+                        TMeasyStateT<T>& tirerr_st, const VehicleParamT<T>& v_params, const TMeasyParamT<T>& t_params,
+                        const std::vector <double>& controls);
+
+    // the same with the throttle and brake given on their own
+    template <int F, typename T, typename U, typename P>
+    void evalPowertrain(VehicleStateT<T>& v_states, TMeasyStateT<T>& tirelf_st,
+                        TMeasyStateT<T>& tirerf_st, TMeasyStateT<T>& tirelr_st,
+                        TMeasyStateT<T>& tirerr_st, const VehicleParamT<P>& v_params, const TMeasyParamT<P>& t_params,
+                        const U throttle, const U brake);
+
+    template <int F, typename T>
+    void vehToTireTransform(TMeasyStateT<T>& tirelf_st,TMeasyStateT<T>& tirerf_st,
+                                TMeasyStateT<T>& tirelr_st, TMeasyStateT<T>& tirerr_st,
+                                const VehicleStateT<T>& v_states, const VehicleParamT<T>& v_params, const std::vector <double>& controls);
+
+    // the same with the steering angle delta of the front wheels instead of the controls
+    template <int F, typename T, typename P>
+    void vehToTireTransform(TMeasyStateT<T>& tirelf_st,TMeasyStateT<T>& tirerf_st,
+                                TMeasyStateT<T>& tirelr_st, TMeasyStateT<T>& tirerr_st,
+                                const VehicleStateT<T>& v_states, const VehicleParamT<P>& v_params, const T delta);
+
+    template <int F, typename T>
+    void tireToVehTransform(TMeasyStateT<T>& tirelf_st,TMeasyStateT<T>& tirerf_st,
+                                TMeasyStateT<T>& tirelr_st, TMeasyStateT<T>& tirerr_st,
+                                const VehicleStateT<T>& v_states, const VehicleParamT<T>& v_params, const std::vector <double>& controls);
+
+    template <int F, typename T, typename P>
+    void tireToVehTransform(TMeasyStateT<T>& tirelf_st,TMeasyStateT<T>& tirerf_st,
+                                TMeasyStateT<T>& tirelr_st, TMeasyStateT<T>& tirerr_st,
+                                const VehicleStateT<T>& v_states, const VehicleParamT<P>& v_params, const T delta);
+
+    template <int F, typename T>
+    void tireAdv(TMeasyStateT<T>& t_states, const TMeasyParamT<T>& t_params, const VehicleStateT<T>& v_states,
+                    const VehicleParamT<T>& v_params, const std::vector <double>& controls);
+
+    // One vehicle time step of the vehicle and its 4 tires (lf, rf, lr, rr) from the time t -
+    // the step of Simulator, Ensemble, StepJacobian and simulateGradient, so the sequence of the
+    // functions above is written only here. The steering, throttle and braking are of type U,
+    // as for driveTorque. inv are the invariants of v_params (see vehInvariants)
+    template <int F, typename T, typename U, typename P>
+    void stepT(VehicleStateT<T>& v_states, TMeasyStateT<T>* tires, const VehicleParamT<P>& v_params,
+                const TMeasyParamT<P>& t_params, const VehicleInvariantsT<P>& inv,
+                const U steering, const U throttle, const U braking, double t);
+
+    // the same with the tire stage done by advanceTires(tires, delta) instead of
+    // tireAdv4(tires, t_params, v_params, delta, t) - for StepJacobian, which advances the
+    // tires with fewer derivatives
+    template <int F, typename T, typename U, typename P, typename TireStage>
+    void stepT(VehicleStateT<T>& v_states, TMeasyStateT<T>* tires, const VehicleParamT<P>& v_params,
+                const TMeasyParamT<P>& t_params, const VehicleInvariantsT<P>& inv,
+                const U steering, const U throttle, const U braking, double t, TireStage advanceTires);
+#endif
+
+
+/////////////////////////////////////////////////////////////////////// Parameter names ///////////////////////////////////////////////////////////
+
+    // pointer to the scalar parameter with the given name - the names are the keys of the
+    // JSON files (vehicle keys first, then tire keys) plus "torqueMapScale" and "lossesMapScale"
+    // for the powertrain map scales. Returns nullptr if there is no such parameter. "step" is
+    // in both files and is not looked up here
+    template <typename T>
+    T* getParamPtr(VehicleParamT<T>& v_params, TMeasyParamT<T>& t_params, const std::string& name);
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,1275 @@
+#ifndef EIGHTDOF_IMPL_H
+#define EIGHTDOF_IMPL_H
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include "Eightdof.h"
+#include "Profile.h"
+#include "Lanes.h"
+/*
+Definitions of the templated 8 DOF model functions declared in Eightdof.h. Eightdof.cpp
+instantiates them for float and double, include this file only to use another scalar type
+*/
+
+namespace EightDOF{
+    // the math functions are called unqualified so that a scalar type other than float and
+    // double can bring its own overloads (found by argument dependent lookup, see Dual.h)
+    using std::abs;
+    using std::pow;
+    using std::sqrt;
+    using std::sin;
+    using std::cos;
+    using std::tan;
+    using std::atan2;
+    using std::hypot;
+
+    // plain value of a scalar - used where the model needs a double, like the time
+    inline double primal(double x){ return x; }
+    inline float primal(float x){ return x; }
+
+    // a if c holds and b otherwise. Where the model picks between two values it does it with
+    // select, so that a scalar type whose comparisons give one result per lane (see Lanes.h)
+    // brings its own select. Both values are evaluated
+    template <typename T>
+    inline T select(bool c, const T& a, const T& b){ return c ? a : b; }
+
+    // tireAdv4 of double advances the 4 corners in the lanes of tires of type Lanes<CORNER_LANES>,
+    // one SIMD register each - 2 tires of 2 lanes with SSE2, 1 of 4 with AVX. A Lanes<4> is two
+    // registers with SSE2 and its steps are slower than the loop over the corners. With the vector
+    // math of Lanes.h, which is a few ulp off the double model, it is 1 - the loop over the corners
+    // of the other scalar types
+#if defined(EDOF_VECTOR_MATH)
+    constexpr int CORNER_LANES = 1;
+#else
+    constexpr int CORNER_LANES = NATIVE_LANES < 4 ? NATIVE_LANES : 4;
+#endif
+
+    // whether the comparisons of T give a bool, as they do for float, double and Dual
+    template <typename T>
+    struct ComparesToBool : std::is_same<decltype(std::declval<T>() < std::declval<T>()), bool> {};
+
+    // ratio of the gear with index gear (see GearT in Eightdof.h)
+    template <typename T>
+    inline T gearRatio(const std::vector<T>& ratios, int gear){ return ratios[gear]; }
+
+    // the same for a gear per lane - picks the ratio of every gear with a select, so that the
+    // lanes of a block can be in different gears
+    template <typename T>
+    inline T gearRatio(const std::vector<T>& ratios, const T& gear){
+        T r = ratios[0];
+        for(size_t i = 1; i < ratios.size(); i++){
+            r = select(gear == T(double(i)), ratios[i], r);
+        }
+        return r;
+    }
+}
+
+///////////////////////////////////////////////////////////////// Vehicle Functions ///////////////////////////////////////////////////////////////////////
+/*
+Code for the Eight dof model implemented in cpp
+*/
+
+// sets the vertical forces based on the vehicle weight
+template <typename T>
+void EightDOF::vehInit(VehicleStateT<T>& v_state, const VehicleParamT<T>& v_param){
+    T weight_split = ((v_param._m*G*v_param._b) /
+                        (2*(v_param._a+v_param._b))+v_param._muf*G);
+    v_state._fzlf = v_state._fzrf = weight_split;
+    
+    weight_split = ((v_param._m*G*v_param._b) /
+                        (2*(v_param._a+v_param._b))+v_param._mur*G);
+
+    v_state._fzlr = v_state._fzrr = weight_split;
+
+}
+
+// builds the uniform grid lookups of the maps
+template <typename T>
+void EightDOF::mapsInit(VehicleParamT<T>& v_params){
+    mapLUTInit(v_params._steerLUT, v_params._steerMap);
+    mapLUTInit(v_params._powertrainLUT, v_params._powertrainMap);
+    mapLUTInit(v_params._lossesLUT, v_params._lossesMap);
+    mapLUTInit(v_params._CFLUT, v_params._CFmap);
+    mapLUTInit(v_params._TRLUT, v_params._TRmap);
+}
+
+// returns drive toruqe at a given omega 
+template <typename T>
+T EightDOF::driveTorque(const VehicleParamT<T>& v_params, const double throttle, const T motor_speed){
+    return driveTorque<FEATURES_RUNTIME>(v_params, throttle, motor_speed);
+}
+
+template <int F, typename T, typename U, typename P>
+T EightDOF::driveTorque(const VehicleParamT<P>& v_params, const U throttle, const T motor_speed){
+
+    T motor_torque = 0.;
+    // If we have throttle modulation like in a motor
+    if(hasFeature<F, FEATURE_THROTTLE_MOD>(v_params)){
+        // The throttle scales both the speed and the torque axis of the map. Looking up the
+        // scaled map at motor_speed is the same as looking up the original map at
+        // motor_speed / throttle and scaling the result, so the map itself is never touched
+        // At zero throttle the scaled map collapses to zero torque
+        if(throttle > 0.){
+            motor_torque = throttle * getMapY(v_params._powertrainMap, v_params._powertrainLUT, motor_speed / throttle);
+        }
+        motor_torque = motor_torque * v_params._powertrainScale;
+        T motor_losses = getMapY(v_params._lossesMap, v_params._lossesLUT, motor_speed) * v_params._lossesScale;
+        motor_torque = motor_torque + motor_losses;
+    }
+    else{ // Else we don't multiply the map but just the output torque
+        motor_torque = getMapY(v_params._powertrainMap, v_params._powertrainLUT, motor_speed) * v_params._powertrainScale;
+        T motor_losses = getMapY(v_params._lossesMap, v_params._lossesLUT, motor_speed) * v_params._lossesScale;
+        motor_torque = motor_torque * throttle + motor_losses;
+
+    }
+    return motor_torque;
+}
+/*
+Function that calculates the torque split to each tire based on the differential max bias
+Exactly the same as Chrono implementation
+*/
+
+template <typename T>
+void EightDOF::differentialSplit(T torque,
+                       T max_bias,
+                       T speed_left,
+                       T speed_right,
+                       T& torque_left,
+                       T& torque_right) {
+    T diff = abs(speed_left - speed_right);
+
+    // The bias grows from 1 at diff=0.25 to max_bias at diff=0.5
+    T bias = select(diff > 0.5, max_bias, select(diff > 0.25, 4 * (max_bias - 1) * diff + (2 - max_bias), T(1)));
+
+    // Split torque to the slow and fast wheels.
+    T alpha = bias / (1 + bias);
+    T slow = alpha * torque;
+    T fast = torque - slow;
+
+    FlagT<T> left_slow = abs(speed_left) < abs(speed_right);
+    torque_left = select(left_slow, slow, fast);
+    torque_right = select(left_slow, fast, slow);
+}
+
+
+/*
+Function to evaluate the drive line and engine torques for the current states. Sets the engine
+torque of each tire and the torque converter debug states, and returns the crank shaft
+acceleration (0 without a torque converter, where the crank speed follows the wheels).
+The wheel accelerations go in dOmega and the speed that decides the gear shifts in shaft_speed.
+Nothing is integrated and no gear is shifted in here
+*/
+
+template <typename T>
+T EightDOF::powertrainRates(VehicleStateT<T>& v_states, TMeasyStateT<T>& tirelf_st,
+                    TMeasyStateT<T>& tirerf_st, TMeasyStateT<T>& tirelr_st, 
+                    TMeasyStateT<T>& tirerr_st, const VehicleParamT<T>& v_params, const TMeasyParamT<T>& t_params,
+                    const double throttle, const double brake, T* dOmega, T& shaft_speed){
+    return powertrainRates<FEATURES_RUNTIME>(v_states, tirelf_st, tirerf_st, tirelr_st, tirerr_st, v_params, t_params,
+                                                throttle, brake, dOmega, shaft_speed);
+}
+
+template <int F, typename T, typename U, typename P>
+T EightDOF::powertrainRates(VehicleStateT<T>& v_states, TMeasyStateT<T>& tirelf_st,
+                    TMeasyStateT<T>& tirerf_st, TMeasyStateT<T>& tirelr_st, 
+                    TMeasyStateT<T>& tirerr_st, const VehicleParamT<P>& v_params, const TMeasyParamT<P>& t_params,
+                    const U throttle, const U brake, T* dOmega, T& shaft_speed){
+
+                        // some variables needed outside
+                        T torque_t = 0;
+                        T max_bias = 2;
+                        T dOmega_crank = 0.;
+                        // If we have a torque converter
+                        if(hasFeature<F, FEATURE_TC>(v_params)){
+                            // Split the angular velocities all the way uptill the gear box. All from previous time step
+                            T omega_t = 0.25 * (tirelf_st._omega + tirerf_st._omega + tirelr_st._omega + tirerr_st._omega);
+                            
+                            // get the angular velocity at the torque converter wheel side 
+                            // Note, the gear includes the differential gear as well
+                            P gear_ratio = gearRatio(v_params._gearRatios, v_states._current_gr);
+                            T omega_out = omega_t / gear_ratio;
+
+                            // Get the omega input to the torque from the engine from the previous time step
+                            T omega_in = v_states._crankOmega;
+
+                            // if we are at the start things can get unstable - the speed ratio is then 0
+                            FlagT<T> start = (omega_out < 1e-9) | (omega_in < 1e-9);
+
+                            // speed ratio for torque converter
+                            T sr = omega_out / omega_in;
+
+                            // Check reverse flow
+                            FlagT<T> reverse_flow = (!start) & (sr > 1.);
+                            sr = select(reverse_flow, T(1. - (sr - 1.)), sr);
+                            sr = select(start | (sr < 0.), T(0.), sr);
+                            v_states._tc_reverse_flow = reverse_flow;
+
+                            // get capacity factor from lookup table
+                            T cf = getMapY(v_params._CFmap,v_params._CFLUT,sr);
+
+                            // Get torque ratio from Torque ratio lookup table 
+                            T tr = getMapY(v_params._TRmap,v_params._TRLUT,sr);
+
+                            // torque applied to the crank shaft
+                            T torque_in = -pow((omega_in / cf),2);
+
+                            // if its reverse flow, this should act as a brake
+                            torque_in = select(reverse_flow, -torque_in, torque_in);
+
+                            // torque applied to the shaft from torque converter on the wheel side
+                            T torque_out = select(reverse_flow, -torque_in, -tr * torque_in);
+
+                            // Now torque after the transimission
+                            torque_t = torque_out / gear_ratio;
+                            torque_t = select((v_states._u < 1e-9) & (torque_t < 0.), T(0.), torque_t);
+
+                            /////// DEBUG
+                            v_states._tc_inp_tor = -torque_in;
+                            v_states._tc_out_tor = torque_out;
+                            v_states._tc_out_omg = omega_out;
+                            v_states._sr = sr;
+
+                            //////// Crank shaft acceleration
+
+                            v_states._debugtor = driveTorque<F>(v_params, throttle, v_states._crankOmega); //// DEBUG
+                            dOmega_crank = (1./v_params._crankInertia) * (v_states._debugtor + torque_in);
+
+                            // Gear shifts look at the RPM of the shaft from the T.C
+                            shaft_speed = omega_out;
+
+                        }
+                        else{ // if there is no torque converter, things are simple
+                            P gear_ratio = gearRatio(v_params._gearRatios, v_states._current_gr);
+
+                            // In this case, there is no state for the engine omega
+                            v_states._crankOmega = 0.25 * (tirelf_st._omega + tirerf_st._omega + tirelr_st._omega + tirerr_st._omega)
+                                                    / gear_ratio;
+
+                            // The torque after tranny will then just become as there is no torque converter
+                            torque_t = driveTorque<F>(v_params, throttle, v_states._crankOmega) / gear_ratio;
+                            torque_t = select((v_states._u < 1e-9) & (torque_t < 0.), T(0.), torque_t);
+
+                            // Here the crank shaft is directly connected to the gear box
+                            shaft_speed = v_states._crankOmega;
+                        }
+
+                        //////// Amount of torque transmitted to the wheels
+
+                        // torque split between the  front and rear (always half)
+                        T torque_front = torque_t * 0.5;
+                        T torque_rear = torque_t * 0.5;
+
+
+                        // first the front wheels
+                        differentialSplit(torque_front, max_bias, tirelf_st._omega, tirerf_st._omega, tirelf_st._engTor, tirerf_st._engTor);
+                        // then rear wheels
+                        differentialSplit(torque_rear, max_bias, tirelr_st._omega, tirerr_st._omega, tirelr_st._engTor, tirerr_st._engTor);
+
+
+                        // Get dOmega for each tire
+                        dOmega[0] = (1/t_params._jw) * (tirelf_st._engTor + tirelf_st._My - sgn(tirelf_st._omega) 
+                                            * brakeTorque(v_params, brake) - tirelf_st._fx * tirelf_st._rStat);
+
+                        dOmega[1] = (1/t_params._jw) * (tirerf_st._engTor + tirerf_st._My - sgn(tirerf_st._omega) 
+                                            * brakeTorque(v_params, brake) - tirerf_st._fx * tirerf_st._rStat);
+
+                        dOmega[2] = (1/t_params._jw) * (tirelr_st._engTor + tirelr_st._My - sgn(tirelr_st._omega) 
+                                            * brakeTorque(v_params, brake) - tirelr_st._fx * tirelr_st._rStat);
+
+                        dOmega[3] = (1/t_params._jw) * (tirerr_st._engTor + tirerr_st._My - sgn(tirerr_st._omega) 
+                                            * brakeTorque(v_params, brake) - tirerr_st._fx * tirerr_st._rStat);
+
+                        return dOmega_crank;
+}
+
+/*
+Gear shift for the next time step based on the shaft speed from powertrainRates
+*/
+template <typename T>
+void EightDOF::gearShift(VehicleStateT<T>& v_states, const VehicleParamT<T>& v_params, const T shaft_speed){
+    gearShift<FEATURES_RUNTIME>(v_states, v_params, shaft_speed);
+}
+
+template <int F, typename T, typename P>
+void EightDOF::gearShift(VehicleStateT<T>& v_states, const VehicleParamT<P>& v_params, const T shaft_speed){
+    // without a torque converter the first gear is never shifted into
+    int lowest = hasFeature<F, FEATURE_TC>(v_params) ? 0 : 1;
+    int highest = int(v_params._gearRatios.size()) - 1;
+    GearT<T> gear = v_states._current_gr;
+
+    // upshift if we have enough gears, else downshift if we can
+    FlagT<T> up = shaft_speed > v_params._upshift_RPS;
+    FlagT<T> down = (!up) & (shaft_speed < v_params._downshift_RPS);
+    v_states._current_gr = select(up & (gear < highest), gear + 1,
+                                    select(down & (gear > lowest), gear - 1, gear));
+}
+
+/*
+Function to evalaute the drive line and engine torques and advance the wheel angular velocites
+*/
+
+template <typename T>
+void EightDOF::evalPowertrain(VehicleStateT<T>& v_states, TMeasyStateT<T>& tirelf_st,
+                    TMeasyStateT<T>& tirerf_st, TMeasyStateT<T>& tirelr_st, 
+                    TMeasyStateT<T>& tirerr_st, const VehicleParamT<T>& v_params, const TMeasyParamT<T>& t_params,
+                    const std::vector <double>& controls){
+    evalPowertrain<FEATURES_RUNTIME>(v_states, tirelf_st, tirerf_st, tirelr_st, tirerr_st, v_params, t_params, controls);
+}
+
+template <int F, typename T>
+void EightDOF::evalPowertrain(VehicleStateT<T>& v_states, TMeasyStateT<T>& tirelf_st,
+                    TMeasyStateT<T>& tirerf_st, TMeasyStateT<T>& tirelr_st, 
+                    TMeasyStateT<T>& tirerr_st, const VehicleParamT<T>& v_params, const TMeasyParamT<T>& t_params,
+                    const std::vector <double>& controls){
+                        // get controls
+                        T throttle = controls[2];
+                        T brake = controls[3];
+
+                        evalPowertrain<F>(v_states, tirelf_st, tirerf_st, tirelr_st, tirerr_st, v_params, t_params,
+                                            primal(throttle), primal(brake));
+}
+
+template <int F, typename T, typename U, typename P>
+void EightDOF::evalPowertrain(VehicleStateT<T>& v_states, TMeasyStateT<T>& tirelf_st,
+                    TMeasyStateT<T>& tirerf_st, TMeasyStateT<T>& tirelr_st, 
+                    TMeasyStateT<T>& tirerr_st, const VehicleParamT<P>& v_params, const TMeasyParamT<P>& t_params,
+                    const U throttle, const U brake){
+                        EDOF_PROFILE_STAGE(STAGE_POWERTRAIN);
+
+                        T dOmega[4];
+                        T shaft_speed;
+                        T dOmega_crank = powertrainRates<F>(v_states, tirelf_st, tirerf_st, tirelr_st, tirerr_st, v_params, t_params,
+                                                                throttle, brake, dOmega, shaft_speed);
+
+                        //////// Integrate Crank shaft
+                        if(hasFeature<F, FEATURE_TC>(v_params)){
+                            v_states._crankOmega = v_states._crankOmega + v_params._step * dOmega_crank;
+                        }
+
+                        ////// Gear shift for the next time step
+                        gearShift<F>(v_states, v_params, shaft_speed);
+
+                        // integrate omega using the latest dOmega
+                        tirelf_st._omega = tirelf_st._omega + t_params._step * dOmega[0];
+                        tirerf_st._omega = tirerf_st._omega + t_params._step * dOmega[1];
+                        tirelr_st._omega = tirelr_st._omega + t_params._step * dOmega[2];
+                        tirerr_st._omega = tirerr_st._omega + t_params._step * dOmega[3];
+
+}
+
+/*
+function to advance the time step of the 8DOF vehicle
+along with the vehicle state that will be updated, we pass the
+vehicle paramters , a vector containing the longitudinal forces,
+and a vector containing the lateral forces by reference, the front
+and rear unspring mass positions (loaded tire radius) and the controls 
+--- There is no point passing all the tire states and paramters 
+since none of the are used here - however, there is thus an additional
+copy in main for getting these states into a vector. So thus, do not know
+if this way is actually faster, but I think it is much cleaner than passing 
+4 tire states and paramaters
+*/
+
+template <typename T>
+void EightDOF::vehAdv(VehicleStateT<T>& v_states, const VehicleParamT<T>& v_params,
+            const std::vector <T>& fx, const std::vector <T>& fy, const T huf, const T hur){
+    VehicleInvariantsT<T> inv;
+    vehInvariants(inv, v_params);
+    vehAdv(v_states, v_params, inv, fx.data(), fy.data(), huf, hur);
+}
+
+template <typename T, typename P>
+void EightDOF::vehAdv(VehicleStateT<T>& v_states, const VehicleParamT<P>& v_params, const VehicleInvariantsT<P>& inv,
+            const T* fx, const T* fy, const T huf, const T hur){
+    EDOF_PROFILE_STAGE(STAGE_VEH_ADV);
+
+    // Integration using half implicit - level 2 variables found first in next time step
+    vehAccelerations(v_states, v_params, inv, fx, fy);
+
+    // update the level 1 varaibles using the next time step level 2 variable
+    v_states._u = v_states._u + v_params._step * v_states._udot;
+    v_states._v = v_states._v + v_params._step * v_states._vdot;
+    v_states._wx = v_states._wx + v_params._step * v_states._wxdot;
+    v_states._wz = v_states._wz + v_params._step * v_states._wzdot;
+
+
+    // update the level 0 varaibles using the next time step level 1 varibales
+    // over here still using the old psi and phi.. should we update psi and phi 
+    // first and then use those????
+
+    v_states._x = v_states._x + v_params._step * 
+                    (v_states._u * cos(v_states._psi) - v_states._v * sin(v_states._psi));
+
+    v_states._y = v_states._y + v_params._step * 
+                    (v_states._u * sin(v_states._psi) + v_states._v * cos(v_states._psi));
+    
+    v_states._psi = v_states._psi + v_params._step * v_states._wz;
+    v_states._phi = v_states._phi + v_params._step * v_states._wx;
+
+
+    vehLoads(v_states, v_params, inv, huf, hur);
+
+}
+
+/*
+Quantities of the chassis equations that only depend on the parameters. They are computed
+exactly as they used to be inside vehAccelerations and vehLoads so that the results do not change
+*/
+template <typename T>
+void EightDOF::vehInvariants(VehicleInvariantsT<T>& inv, const VehicleParamT<T>& v_params){
+
+    // get the total mass of the vehicle and the vertical distance from the sprung
+    // mass C.M. to the vehicle 
+    inv._mt = v_params._m + 2 * (v_params._muf + v_params._mur);
+    inv._invMt = 1/inv._mt;
+    inv._hrc = (v_params._hrcf * v_params._b + v_params._hrcr * v_params._a) / (v_params._a + v_params._b);
+
+    inv._A1 = v_params._mur*v_params._b - v_params._muf*v_params._a;
+    inv._A2 = v_params._jx + v_params._m * pow(inv._hrc,2);
+    inv._A3 = inv._hrc * v_params._m;
+
+    inv._A1sq = pow(inv._A1,2);
+    inv._A3sq = pow(inv._A3,2);
+    inv._jxzsq = pow(v_params._jxz,2);
+    inv._A1A2 = inv._A1*inv._A2;
+    inv._A1A3 = inv._A1*inv._A3;
+
+    // common denominator
+    inv._denom =(inv._A2*inv._A1sq - 2.*inv._A1*inv._A3*v_params._jxz + v_params._jz*inv._A3sq +
+                    inv._mt*inv._jxzsq - inv._A2*v_params._jz*inv._mt);
+
+    inv._mGhrc = v_params._m * G * inv._hrc;
+    inv._kro = v_params._krof + v_params._kror;
+    inv._bro = v_params._brof + v_params._bror;
+    inv._udotWz = -v_params._mur*v_params._b + v_params._muf*v_params._a;
+    inv._e2Wz = -v_params._muf*v_params._a + v_params._mur*v_params._b;
+    inv._twoHrcM = 2.*inv._hrc*v_params._m;
+
+    // load transfer
+    inv._Z1f = (v_params._m*G*v_params._b) / (2.*(v_params._a + v_params._b)) +
+                (v_params._muf*G)/2.;
+    inv._Z1r = (v_params._m*G*v_params._a) / (2.*(v_params._a + v_params._b)) +
+                (v_params._mur*G)/2.;
+    inv._Z2f = v_params._m*v_params._b*(v_params._h - v_params._hrcf) /
+                    (v_params._cf*(v_params._a + v_params._b));
+    inv._Z2r = v_params._m*v_params._a*(v_params._h - v_params._hrcr) /
+                    (v_params._cr*(v_params._a + v_params._b));
+    inv._mh = v_params._m*v_params._h;
+    inv._twoL = 2.*(v_params._a + v_params._b);
+}
+
+/*
+Accelerations of the chassis (the level 2 variables) for the tire forces in the vehicle frame
+*/
+template <typename T>
+void EightDOF::vehAccelerations(VehicleStateT<T>& v_states, const VehicleParamT<T>& v_params, const T* fx, const T* fy){
+    VehicleInvariantsT<T> inv;
+    vehInvariants(inv, v_params);
+    vehAccelerations(v_states, v_params, inv, fx, fy);
+}
+
+template <typename T, typename P>
+void EightDOF::vehAccelerations(VehicleStateT<T>& v_states, const VehicleParamT<P>& v_params, const VehicleInvariantsT<P>& inv,
+                                const T* fx, const T* fy){
+
+    // a bunch of varaibles to simplify the formula
+    T E1 = -inv._mt * v_states._wz * v_states._u + (fy[0] + fy[1] + fy[2] + fy[3]);
+    
+    
+    T E2 = (fy[0] + fy[1])*v_params._a - (fy[2] + fy[3])*v_params._b + (fx[1] - fx[0])*v_params._cf/2 +
+                (fx[3] - fx[2])*v_params._cr/2 + inv._e2Wz*v_states._wz*v_states._u;
+    
+    
+    T E3 = inv._mGhrc * v_states._phi - inv._kro*v_states._phi - 
+                inv._bro*v_states._wx + inv._A3*v_states._wz*v_states._u;
+
+    P A1 = inv._A1;
+    P A2 = inv._A2;
+    P A3 = inv._A3;
+    P mt = inv._mt;
+
+
+    // the acceleration states - level 2 variables
+
+    v_states._udot = v_states._wz*v_states._v + inv._invMt*((fx[0] + fx[1] + fx[2] + fx[3]) +  
+                        inv._udotWz*pow(v_states._wz,2) -
+                        inv._twoHrcM*v_states._wz*v_states._wx);
+
+    v_states._vdot = (E1*inv._jxzsq - inv._A1A2*E2 + A1*E3*v_params._jxz + 
+                        A3*E2*v_params._jxz - A2*E1*v_params._jz - A3*E3*v_params._jz) / inv._denom;
+
+    v_states._wxdot = (inv._A1sq*E3 - inv._A1A3*E2 + A1*E1*v_params._jxz - A3*E1*v_params._jz +
+                        E2*v_params._jxz*mt - E3*v_params._jz*mt) / inv._denom;
+
+    v_states._wzdot = (inv._A3sq*E2 - inv._A1A2*E1 - inv._A1A3*E3 + A3*E1*v_params._jxz -
+                        A2*E2*mt + E3*v_params._jxz*mt) / inv._denom;
+
+}
+
+/*
+Vertical tire forces from the current chassis states and accelerations
+*/
+template <typename T>
+void EightDOF::vehLoads(VehicleStateT<T>& v_states, const VehicleParamT<T>& v_params, const T huf, const T hur){
+    VehicleInvariantsT<T> inv;
+    vehInvariants(inv, v_params);
+    vehLoads(v_states, v_params, inv, huf, hur);
+}
+
+template <typename T, typename P>
+void EightDOF::vehLoads(VehicleStateT<T>& v_states, const VehicleParamT<P>& v_params, const VehicleInvariantsT<P>& inv,
+                        const T huf, const T hur){
+
+    // sketchy load transfer technique
+
+    P Z1 = inv._Z1f;
+    
+    T Z2 = ((v_params._muf*huf)/v_params._cf + inv._Z2f)*(v_states._vdot 
+                    + v_states._wz*v_states._u);
+
+    T Z3 = (v_params._krof * v_states._phi + v_params._brof * v_states._wx) / v_params._cf;
+    
+    T Z4 = ((inv._mh + v_params._muf*huf + v_params._mur*hur) *
+                (v_states._udot - v_states._wz*v_states._v)) / inv._twoL;
+
+    // evaluate the vertical forces for front
+    v_states._fzlf = select((Z1 - Z2 - Z3 - Z4) > 0., (Z1 - Z2 - Z3 - Z4), T(0.));
+    v_states._fzrf = select((Z1 + Z2 + Z3 - Z4) > 0., (Z1 + Z2 + Z3 - Z4), T(0.));
+
+    Z1 = inv._Z1r;
+
+    Z2 =  ((v_params._mur*hur)/v_params._cr + inv._Z2r)*(v_states._vdot 
+                    + v_states._wz*v_states._u);
+    
+    Z3 = (v_params._kror * v_states._phi + v_params._bror * v_states._wx) / v_params._cr;
+
+    // evaluate vertical forces for the rear
+    v_states._fzlr = select((Z1 - Z2 - Z3 + Z4) > 0., (Z1 - Z2 - Z3 + Z4), T(0.));
+    v_states._fzrr = select((Z1 + Z2 + Z3 + Z4) > 0., (Z1 + Z2 + Z3 + Z4), T(0.));
+
+}
+
+template <typename T>
+void EightDOF::vehToTireTransform(TMeasyStateT<T>& tirelf_st,TMeasyStateT<T>& tirerf_st,
+                            TMeasyStateT<T>& tirelr_st, TMeasyStateT<T>& tirerr_st, 
+                            const VehicleStateT<T>& v_states, const VehicleParamT<T>& v_params, const std::vector <double>& controls){
+    vehToTireTransform<FEATURES_RUNTIME>(tirelf_st, tirerf_st, tirelr_st, tirerr_st, v_states, v_params, controls);
+}
+
+template <int F, typename T>
+void EightDOF::vehToTireTransform(TMeasyStateT<T>& tirelf_st,TMeasyStateT<T>& tirerf_st,
+                            TMeasyStateT<T>& tirelr_st, TMeasyStateT<T>& tirerr_st, 
+                            const VehicleStateT<T>& v_states, const VehicleParamT<T>& v_params, const std::vector <double>& controls){
+                            // Get the steering considering the mapping might be non linear
+                            T delta = steerAngle<F>(v_params, controls[1]);
+                            vehToTireTransform<F>(tirelf_st, tirerf_st, tirelr_st, tirerr_st, v_states, v_params, delta);
+                            }
+
+template <int F, typename T, typename P>
+void EightDOF::vehToTireTransform(TMeasyStateT<T>& tirelf_st,TMeasyStateT<T>& tirerf_st,
+                            TMeasyStateT<T>& tirelr_st, TMeasyStateT<T>& tirerr_st, 
+                            const VehicleStateT<T>& v_states, const VehicleParamT<P>& v_params, const T delta){
+                            EDOF_PROFILE_STAGE(STAGE_VEH_TO_TIRE);
+
+                            // left front
+                            tirelf_st._fz = v_states._fzlf; 
+                            tirelf_st._vsy = v_states._v + v_states._wz * v_params._a;
+                            tirelf_st._vsx = (v_states._u - (v_states._wz * v_params._cf)/2.) * cos(delta) +
+                                     tirelf_st._vsy * sin(delta);
+
+                            // right front
+                            tirerf_st._fz = v_states._fzrf;
+                            tirerf_st._vsy = v_states._v + v_states._wz * v_params._a;
+                            tirerf_st._vsx = (v_states._u + (v_states._wz * v_params._cf)/2.) * cos(delta) +
+                                    tirerf_st._vsy * sin(delta);
+
+                            // left rear - No steer
+                            tirelr_st._fz = v_states._fzlr;
+                            tirelr_st._vsy = v_states._v - v_states._wz * v_params._b;
+                            tirelr_st._vsx = v_states._u - (v_states._wz * v_params._cr)/2.;
+
+                            // rigth rear - No steer
+                            tirerr_st._fz = v_states._fzrr;
+                            tirerr_st._vsy = v_states._v - v_states._wz * v_params._b;
+                            tirerr_st._vsx = v_states._u + (v_states._wz * v_params._cr)/2.;
+
+                            }
+
+
+template <typename T>
+void EightDOF::tireToVehTransform(TMeasyStateT<T>& tirelf_st,TMeasyStateT<T>& tirerf_st,
+                            TMeasyStateT<T>& tirelr_st, TMeasyStateT<T>& tirerr_st,
+                            const VehicleStateT<T>& v_states, const VehicleParamT<T>& v_params, const std::vector <double>& controls){
+    tireToVehTransform<FEATURES_RUNTIME>(tirelf_st, tirerf_st, tirelr_st, tirerr_st, v_states, v_params, controls);
+}
+
+template <int F, typename T>
+void EightDOF::tireToVehTransform(TMeasyStateT<T>& tirelf_st,TMeasyStateT<T>& tirerf_st,
+                            TMeasyStateT<T>& tirelr_st, TMeasyStateT<T>& tirerr_st,
+                            const VehicleStateT<T>& v_states, const VehicleParamT<T>& v_params, const std::vector <double>& controls){
+                            // Get the steering considering the mapping might be non linear
+                            T delta = steerAngle<F>(v_params, controls[1]);
+                            tireToVehTransform<F>(tirelf_st, tirerf_st, tirelr_st, tirerr_st, v_states, v_params, delta);
+                            }
+
+template <int F, typename T, typename P>
+void EightDOF::tireToVehTransform(TMeasyStateT<T>& tirelf_st,TMeasyStateT<T>& tirerf_st,
+                            TMeasyStateT<T>& tirelr_st, TMeasyStateT<T>& tirerr_st,
+                            const VehicleStateT<T>& v_states, const VehicleParamT<P>& v_params, const T delta){
+                            EDOF_PROFILE_STAGE(STAGE_TIRE_TO_VEH);
+
+                            T _fx,_fy;
+
+                            // left front
+                            _fx = tirelf_st._fx * cos(delta) - tirelf_st._fy * sin(delta);
+                            _fy = tirelf_st._fx * sin(delta) + tirelf_st._fy * cos(delta);
+                            tirelf_st._fx = _fx;
+                            tirelf_st._fy = _fy;
+
+                            // right front
+                            _fx = tirerf_st._fx * cos(delta) - tirerf_st._fy * sin(delta);
+                            _fy = tirerf_st._fx * sin(delta) + tirerf_st._fy * cos(delta);
+                            tirerf_st._fx = _fx;
+                            tirerf_st._fy = _fy;
+
+                            // rear tires - No steer so no need to transform
+                            }
+
+
+///////////////////////////////////////////////////////////////////////////// Tire Functions /////////////////////////////////////////////////////////
+
+/*
+Code for the TM easy tire model implemented with the 8DOF model
+*/
+template <typename T>
+void EightDOF::tireInit(TMeasyParamT<T>& t_params){
+    
+    // calculates some critical values that are needed
+    t_params._fzRdynco = (t_params._pn * (t_params._rdyncoP2n - 2.0 * t_params._rdyncoPn + 1.)) /
+                            (2. * (t_params._rdyncoP2n - t_params._rdyncoPn));
+
+    t_params._rdyncoCrit = InterpL(t_params._fzRdynco, t_params._rdyncoPn, t_params._rdyncoP2n,t_params._pn);
+
+}
+
+
+
+template <typename T>
+void EightDOF::tmxy_combined(T& f, T& fos, T s, T df0, T sm, T fm, T ss, T fs){
+
+    T df0loc = 0.0;
+    if (sm > 0.0) {
+        df0loc = std::max<T>(2.0 * fm / sm, df0);
+    }
+
+    if (s > 0.0 && df0loc > 0.0) {  // normal operating conditions
+        if (s > ss) {               // full sliding
+            f = fs;
+            fos = f / s;
+        } else {
+            if (s < sm) {  // adhesion
+                T p = df0loc * sm / fm - 2.0;
+                T sn = s / sm;
+                T dn = 1.0 + (sn + p) * sn;
+                f = df0loc * sm * sn / dn;
+                fos = df0loc / dn;
+            } else {
+                T a = pow(fm / sm, 2.0) / (df0loc * sm);  // parameter from 2. deriv. of f @ s=sm
+                T sstar = sm + (fm - fs) / (a * (ss - sm));    // connecting point
+                if (sstar <= ss) {                                  // 2 parabolas
+                    if (s <= sstar) {
+                        // 1. parabola sm < s < sstar
+                        f = fm - a * (s - sm) * (s - sm);
+                    } else {
+                        // 2. parabola sstar < s < ss
+                        T b = a * (sstar - sm) / (ss - sstar);
+                        f = fs + b * (ss - s) * (ss - s);
+                    }
+                } else {
+                    // cubic fallback function
+                    T sn = (s - sm) / (ss - sm);
+                    f = fm - (fm - fs) * sn * sn * (3.0 - 2.0 * sn);
+                }
+                fos = f / s;
+            }
+        }
+    } else {
+        f = 0.0;
+        fos = 0.0;
+    }
+
+
+}
+
+
+template <typename T>
+void EightDOF::tmxy_combined_select(T& f, T& fos, T& dfds, T s, T df0, T sm, T fm, T ss, T fs){
+
+    T df0m = 2.0 * fm / sm;
+    T df0loc = select(sm > 0.0, select(df0m < df0, df0, df0m), T(0.0));
+
+    // adhesion - s < sm
+    T p = df0loc * sm / fm - 2.0;
+    T sn = s / sm;
+    T dn = 1.0 + (sn + p) * sn;
+    T fAdh = df0loc * sm * sn / dn;
+    T fosAdh = df0loc / dn;
+    T dAdh = df0loc * (1.0 - sn * sn) / (dn * dn);
+
+    // 2 parabolas meeting at sstar, or the cubic fallback if sstar is beyond ss
+    T a = pow(fm / sm, 2.0) / (df0loc * sm);
+    T sstar = sm + (fm - fs) / (a * (ss - sm));
+    T b = a * (sstar - sm) / (ss - sstar);
+    T f1 = fm - a * (s - sm) * (s - sm);
+    T d1 = -2.0 * a * (s - sm);
+    T f2 = fs + b * (ss - s) * (ss - s);
+    T d2 = -2.0 * b * (ss - s);
+    T snc = (s - sm) / (ss - sm);
+    T fc = fm - (fm - fs) * snc * snc * (3.0 - 2.0 * snc);
+    T dc = -6.0 * (fm - fs) * snc * (1.0 - snc) / (ss - sm);
+
+    // the branches of tmxy_combined as masks - the branches not taken may be inf or nan
+    auto normal = (s > 0.0) & (df0loc > 0.0);
+    auto sliding = s > ss;
+    auto adhesion = (!sliding) & (s < sm);
+    auto parabolas = sstar <= ss;
+    auto first = s <= sstar;
+
+    T fMid = select(parabolas, select(first, f1, f2), fc);
+    T dMid = select(parabolas, select(first, d1, d2), dc);
+    T fn = select(sliding, fs, select(adhesion, fAdh, fMid));
+    T fosn = select(adhesion, fosAdh, T(fn / s));
+    T dn_ds = select(sliding, T(0.0), select(adhesion, dAdh, dMid));
+
+    f = select(normal, fn, T(0.0));
+    fos = select(normal, fosn, T(0.0));
+    dfds = select(normal, dn_ds, T(0.0));
+}
+
+
+/*
+Slips, force characteristics and rolling resistance of a tire for the given steering angle.
+Also updates the tire deflection _xt, the loaded radius _rStat and _My of the states
+*/
+template <typename T>
+void EightDOF::tireSlip(TireSlipT<T>& slip, TMeasyStateT<T>& t_states, const TMeasyParamT<T>& t_params, const T delta){
+
+    // Get the whichTire based variables out of the way
+    T fz = t_states._fz; // vertical force 
+    T vsy = t_states._vsy; // y slip velocity
+    T vsx = t_states._vsx; // x slip velocity
+
+    // get our tire deflections so that we can get the loaded radius
+    t_states._xt = fz / t_params._kt;
+    t_states._rStat = t_params._r0 - t_states._xt;
+
+
+    T r_eff;
+    T rdynco;
+    if(fz <= t_params._fzRdynco){
+        rdynco = InterpL(fz, t_params._rdyncoPn, t_params._rdyncoP2n,t_params._pn);
+        r_eff = rdynco * t_params._r0 + (1. - rdynco) * t_states._rStat; 
+    }
+    else {
+        rdynco = t_params._rdyncoCrit;
+        r_eff = rdynco * t_params._r0 + (1. - rdynco) * t_states._rStat;  
+    }
+    // with this r_eff, we can finalize the x slip velocity
+    vsx = vsx - (t_states._omega * r_eff);
+
+    // get the transport velocity - 0.01 here is to prevent singularity
+    T vta = r_eff * abs(t_states._omega) + 0.01;
+
+    // evaluate the slips
+    T sx = -vsx / vta;
+    T alpha;
+    // only front wheel steering
+    alpha = atan2(vsy,vta) - delta;
+    T sy = -tan(alpha);
+
+    // limit fz
+    if(fz > t_params._pnmax){
+        fz = t_params._pnmax;
+    }
+
+    // calculate all curve parameters through interpolation
+    T dfx0 = InterpQ(fz, t_params._dfx0Pn, t_params._dfx0P2n, t_params._pn);
+    T dfy0 = InterpQ(fz, t_params._dfy0Pn, t_params._dfy0P2n, t_params._pn);
+
+    T fxm = InterpQ(fz, t_params._fxmPn, t_params._fxmP2n, t_params._pn);
+    T fym = InterpQ(fz, t_params._fymPn, t_params._fymP2n, t_params._pn);
+    
+    T fxs = InterpQ(fz, t_params._fxsPn, t_params._fxsP2n, t_params._pn);
+    T fys = InterpQ(fz, t_params._fysPn, t_params._fysP2n, t_params._pn);
+
+    T sxm = InterpL(fz, t_params._sxmPn, t_params._sxmP2n, t_params._pn);
+    T sym = InterpL(fz, t_params._symPn, t_params._symP2n, t_params._pn);
+
+    T sxs = InterpL(fz, t_params._sxsPn, t_params._sxsP2n, t_params._pn);
+    T sys = InterpL(fz, t_params._sysPn, t_params._sysP2n, t_params._pn);
+
+    // slip normalizing factors
+    T hsxn = sxm / (sxm + sym) + (fxm / dfx0) / (fxm / dfx0 + fym / dfy0);
+    T hsyn = sym / (sxm + sym) + (fym / dfy0) / (fxm / dfx0 + fym / dfy0);
+
+
+    // normalized slip
+    T sxn = sx / hsxn;
+    T syn = sy / hsyn;
+
+    // combined slip
+    T sc = hypot(sxn, syn);
+
+    // cos and sine alphs
+    T calpha;
+    T salpha;
+    if(sc > 0){
+        calpha = sxn/sc;
+        salpha = syn/sc;
+    }
+    else{
+        calpha = sqrt(2.) / 2.;
+        salpha = sqrt(2.) / 2.;
+    }
+
+    // resultant curve parameters in both directions
+    T df0 = hypot(dfx0 * calpha * hsxn, dfy0 * salpha * hsyn);
+    T fm  = hypot(fxm * calpha, fym * salpha);
+    T sm = hypot(sxm * calpha / hsxn, sym * salpha / hsyn);
+    T fs = hypot(fxs * calpha, fys * salpha);
+    T ss = hypot(sxs * calpha / hsxn, sys * salpha / hsyn);
+
+    // calculate force and force /slip from the curve characteritics
+    T f,fos;
+    tmxy_combined(f, fos, sc, df0, sm, fm, ss, fs);
+
+    // rolling resistance with smoothing
+    double vx_min = 0.;
+    double vx_max = 0.;
+
+
+    t_states._My = -sineStep(vta,vx_min,0.,vx_max,1.) * t_params._rr * fz * t_states._rStat * sgn(t_states._omega);
+
+    slip._vsx = vsx;
+    slip._vta = vta;
+    slip._sy = sy;
+    slip._fos = fos;
+
+    // some normalised slip velocities
+    slip._vtxs = vta * hsxn;
+    slip._vtys = vta * hsyn;
+}
+
+/*
+Tire deflection rates and the resulting tire forces for the current deflections - the continuous
+form of the half implicit update in tireAdv
+*/
+template <typename T>
+void EightDOF::tireForceRates(TMeasyStateT<T>& t_states, const TMeasyParamT<T>& t_params, const TireSlipT<T>& slip){
+
+    T vtxs = slip._vtxs;
+    T vtys = slip._vtys;
+    T fos = slip._fos;
+
+    t_states._xedot = (-vtxs * t_params._cx * t_states._xe - fos * slip._vsx) /
+                        (vtxs * t_params._dx + fos);
+    t_states._yedot = (-vtys * t_params._cy * t_states._ye - fos * (-slip._sy * slip._vta)) /
+                        (vtys * t_params._dy + fos);
+
+    T fxdyn = t_params._dx * t_states._xedot + t_params._cx * t_states._xe;
+    T fydyn = t_params._dy * t_states._yedot + t_params._cy * t_states._ye;
+
+    T fxstr = clamp(t_states._xe * t_params._cx + t_states._xedot * t_params._dx, -t_params._fxmP2n, t_params._fxmP2n);
+    T fystr = clamp(t_states._ye * t_params._cy + t_states._yedot * t_params._dy, -t_params._fymP2n, t_params._fymP2n);
+
+    T weightx = sineStep(abs(slip._vsx), 1., 1., 1.5, 0.);
+    T weighty = sineStep(abs(-slip._sy*slip._vta), 1., 1., 1.5, 0.);
+
+    t_states._fx = weightx * fxstr + (1.-weightx) * fxdyn;
+    t_states._fy = weighty * fystr + (1.-weighty) * fydyn;
+}
+
+
+// Advance the tire to the next time step
+// update the tire forces which will be used by the vehicle
+template <typename T>
+void EightDOF::tireAdv(TMeasyStateT<T>& t_states, const TMeasyParamT<T>& t_params, const VehicleStateT<T>& v_states, const VehicleParamT<T>& v_params, 
+                const std::vector <double>& controls){
+    tireAdv<FEATURES_RUNTIME>(t_states, t_params, v_states, v_params, controls);
+}
+
+template <int F, typename T>
+void EightDOF::tireAdv(TMeasyStateT<T>& t_states, const TMeasyParamT<T>& t_params, const VehicleStateT<T>& v_states, const VehicleParamT<T>& v_params, 
+                const std::vector <double>& controls){
+    EDOF_PROFILE_STAGE(STAGE_TIRE_ADV);
+    
+    // get the controls and time out
+    double t = controls[0];
+
+    T delta = steerAngle<F>(v_params, controls[1]);
+
+    TireSlipT<T> slip;
+    tireSlip(slip, t_states, t_params, delta);
+    T vsx = slip._vsx;
+    T vta = slip._vta;
+    T sy = slip._sy;
+    T fos = slip._fos;
+
+    T h;
+
+    // some normalised slip velocities
+    T vtxs = slip._vtxs;
+    T vtys = slip._vtys;
+
+
+    // some varables needed in the loop
+    T fxdyn, fydyn;
+    T fxstr, fystr;
+    T v_step = v_params._step;
+    T tire_step = t_params._step;
+    // now we integrate to the next vehicle time step
+    double tEnd = t + primal(v_step);
+    while(t < tEnd){
+
+        // ensure that we integrate exactly to step
+        h = std::min<T>(tire_step, tEnd - t);
+
+        // always integrate using half implicit
+        // just a placeholder to simplify the forumlae
+        T dFx = -vtxs * t_params._cx / (vtxs * t_params._dx + fos);
+        
+        t_states._xedot = 1. / (1. - h * dFx) * 
+                    (-vtxs * t_params._cx * t_states._xe - fos * vsx) /
+                    (vtxs * t_params._dx + fos);
+
+        t_states._xe = t_states._xe + h * t_states._xedot;
+
+        T dFy = -vtys * t_params._cy / (vtys * t_params._dy + fos);
+        t_states._yedot = (1. / (1. - h * dFy)) *
+                    (-vtys * t_params._cy * t_states._ye - fos * (-sy * vta)) /
+                    (vtys * t_params._dy + fos);
+
+        t_states._ye = t_states._ye + h * t_states._yedot;
+
+        // update the force since we need to update the force to get the omegas
+        // some wierd stuff happens between the dynamic and structural force
+        fxdyn = t_params._dx * (-vtxs * t_params._cx * t_states._xe - fos * vsx) /
+                (vtxs * t_params._dx + fos) + t_params._cx * t_states._xe;
+        
+        fydyn = t_params._dy * ((-vtys * t_params._cy * t_states._ye - fos * (-sy * vta)) /
+                (vtys * t_params._dy + fos)) + (t_params._cy * t_states._ye);
+
+        
+        fxstr = clamp(t_states._xe * t_params._cx + t_states._xedot * t_params._dx, -t_params._fxmP2n, t_params._fxmP2n);
+        fystr = clamp(t_states._ye * t_params._cy + t_states._yedot * t_params._dy, -t_params._fymP2n, t_params._fymP2n);
+
+        T weightx = sineStep(abs(vsx), 1., 1., 1.5, 0.);
+        T weighty = sineStep(abs(-sy*vta), 1., 1., 1.5, 0.);
+
+        // now finally get the resultant force
+        t_states._fx = weightx * fxstr + (1.-weightx) * fxdyn;
+        t_states._fy = weighty * fystr + (1.-weighty) * fydyn;
+
+        t += primal(h);
+    }
+}
+
+template <int NC, typename T, typename P>
+void EightDOF::tireCorners(TMeasyStateT<T>* tires, const TMeasyParamT<P>& t_params, const VehicleParamT<P>& v_params,
+                const T* delta, double t){
+    const TMeasyParamT<P>& p = t_params;
+
+    // loaded radius, slip velocities and the curve parameters - the same expressions as tireSlip
+    T fz[NC], rStat[NC], vsx[NC], vsy[NC], vta[NC], sx[NC];
+    T dfx0[NC], dfy0[NC], fxm[NC], fym[NC], fxs[NC], fys[NC], sxm[NC], sym[NC], sxs[NC], sys[NC], hsxn[NC], hsyn[NC];
+    for(int c = 0; c < NC; c++){
+        T f = tires[c]._fz;
+        T xt = f / p._kt;
+        tires[c]._xt = xt;
+        rStat[c] = p._r0 - xt;
+        T rdynco = select(f <= p._fzRdynco, InterpL(f, p._rdyncoPn, p._rdyncoP2n, p._pn), T(p._rdyncoCrit));
+        T r_eff = rdynco * p._r0 + (1. - rdynco) * rStat[c];
+        T omega = tires[c]._omega;
+        vsx[c] = tires[c]._vsx - (omega * r_eff);
+        vsy[c] = tires[c]._vsy;
+        vta[c] = r_eff * abs(omega) + 0.01;
+        sx[c] = -vsx[c] / vta[c];
+
+        f = select(f > p._pnmax, T(p._pnmax), f);
+        fz[c] = f;
+        dfx0[c] = InterpQ(f, p._dfx0Pn, p._dfx0P2n, p._pn);
+        dfy0[c] = InterpQ(f, p._dfy0Pn, p._dfy0P2n, p._pn);
+        fxm[c] = InterpQ(f, p._fxmPn, p._fxmP2n, p._pn);
+        fym[c] = InterpQ(f, p._fymPn, p._fymP2n, p._pn);
+        fxs[c] = InterpQ(f, p._fxsPn, p._fxsP2n, p._pn);
+        fys[c] = InterpQ(f, p._fysPn, p._fysP2n, p._pn);
+        sxm[c] = InterpL(f, p._sxmPn, p._sxmP2n, p._pn);
+        sym[c] = InterpL(f, p._symPn, p._symP2n, p._pn);
+        sxs[c] = InterpL(f, p._sxsPn, p._sxsP2n, p._pn);
+        sys[c] = InterpL(f, p._sysPn, p._sysP2n, p._pn);
+        hsxn[c] = sxm[c] / (sxm[c] + sym[c]) + (fxm[c] / dfx0[c]) / (fxm[c] / dfx0[c] + fym[c] / dfy0[c]);
+        hsyn[c] = sym[c] / (sxm[c] + sym[c]) + (fym[c] / dfy0[c]) / (fxm[c] / dfx0[c] + fym[c] / dfy0[c]);
+    }
+
+    // combined slip and the force characteristics, corner by corner. The weights of the
+    // structural forces only depend on the slips, so they are found here once for the step
+    T sy[NC], fos[NC], weightx[NC], weighty[NC];
+    for(int c = 0; c < NC; c++){
+        T alpha = atan2(vsy[c], vta[c]) - delta[c];
+        sy[c] = -tan(alpha);
+
+        T sxn = sx[c] / hsxn[c];
+        T syn = sy[c] / hsyn[c];
+        T sc = hypot(sxn, syn);
+        T calpha = select(sc > 0., T(sxn/sc), T(sqrt(2.) / 2.));
+        T salpha = select(sc > 0., T(syn/sc), T(sqrt(2.) / 2.));
+        T df0 = hypot(dfx0[c] * calpha * hsxn[c], dfy0[c] * salpha * hsyn[c]);
+        T fm  = hypot(fxm[c] * calpha, fym[c] * salpha);
+        T sm = hypot(sxm[c] * calpha / hsxn[c], sym[c] * salpha / hsyn[c]);
+        T fs = hypot(fxs[c] * calpha, fys[c] * salpha);
+        T ss = hypot(sxs[c] * calpha / hsxn[c], sys[c] * salpha / hsyn[c]);
+        // with one result per lane the branches of tmxy_combined become selects
+        T f;
+        if constexpr(ComparesToBool<T>::value){
+            tmxy_combined(f, fos[c], sc, df0, sm, fm, ss, fs);
+        }
+        else{
+            T dfds;
+            tmxy_combined_select(f, fos[c], dfds, sc, df0, sm, fm, ss, fs);
+        }
+
+        tires[c]._rStat = rStat[c];
+        tires[c]._My = -sineStep(vta[c], 0., 0., 0., 1.) * p._rr * fz[c] * rStat[c] * sgn(tires[c]._omega);
+        weightx[c] = sineStep(abs(vsx[c]), 1., 1., 1.5, 0.);
+        weighty[c] = sineStep(abs(-sy[c]*vta[c]), 1., 1., 1.5, 0.);
+    }
+
+    // half implicit integration of the deflections over the tire steps of one vehicle step
+    T vtxs[NC], vtys[NC], dFx[NC], dFy[NC], denx[NC], deny[NC];
+    T xe[NC], ye[NC], xedot[NC], yedot[NC], fx[NC], fy[NC];
+    for(int c = 0; c < NC; c++){
+        vtxs[c] = vta[c] * hsxn[c];
+        vtys[c] = vta[c] * hsyn[c];
+        denx[c] = vtxs[c] * p._dx + fos[c];
+        deny[c] = vtys[c] * p._dy + fos[c];
+        dFx[c] = -vtxs[c] * p._cx / denx[c];
+        dFy[c] = -vtys[c] * p._cy / deny[c];
+        xe[c] = tires[c]._xe;
+        ye[c] = tires[c]._ye;
+        xedot[c] = tires[c]._xedot;
+        yedot[c] = tires[c]._yedot;
+        fx[c] = tires[c]._fx;
+        fy[c] = tires[c]._fy;
+    }
+    P v_step = v_params._step;
+    P tire_step = t_params._step;
+    double tEnd = t + primal(v_step);
+    while(t < tEnd){
+        P rest = tEnd - t;
+        P h = select(rest < tire_step, rest, tire_step);
+        for(int c = 0; c < NC; c++){
+            xedot[c] = 1. / (1. - h * dFx[c]) * (-vtxs[c] * p._cx * xe[c] - fos[c] * vsx[c]) / denx[c];
+            xe[c] = xe[c] + h * xedot[c];
+            yedot[c] = (1. / (1. - h * dFy[c])) * (-vtys[c] * p._cy * ye[c] - fos[c] * (-sy[c] * vta[c])) / deny[c];
+            ye[c] = ye[c] + h * yedot[c];
+
+            T fxdyn = p._dx * (-vtxs[c] * p._cx * xe[c] - fos[c] * vsx[c]) / denx[c] + p._cx * xe[c];
+            T fydyn = p._dy * ((-vtys[c] * p._cy * ye[c] - fos[c] * (-sy[c] * vta[c])) / deny[c]) + (p._cy * ye[c]);
+            T fxstr = clamp(xe[c] * p._cx + xedot[c] * p._dx, T(-p._fxmP2n), T(p._fxmP2n));
+            T fystr = clamp(ye[c] * p._cy + yedot[c] * p._dy, T(-p._fymP2n), T(p._fymP2n));
+            fx[c] = weightx[c] * fxstr + (1.-weightx[c]) * fxdyn;
+            fy[c] = weighty[c] * fystr + (1.-weighty[c]) * fydyn;
+        }
+        t += primal(h);
+    }
+    for(int c = 0; c < NC; c++){
+        tires[c]._xe = xe[c];
+        tires[c]._ye = ye[c];
+        tires[c]._xedot = xedot[c];
+        tires[c]._yedot = yedot[c];
+        tires[c]._fx = fx[c];
+        tires[c]._fy = fy[c];
+    }
+}
+
+template <typename T, typename P>
+void EightDOF::tireAdv4(TMeasyStateT<T>* tires, const TMeasyParamT<P>& t_params, const VehicleParamT<P>& v_params,
+                const T* delta, double t){
+    EDOF_PROFILE_STAGE(STAGE_TIRE_ADV);
+    if constexpr(std::is_same<T, double>::value && CORNER_LANES > 1){
+        // the 4 corners in the lanes of 4 / W tires
+        constexpr int W = CORNER_LANES, NC = 4 / W;
+        TMeasyStateT<Lanes<W> > corners[NC];
+        Lanes<W> d[NC];
+        for(int c = 0; c < 4; c++){
+            TMeasyStateT<Lanes<W> >& l = corners[c / W];
+            int k = c % W;
+            l._fz._v[k] = tires[c]._fz;
+            l._omega._v[k] = tires[c]._omega;
+            l._vsx._v[k] = tires[c]._vsx;
+            l._vsy._v[k] = tires[c]._vsy;
+            l._xe._v[k] = tires[c]._xe;
+            l._ye._v[k] = tires[c]._ye;
+            l._xedot._v[k] = tires[c]._xedot;
+            l._yedot._v[k] = tires[c]._yedot;
+            l._fx._v[k] = tires[c]._fx;
+            l._fy._v[k] = tires[c]._fy;
+            d[c / W]._v[k] = delta[c];
+        }
+        tireCorners<NC>(corners, t_params, v_params, d, t);
+        for(int c = 0; c < 4; c++){
+            const TMeasyStateT<Lanes<W> >& l = corners[c / W];
+            int k = c % W;
+            tires[c]._xt = l._xt._v[k];
+            tires[c]._rStat = l._rStat._v[k];
+            tires[c]._My = l._My._v[k];
+            tires[c]._xe = l._xe._v[k];
+            tires[c]._ye = l._ye._v[k];
+            tires[c]._xedot = l._xedot._v[k];
+            tires[c]._yedot = l._yedot._v[k];
+            tires[c]._fx = l._fx._v[k];
+            tires[c]._fy = l._fy._v[k];
+        }
+    }
+    else{
+        tireCorners<4>(tires, t_params, v_params, delta, t);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////// Vehicle step ///////////////////////////////////////////////////////////
+
+template <int F, typename T, typename U, typename P>
+void EightDOF::stepT(VehicleStateT<T>& v_states, TMeasyStateT<T>* tires, const VehicleParamT<P>& v_params,
+                        const TMeasyParamT<P>& t_params, const VehicleInvariantsT<P>& inv,
+                        const U steering, const U throttle, const U braking, double t){
+    stepT<F>(v_states, tires, v_params, t_params, inv, steering, throttle, braking, t,
+                [&](TMeasyStateT<T>* adv_tires, const T* delta){
+                    tireAdv4(adv_tires, t_params, v_params, delta, t);
+                });
+}
+
+template <int F, typename T, typename U, typename P, typename TireStage>
+void EightDOF::stepT(VehicleStateT<T>& v_states, TMeasyStateT<T>* tires, const VehicleParamT<P>& v_params,
+                        const TMeasyParamT<P>& t_params, const VehicleInvariantsT<P>& inv,
+                        const U steering, const U throttle, const U braking, double t, TireStage advanceTires){
+
+    // the rear tires do not take the steering
+    T delta[4];
+    delta[0] = delta[1] = steerAngle<F>(v_params, steering);
+    delta[2] = delta[3] = steerAngle<F>(v_params, U(0.));
+
+    // transform velocities and other needed quantities from vehicle frame to tire frame
+    vehToTireTransform<F>(tires[0], tires[1], tires[2], tires[3], v_states, v_params, delta[0]);
+
+    // advance our 4 tires together
+    advanceTires(tires, delta);
+
+    // powertrain and the wheel angular velocities
+    evalPowertrain<F>(v_states, tires[0], tires[1], tires[2], tires[3], v_params, t_params, throttle, braking);
+
+    // transform tire forces to vehicle frame
+    tireToVehTransform<F>(tires[0], tires[1], tires[2], tires[3], v_states, v_params, delta[0]);
+
+    T fx[4], fy[4];
+    for(int i = 0; i < 4; i++){
+        fx[i] = tires[i]._fx;
+        fy[i] = tires[i]._fy;
+    }
+    vehAdv(v_states, v_params, inv, fx, fy, tires[0]._rStat, tires[3]._rStat);
+}
+
+/////////////////////////////////////////////////////////////////////// Scalar type conversion ///////////////////////////////////////////////////////////
+
+template <typename T, typename U>
+void EightDOF::convertParams(VehicleParamT<T>& out, const VehicleParamT<U>& in){
+    out._a = in._a; out._b = in._b; out._h = in._h; out._m = in._m;
+    out._jz = in._jz; out._jx = in._jx; out._jxz = in._jxz; out._cf = in._cf;
+    out._cr = in._cr; out._muf = in._muf; out._mur = in._mur; out._hrcf = in._hrcf;
+    out._hrcr = in._hrcr; out._krof = in._krof; out._kror = in._kror; out._brof = in._brof;
+    out._bror = in._bror; out._maxSteer = in._maxSteer; out._crankInertia = in._crankInertia; out._upshift_RPS = in._upshift_RPS;
+    out._downshift_RPS = in._downshift_RPS; out._maxBrakeTorque = in._maxBrakeTorque; out._c1 = in._c1; out._c0 = in._c0;
+    out._step = in._step; out._powertrainScale = in._powertrainScale; out._lossesScale = in._lossesScale;
+
+    // flags, maps and their lookups do not depend on the scalar type
+    out._nonLinearSteer = in._nonLinearSteer;
+    out._tcbool = in._tcbool;
+    out._throttleMod = in._throttleMod;
+    out._steerMap = in._steerMap;
+    out._powertrainMap = in._powertrainMap;
+    out._lossesMap = in._lossesMap;
+    out._CFmap = in._CFmap;
+    out._TRmap = in._TRmap;
+    out._steerLUT = in._steerLUT;
+    out._powertrainLUT = in._powertrainLUT;
+    out._lossesLUT = in._lossesLUT;
+    out._CFLUT = in._CFLUT;
+    out._TRLUT = in._TRLUT;
+    out._gearRatios.assign(in._gearRatios.begin(), in._gearRatios.end());
+}
+
+template <typename T, typename U>
+void EightDOF::convertParams(TMeasyParamT<T>& out, const TMeasyParamT<U>& in){
+    out._jw = in._jw; out._rr = in._rr; out._mu = in._mu; out._r0 = in._r0;
+    out._pn = in._pn; out._pnmax = in._pnmax; out._cx = in._cx; out._cy = in._cy;
+    out._kt = in._kt; out._dx = in._dx; out._dy = in._dy; out._rdyncoPn = in._rdyncoPn;
+    out._rdyncoP2n = in._rdyncoP2n; out._fzRdynco = in._fzRdynco; out._rdyncoCrit = in._rdyncoCrit; out._dfx0Pn = in._dfx0Pn;
+    out._dfx0P2n = in._dfx0P2n; out._fxmPn = in._fxmPn; out._fxmP2n = in._fxmP2n; out._fxsPn = in._fxsPn;
+    out._fxsP2n = in._fxsP2n; out._sxmPn = in._sxmPn; out._sxmP2n = in._sxmP2n; out._sxsPn = in._sxsPn;
+    out._sxsP2n = in._sxsP2n; out._dfy0Pn = in._dfy0Pn; out._dfy0P2n = in._dfy0P2n; out._fymPn = in._fymPn;
+    out._fymP2n = in._fymP2n; out._fysPn = in._fysPn; out._fysP2n = in._fysP2n; out._symPn = in._symPn;
+    out._symP2n = in._symP2n; out._sysPn = in._sysPn; out._sysP2n = in._sysP2n; out._step = in._step;
+}
+
+
+/////////////////////////////////////////////////////////////////////// Parameter names ///////////////////////////////////////////////////////////
+
+// JSON key -> member tables
+template <typename T>
+T* EightDOF::getParamPtr(VehicleParamT<T>& v_params, TMeasyParamT<T>& t_params, const std::string& name){
+    typedef VehicleParamT<T> VP;
+    typedef TMeasyParamT<T> TP;
+    static const struct { const char* _name; T VP::* _member; } veh_param_names[] = {
+        {"a", &VP::_a}, {"b", &VP::_b}, {"h", &VP::_h}, {"m", &VP::_m},
+        {"jz", &VP::_jz}, {"jx", &VP::_jx}, {"jxz", &VP::_jxz},
+        {"cf", &VP::_cf}, {"cr", &VP::_cr}, {"muf", &VP::_muf}, {"mur", &VP::_mur},
+        {"hrcf", &VP::_hrcf}, {"hrcr", &VP::_hrcr},
+        {"krof", &VP::_krof}, {"kror", &VP::_kror}, {"brof", &VP::_brof}, {"bror", &VP::_bror},
+        {"maxSteer", &VP::_maxSteer}, {"crankInertia", &VP::_crankInertia},
+        {"maxBrakeTorque", &VP::_maxBrakeTorque}, {"c1", &VP::_c1}, {"c0", &VP::_c0},
+        {"torqueMapScale", &VP::_powertrainScale}, {"lossesMapScale", &VP::_lossesScale}
+    };
+    static const struct { const char* _name; T TP::* _member; } tire_param_names[] = {
+        {"jw", &TP::_jw}, {"rr", &TP::_rr}, {"r0", &TP::_r0},
+        {"pn", &TP::_pn}, {"pnmax", &TP::_pnmax},
+        {"cx", &TP::_cx}, {"cy", &TP::_cy}, {"kt", &TP::_kt},
+        {"dx", &TP::_dx}, {"dy", &TP::_dy},
+        {"rdyncoPn", &TP::_rdyncoPn}, {"rdyncoP2n", &TP::_rdyncoP2n},
+        {"dfx0Pn", &TP::_dfx0Pn}, {"dfx0P2n", &TP::_dfx0P2n},
+        {"fxmPn", &TP::_fxmPn}, {"fxmP2n", &TP::_fxmP2n},
+        {"fxsPn", &TP::_fxsPn}, {"fxsP2n", &TP::_fxsP2n},
+        {"sxmPn", &TP::_sxmPn}, {"sxmP2n", &TP::_sxmP2n},
+        {"sxsPn", &TP::_sxsPn}, {"sxsP2n", &TP::_sxsP2n},
+        {"dfy0Pn", &TP::_dfy0Pn}, {"dfy0P2n", &TP::_dfy0P2n},
+        {"fymPn", &TP::_fymPn}, {"fymP2n", &TP::_fymP2n},
+        {"fysPn", &TP::_fysPn}, {"fysP2n", &TP::_fysP2n},
+        {"symPn", &TP::_symPn}, {"symP2n", &TP::_symP2n},
+        {"sysPn", &TP::_sysPn}, {"sysP2n", &TP::_sysP2n}
+    };
+
+    for(const auto& p : veh_param_names){
+        if(name == p._name){
+            return &(v_params.*(p._member));
+        }
+    }
+    for(const auto& p : tire_param_names){
+        if(name == p._name){
+            return &(t_params.*(p._member));
+        }
+    }
+    return nullptr;
+}
+
+#endif
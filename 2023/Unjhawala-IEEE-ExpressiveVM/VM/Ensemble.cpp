@@ -0,0 +1,186 @@
+#include <iostream>
+#include <vector>
+#include <stdint.h>
+#include "Ensemble.h"
+#include "Eightdof_impl.h"
+#include "../utils.h"
+
+using namespace EightDOF;
+
+/*
+Code for the ensemble version of the 8 DOF model. A step of a block is the step of the
+Simulator with the scalar type EnsembleScalar, so each vehicle goes through the same
+functions and the same operations as it does in a Simulator
+*/
+
+typedef EnsembleScalar L;
+
+// a scalar member of one of the model structures, in the double and in the block version
+template <template <typename> class S>
+struct LaneField{
+    double S<double>::* _scalar;
+    L S<L>::* _lanes;
+};
+#define LANE_FIELD(S, f) {&S<double>::f, &S<L>::f}
+
+// the parameter values that may differ between the vehicles - everything but the time steps
+static const LaneField<VehicleParamT> veh_param_fields[] = {
+    LANE_FIELD(VehicleParamT, _a), LANE_FIELD(VehicleParamT, _b), LANE_FIELD(VehicleParamT, _h),
+    LANE_FIELD(VehicleParamT, _m), LANE_FIELD(VehicleParamT, _jz), LANE_FIELD(VehicleParamT, _jx),
+    LANE_FIELD(VehicleParamT, _jxz), LANE_FIELD(VehicleParamT, _cf), LANE_FIELD(VehicleParamT, _cr),
+    LANE_FIELD(VehicleParamT, _muf), LANE_FIELD(VehicleParamT, _mur), LANE_FIELD(VehicleParamT, _hrcf),
+    LANE_FIELD(VehicleParamT, _hrcr), LANE_FIELD(VehicleParamT, _krof), LANE_FIELD(VehicleParamT, _kror),
+    LANE_FIELD(VehicleParamT, _brof), LANE_FIELD(VehicleParamT, _bror), LANE_FIELD(VehicleParamT, _maxSteer),
+    LANE_FIELD(VehicleParamT, _crankInertia), LANE_FIELD(VehicleParamT, _upshift_RPS),
+    LANE_FIELD(VehicleParamT, _downshift_RPS), LANE_FIELD(VehicleParamT, _maxBrakeTorque),
+    LANE_FIELD(VehicleParamT, _c1), LANE_FIELD(VehicleParamT, _c0),
+    LANE_FIELD(VehicleParamT, _powertrainScale), LANE_FIELD(VehicleParamT, _lossesScale)
+};
+
+static const LaneField<TMeasyParamT> tire_param_fields[] = {
+    LANE_FIELD(TMeasyParamT, _jw), LANE_FIELD(TMeasyParamT, _rr), LANE_FIELD(TMeasyParamT, _mu),
+    LANE_FIELD(TMeasyParamT, _r0), LANE_FIELD(TMeasyParamT, _pn), LANE_FIELD(TMeasyParamT, _pnmax),
+    LANE_FIELD(TMeasyParamT, _cx), LANE_FIELD(TMeasyParamT, _cy), LANE_FIELD(TMeasyParamT, _kt),
+    LANE_FIELD(TMeasyParamT, _dx), LANE_FIELD(TMeasyParamT, _dy),
+    LANE_FIELD(TMeasyParamT, _rdyncoPn), LANE_FIELD(TMeasyParamT, _rdyncoP2n),
+    LANE_FIELD(TMeasyParamT, _fzRdynco), LANE_FIELD(TMeasyParamT, _rdyncoCrit),
+    LANE_FIELD(TMeasyParamT, _dfx0Pn), LANE_FIELD(TMeasyParamT, _dfx0P2n),
+    LANE_FIELD(TMeasyParamT, _fxmPn), LANE_FIELD(TMeasyParamT, _fxmP2n),
+    LANE_FIELD(TMeasyParamT, _fxsPn), LANE_FIELD(TMeasyParamT, _fxsP2n),
+    LANE_FIELD(TMeasyParamT, _sxmPn), LANE_FIELD(TMeasyParamT, _sxmP2n),
+    LANE_FIELD(TMeasyParamT, _sxsPn), LANE_FIELD(TMeasyParamT, _sxsP2n),
+    LANE_FIELD(TMeasyParamT, _dfy0Pn), LANE_FIELD(TMeasyParamT, _dfy0P2n),
+    LANE_FIELD(TMeasyParamT, _fymPn), LANE_FIELD(TMeasyParamT, _fymP2n),
+    LANE_FIELD(TMeasyParamT, _fysPn), LANE_FIELD(TMeasyParamT, _fysP2n),
+    LANE_FIELD(TMeasyParamT, _symPn), LANE_FIELD(TMeasyParamT, _symP2n),
+    LANE_FIELD(TMeasyParamT, _sysPn), LANE_FIELD(TMeasyParamT, _sysP2n)
+};
+
+// the states - the gear and the reverse flow flag are not doubles and are copied on their own
+static const LaneField<VehicleStateT> veh_state_fields[] = {
+    LANE_FIELD(VehicleStateT, _x), LANE_FIELD(VehicleStateT, _y), LANE_FIELD(VehicleStateT, _u),
+    LANE_FIELD(VehicleStateT, _v), LANE_FIELD(VehicleStateT, _psi), LANE_FIELD(VehicleStateT, _wz),
+    LANE_FIELD(VehicleStateT, _phi), LANE_FIELD(VehicleStateT, _wx),
+    LANE_FIELD(VehicleStateT, _udot), LANE_FIELD(VehicleStateT, _vdot),
+    LANE_FIELD(VehicleStateT, _wxdot), LANE_FIELD(VehicleStateT, _wzdot),
+    LANE_FIELD(VehicleStateT, _fzlf), LANE_FIELD(VehicleStateT, _fzrf),
+    LANE_FIELD(VehicleStateT, _fzlr), LANE_FIELD(VehicleStateT, _fzrr),
+    LANE_FIELD(VehicleStateT, _tor), LANE_FIELD(VehicleStateT, _crankOmega), LANE_FIELD(VehicleStateT, _debugtor),
+    LANE_FIELD(VehicleStateT, _tc_inp_tor), LANE_FIELD(VehicleStateT, _tc_out_tor),
+    LANE_FIELD(VehicleStateT, _tc_out_omg), LANE_FIELD(VehicleStateT, _sr)
+};
+
+static const LaneField<TMeasyStateT> tire_state_fields[] = {
+    LANE_FIELD(TMeasyStateT, _xe), LANE_FIELD(TMeasyStateT, _ye), LANE_FIELD(TMeasyStateT, _xedot),
+    LANE_FIELD(TMeasyStateT, _yedot), LANE_FIELD(TMeasyStateT, _omega), LANE_FIELD(TMeasyStateT, _xt),
+    LANE_FIELD(TMeasyStateT, _rStat), LANE_FIELD(TMeasyStateT, _fx), LANE_FIELD(TMeasyStateT, _fy),
+    LANE_FIELD(TMeasyStateT, _fz), LANE_FIELD(TMeasyStateT, _vsx), LANE_FIELD(TMeasyStateT, _vsy),
+    LANE_FIELD(TMeasyStateT, _My), LANE_FIELD(TMeasyStateT, _engTor)
+};
+
+#undef LANE_FIELD
+
+// copies the fields of in into lane k of out
+template <template <typename> class S, size_t N>
+static void setLane(S<L>& out, int k, const S<double>& in, const LaneField<S> (&fields)[N]){
+    for(const LaneField<S>& f : fields){
+        (out.*(f._lanes))._v[k] = in.*(f._scalar);
+    }
+}
+
+// copies lane k of the fields of in into out
+template <template <typename> class S, size_t N>
+static void getLane(S<double>& out, const S<L>& in, int k, const LaneField<S> (&fields)[N]){
+    for(const LaneField<S>& f : fields){
+        out.*(f._scalar) = (in.*(f._lanes))._v[k];
+    }
+}
+
+
+Ensemble::Ensemble()
+    : _n(0), _blocks(0), _stepFn(&Ensemble::stepVariant<FEATURES_RUNTIME>), _time(0.) {}
+
+Ensemble::Ensemble(int n, const VehicleParam& v_params, const TMeasyParam& t_params)
+    : _n(0), _blocks(0), _stepFn(&Ensemble::stepVariant<FEATURES_RUNTIME>), _time(0.) {
+    init(n, v_params, t_params);
+}
+
+void Ensemble::init(int n, const VehicleParam& v_params, const TMeasyParam& t_params){
+    _n = n;
+    _blocks = (n + ENSEMBLE_LANES - 1) / ENSEMBLE_LANES;
+    _v_params = v_params;
+    _t_params = t_params;
+    mapsInit(_v_params);
+    tireInit(_t_params);
+
+    // every lane starts with the given parameters
+    VehicleParamT<L> v_block;
+    TMeasyParamT<L> t_block;
+    convertParams(v_block, _v_params);
+    convertParams(t_block, _t_params);
+    _v_block.assign(_blocks, v_block);
+    _t_block.assign(_blocks, t_block);
+    _inv.resize(_blocks);
+    for(int b = 0; b < _blocks; b++){
+        vehInvariants(_inv[b], _v_block[b]);
+    }
+
+    _v_states.resize(_blocks);
+    _tires.resize(4 * _blocks);
+
+    // every combination of the flags is compiled as its own variant
+    switch(modelFeatures(_v_params)){
+        case 0: _stepFn = &Ensemble::stepVariant<0>; break;
+        case 1: _stepFn = &Ensemble::stepVariant<1>; break;
+        case 2: _stepFn = &Ensemble::stepVariant<2>; break;
+        case 3: _stepFn = &Ensemble::stepVariant<3>; break;
+        case 4: _stepFn = &Ensemble::stepVariant<4>; break;
+        case 5: _stepFn = &Ensemble::stepVariant<5>; break;
+        case 6: _stepFn = &Ensemble::stepVariant<6>; break;
+        case 7: _stepFn = &Ensemble::stepVariant<7>; break;
+        default: _stepFn = &Ensemble::stepVariant<FEATURES_RUNTIME>; break;
+    }
+    reset();
+}
+
+void Ensemble::setParams(int i, const VehicleParam& v_params, const TMeasyParam& t_params){
+    int b = i / ENSEMBLE_LANES;
+    int k = i % ENSEMBLE_LANES;
+    TMeasyParam tire = t_params;
+    tireInit(tire);
+    setLane(_v_block[b], k, v_params, veh_param_fields);
+    setLane(_t_block[b], k, tire, tire_param_fields);
+    vehInvariants(_inv[b], _v_block[b]);
+}
+
+void Ensemble::reset(){
+    for(int b = 0; b < _blocks; b++){
+        _v_states[b] = VehicleStateT<L>();
+        vehInit(_v_states[b], _v_block[b]);
+        for(int c = 0; c < 4; c++){
+            _tires[4 * b + c] = TMeasyStateT<L>();
+        }
+    }
+    _time = 0.;
+}
+
+void Ensemble::getState(int i, VehicleState& v_states, TMeasyState* tires) const{
+    int b = i / ENSEMBLE_LANES;
+    int k = i % ENSEMBLE_LANES;
+    getLane(v_states, _v_states[b], k, veh_state_fields);
+    v_states._current_gr = int(_v_states[b]._current_gr._v[k]);
+    v_states._tc_reverse_flow = _v_states[b]._tc_reverse_flow._m[k] != 0;
+    for(int c = 0; c < 4; c++){
+        getLane(tires[c], _tires[4 * b + c], k, tire_state_fields);
+    }
+}
+
+template <int F>
+void Ensemble::stepVariant(const Controls& controls){
+    for(int b = 0; b < _blocks; b++){
+        stepT<F>(_v_states[b], &_tires[4 * b], _v_block[b], _t_block[b], _inv[b],
+                    controls._steering, controls._throttle, controls._braking, controls._time);
+    }
+
+    _time = controls._time + _v_params._step;
+}
@@ -0,0 +1,83 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+#include <stdint.h>
+#include <vector>
+#include "../utils.h"
+#include "Eightdof.h"
+#include "Simulator.h"
+#include "Lanes.h"
+/*
+Header file for the ensemble version of the 8 DOF model. N vehicles of the same type (same
+maps, gears, feature flags and time steps) but with different parameter values are advanced
+in lock step. The vehicles are packed into blocks of ENSEMBLE_LANES, and a block runs through
+the templated model of Eightdof_impl.h with the scalar type Lanes (see Lanes.h), which
+advances every vehicle of the block with the same instructions. Each vehicle has its own gear
+(see GearT in Eightdof.h) and torque converter state, the powertrain picks between them with selects
+*/
+
+namespace EightDOF{
+
+    // vehicles per block - one SIMD register of doubles
+    static const int ENSEMBLE_LANES = NATIVE_LANES;
+    typedef Lanes<ENSEMBLE_LANES> EnsembleScalar;
+
+    class Ensemble{
+      public:
+        Ensemble();
+
+        // n vehicles with the parameters v_params and t_params - same as init
+        Ensemble(int n, const VehicleParam& v_params, const TMeasyParam& t_params);
+
+        // Sizes all the storage for n vehicles and gives every vehicle the parameters v_params and
+        // t_params. The maps, gears, feature flags and time steps of these are shared by all the
+        // vehicles. tireInit is called on the copy of the tire parameters
+        void init(int n, const VehicleParam& v_params, const TMeasyParam& t_params);
+
+        // Changes the parameter values of vehicle i (tireInit is called on them). The maps, gears,
+        // feature flags and time steps stay those given to init. The states are not touched, call
+        // reset to put the vehicles at rest with the new values
+        void setParams(int i, const VehicleParam& v_params, const TMeasyParam& t_params);
+
+        // puts every vehicle back at rest at the origin
+        void reset();
+
+        // advance every vehicle by one vehicle time step with the same controls - the same as
+        // Simulator::step for each of them. No heap allocations happen in here
+        void step(const Controls& controls){
+            (this->*_stepFn)(controls);
+        }
+
+        int size() const { return _n; }
+
+        // time at the end of the last step
+        double getTime() const { return _time; }
+
+        // copies out the states of vehicle i and its 4 tires (0 - left front, 1 - right front,
+        // 2 - left rear, 3 - right rear)
+        void getState(int i, VehicleState& v_states, TMeasyState* tires) const;
+
+      private:
+        // step of the model variant with the feature flags F
+        template <int F>
+        void stepVariant(const Controls& controls);
+
+        int _n; // number of vehicles
+        int _blocks; // number of blocks - the lanes of the last one past _n run with the parameters given to init
+
+        // the parameters given to init - the maps, gears, feature flags and time steps of every vehicle
+        VehicleParam _v_params;
+        TMeasyParam _t_params;
+        void (Ensemble::*_stepFn)(const Controls&); // stepVariant for the flags of the vehicles
+
+        // per block
+        std::vector<VehicleParamT<EnsembleScalar> > _v_block;
+        std::vector<TMeasyParamT<EnsembleScalar> > _t_block;
+        std::vector<VehicleInvariantsT<EnsembleScalar> > _inv;
+        std::vector<VehicleStateT<EnsembleScalar> > _v_states;
+        std::vector<TMeasyStateT<EnsembleScalar> > _tires; // 4 per block
+
+        double _time;
+    };
+}
+
+#endif
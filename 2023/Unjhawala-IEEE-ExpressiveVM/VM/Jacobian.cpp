@@ -0,0 +1,258 @@
+#include <vector>
+#include <stdint.h>
+#include "Jacobian.h"
+#include "Eightdof_impl.h"
+
+using namespace EightDOF;
+
+/*
+Code for the step Jacobian. The states are copied into dual numbers, the packed states and the
+controls are seeded with one direction each, and the step of Simulator::step (stepT) runs once on
+them. The values are computed with exactly the same operations as the double model
+*/
+
+// the value of a dual number, and back
+template <int N>
+static inline void setValue(Dual<N>& out, double in){ out._v = in; }
+template <int N>
+static inline void setValue(double& out, const Dual<N>& in){ out = in._v; }
+
+// copies the values of the states between double and dual numbers. The derivatives of the dual
+// states are left as they are - the step writes every state it reads other than the packed ones
+// (which are seeded) before it reads it
+template <typename T, typename U>
+static void copyValues(VehicleStateT<T>& out, const VehicleStateT<U>& in){
+    setValue(out._x, in._x); setValue(out._y, in._y); setValue(out._u, in._u); setValue(out._v, in._v);
+    setValue(out._psi, in._psi); setValue(out._wz, in._wz); setValue(out._phi, in._phi); setValue(out._wx, in._wx);
+    setValue(out._udot, in._udot); setValue(out._vdot, in._vdot); setValue(out._wxdot, in._wxdot); setValue(out._wzdot, in._wzdot);
+    setValue(out._fzlf, in._fzlf); setValue(out._fzrf, in._fzrf); setValue(out._fzlr, in._fzlr); setValue(out._fzrr, in._fzrr);
+    setValue(out._tor, in._tor); setValue(out._crankOmega, in._crankOmega); setValue(out._debugtor, in._debugtor);
+    out._current_gr = in._current_gr;
+    setValue(out._tc_inp_tor, in._tc_inp_tor); setValue(out._tc_out_tor, in._tc_out_tor); setValue(out._tc_out_omg, in._tc_out_omg);
+    out._tc_reverse_flow = in._tc_reverse_flow;
+    setValue(out._sr, in._sr);
+}
+
+template <typename T, typename U>
+static void copyValues(TMeasyStateT<T>& out, const TMeasyStateT<U>& in){
+    setValue(out._xe, in._xe); setValue(out._ye, in._ye); setValue(out._xedot, in._xedot); setValue(out._yedot, in._yedot);
+    setValue(out._omega, in._omega); setValue(out._xt, in._xt); setValue(out._rStat, in._rStat);
+    setValue(out._fx, in._fx); setValue(out._fy, in._fy); setValue(out._fz, in._fz);
+    setValue(out._vsx, in._vsx); setValue(out._vsy, in._vsy); setValue(out._My, in._My); setValue(out._engTor, in._engTor);
+}
+
+template <typename T>
+static void packStates(T* x, const VehicleStateT<T>& v_states, const TMeasyStateT<T>* tires){
+    x[0] = v_states._x;
+    x[1] = v_states._y;
+    x[2] = v_states._u;
+    x[3] = v_states._v;
+    x[4] = v_states._psi;
+    x[5] = v_states._phi;
+    x[6] = v_states._wx;
+    x[7] = v_states._wz;
+    for(int i = 0; i < 4; i++){
+        x[8 + i] = tires[i]._xe;
+        x[12 + i] = tires[i]._ye;
+        x[16 + i] = tires[i]._omega;
+    }
+    x[20] = v_states._crankOmega;
+    x[21] = v_states._fzlf;
+    x[22] = v_states._fzrf;
+    x[23] = v_states._fzlr;
+    x[24] = v_states._fzrr;
+}
+
+template <typename T>
+static void unpackStates(const T* x, VehicleStateT<T>& v_states, TMeasyStateT<T>* tires){
+    v_states._x = x[0];
+    v_states._y = x[1];
+    v_states._u = x[2];
+    v_states._v = x[3];
+    v_states._psi = x[4];
+    v_states._phi = x[5];
+    v_states._wx = x[6];
+    v_states._wz = x[7];
+    for(int i = 0; i < 4; i++){
+        tires[i]._xe = x[8 + i];
+        tires[i]._ye = x[12 + i];
+        tires[i]._omega = x[16 + i];
+    }
+    v_states._crankOmega = x[20];
+    v_states._fzlf = x[21];
+    v_states._fzrf = x[22];
+    v_states._fzlr = x[23];
+    v_states._fzrr = x[24];
+}
+
+
+// the addresses of the packed states, in the order of packStates
+template <typename T>
+static void stateAddresses(T** x, VehicleStateT<T>& v_states, TMeasyStateT<T>* tires){
+    x[0] = &v_states._x;
+    x[1] = &v_states._y;
+    x[2] = &v_states._u;
+    x[3] = &v_states._v;
+    x[4] = &v_states._psi;
+    x[5] = &v_states._phi;
+    x[6] = &v_states._wx;
+    x[7] = &v_states._wz;
+    for(int i = 0; i < 4; i++){
+        x[8 + i] = &tires[i]._xe;
+        x[12 + i] = &tires[i]._ye;
+        x[16 + i] = &tires[i]._omega;
+    }
+    x[20] = &v_states._crankOmega;
+    x[21] = &v_states._fzlf;
+    x[22] = &v_states._fzrf;
+    x[23] = &v_states._fzlr;
+    x[24] = &v_states._fzrr;
+}
+
+
+// the column of direction k of the pass over the tires for tire c - the chassis velocities u, v
+// and wz, the steering, and the deflections, wheel speed and vertical force of the tire. These are
+// all that the inputs of tireAdv4 for the tire (_vsx, _vsy, _fz, _omega, _xe, _ye and the
+// steering angle) depend on after vehToTireTransform
+static int tireColumn(int c, int k){
+    static const int shared[4] = {2, 3, 7, StepJacobian::NUM_STATES};
+    static const int first[4] = {8, 12, 16, 21}; // the column of the first tire
+    return k < 4 ? shared[k] : first[k - 4] + c;
+}
+
+// the derivatives of x in the columns of tire c, and back - the other columns of a value
+// going back are 0
+template <int N, int M>
+static void projectTire(Dual<M>& out, const Dual<N>& in, int c){
+    out._v = in._v;
+    for(int k = 0; k < M; k++){
+        out._d[k] = in._d[tireColumn(c, k)];
+    }
+}
+
+template <int N, int M>
+static void expandTire(Dual<N>& out, const Dual<M>& in, int c){
+    out = Dual<N>(in._v);
+    for(int k = 0; k < M; k++){
+        out._d[tireColumn(c, k)] = in._d[k];
+    }
+}
+
+
+StepJacobian::StepJacobian() : _stepFn(&StepJacobian::stepVariant<FEATURES_RUNTIME>) {
+    vehInvariants(_inv, _v_params);
+}
+
+StepJacobian::StepJacobian(const VehicleParam& v_params, const TMeasyParam& t_params)
+    : _stepFn(&StepJacobian::stepVariant<FEATURES_RUNTIME>) {
+    init(v_params, t_params);
+}
+
+void StepJacobian::init(const VehicleParam& v_params, const TMeasyParam& t_params){
+    // initialized like the Simulator does, so the derived parameters are the same
+    _v_params = v_params;
+    _t_params = t_params;
+    mapsInit(_v_params);
+    tireInit(_t_params);
+    vehInvariants(_inv, _v_params);
+
+    // every combination of the flags is compiled as its own variant, as in the Simulator
+    switch(modelFeatures(_v_params)){
+        case 0: _stepFn = &StepJacobian::stepVariant<0>; break;
+        case 1: _stepFn = &StepJacobian::stepVariant<1>; break;
+        case 2: _stepFn = &StepJacobian::stepVariant<2>; break;
+        case 3: _stepFn = &StepJacobian::stepVariant<3>; break;
+        case 4: _stepFn = &StepJacobian::stepVariant<4>; break;
+        case 5: _stepFn = &StepJacobian::stepVariant<5>; break;
+        case 6: _stepFn = &StepJacobian::stepVariant<6>; break;
+        case 7: _stepFn = &StepJacobian::stepVariant<7>; break;
+        default: _stepFn = &StepJacobian::stepVariant<FEATURES_RUNTIME>; break;
+    }
+}
+
+void StepJacobian::pack(double* x, const VehicleState& v_states, const TMeasyState* tires){
+    packStates(x, v_states, tires);
+}
+
+void StepJacobian::unpack(const double* x, VehicleState& v_states, TMeasyState* tires){
+    unpackStates(x, v_states, tires);
+}
+
+void StepJacobian::step(VehicleState& v_states, TMeasyState* tires, const Controls& controls, double* A, double* B){
+
+    // the values of the states, then the packed ones seeded in place
+    copyValues(_v_states, v_states);
+    for(int i = 0; i < 4; i++){
+        copyValues(_tires[i], tires[i]);
+    }
+    D* x[NUM_STATES];
+    stateAddresses(x, _v_states, _tires);
+    for(int j = 0; j < NUM_STATES; j++){
+        *x[j] = D(x[j]->_v);
+        x[j]->_d[j] = 1.;
+    }
+
+    D steering(controls._steering), throttle(controls._throttle), braking(controls._braking);
+    steering._d[NUM_STATES] = 1.;
+    throttle._d[NUM_STATES + 1] = 1.;
+    braking._d[NUM_STATES + 2] = 1.;
+
+    (this->*_stepFn)(steering, throttle, braking, controls._time);
+
+    for(int i = 0; i < NUM_STATES; i++){
+        for(int j = 0; j < NUM_STATES; j++){
+            A[i*NUM_STATES + j] = x[i]->_d[j];
+        }
+        for(int k = 0; k < NUM_CONTROLS; k++){
+            B[i*NUM_CONTROLS + k] = x[i]->_d[NUM_STATES + k];
+        }
+    }
+
+    copyValues(v_states, _v_states);
+    for(int i = 0; i < 4; i++){
+        copyValues(tires[i], _tires[i]);
+    }
+}
+
+// the step of Simulator::step, with the tires advanced with the directions of each tire and
+// put back in all the columns after
+template <int F>
+void StepJacobian::stepVariant(const D& steering, const D& throttle, const D& braking, double time){
+    stepT<F>(_v_states, _tires, _v_params, _t_params, _inv, steering, throttle, braking, time,
+                [&](TMeasyStateT<D>* tires, const D* delta){
+        DT deltaTire[4];
+        for(int c = 0; c < 4; c++){
+            const TMeasyStateT<D>& in = tires[c];
+            TMeasyStateT<DT>& t = _tiresTire[c];
+            projectTire(t._fz, in._fz, c);
+            projectTire(t._vsx, in._vsx, c);
+            projectTire(t._vsy, in._vsy, c);
+            projectTire(t._omega, in._omega, c);
+            projectTire(t._xe, in._xe, c);
+            projectTire(t._ye, in._ye, c);
+            projectTire(deltaTire[c], delta[c], c);
+        }
+        tireAdv4(_tiresTire, _t_params, _v_params, deltaTire, time);
+        for(int c = 0; c < 4; c++){
+            const TMeasyStateT<DT>& t = _tiresTire[c];
+            TMeasyStateT<D>& out = tires[c];
+            expandTire(out._xe, t._xe, c);
+            expandTire(out._ye, t._ye, c);
+            expandTire(out._xedot, t._xedot, c);
+            expandTire(out._yedot, t._yedot, c);
+            expandTire(out._xt, t._xt, c);
+            expandTire(out._rStat, t._rStat, c);
+            expandTire(out._fx, t._fx, c);
+            expandTire(out._fy, t._fy, c);
+            expandTire(out._My, t._My, c);
+        }
+    });
+}
+
+void StepJacobian::step(Simulator& sim, const Controls& controls, double* A, double* B){
+    SimulatorSnapshot s;
+    sim.snapshot(s);
+    step(s._v_states, s._tires, controls, A, B);
+    s._time = controls._time + sim.getVehicleParam()._step;
+    sim.restore(s);
+}
@@ -0,0 +1,85 @@
+#ifndef JACOBIAN_H
+#define JACOBIAN_H
+#include <stdint.h>
+#include <vector>
+#include "../utils.h"
+#include "Eightdof.h"
+#include "Simulator.h"
+#include "Dual.h"
+/*
+Header file for the Jacobian of one time step of the 8 DOF model with respect to the states and
+the controls, for the linearizations of state estimators (EKF) and of controllers. The step is
+that of Simulator::step, run once on dual numbers (Dual.h) that carry the derivatives with
+respect to every state and control at the same time. The parameters stay double (see stepT),
+so they add no work to the derivatives. The 4 tires are advanced on their own with fewer
+directions (see NUM_TIRE_DIRS)
+*/
+
+namespace EightDOF{
+
+    class StepJacobian{
+      public:
+        // number of states that carry over from one step to the next - chassis (x, y, u, v, psi,
+        // phi, wx, wz), 4 x and 4 y tire deflections, 4 wheel speeds, crank speed and the 4
+        // vertical tire forces, which the step computes at its end for the next one. The first
+        // 21 are the states of AdaptiveSimulator in the same order
+        static const int NUM_STATES = 25;
+
+        // steering, throttle and braking
+        static const int NUM_CONTROLS = 3;
+
+        StepJacobian();
+
+        // copies the parameters - tireInit and mapsInit are called on the copies
+        StepJacobian(const VehicleParam& v_params, const TMeasyParam& t_params);
+
+        // same as the constructor, has to be called again after the parameters are changed
+        void init(const VehicleParam& v_params, const TMeasyParam& t_params);
+
+        // the state vector x of the states, and the states from x. unpack leaves everything that
+        // is not in x as it is - the step does not depend on any of it except the gear
+        static void pack(double* x, const VehicleState& v_states, const TMeasyState* tires);
+        static void unpack(const double* x, VehicleState& v_states, TMeasyState* tires);
+
+        // Advances v_states and the 4 tires by one step with the controls, to exactly the states
+        // Simulator::step gives, and writes the Jacobians of the state vector after the step,
+        // A = dx/dx0 (NUM_STATES x NUM_STATES) and B = dx/d(steering, throttle, braking)
+        // (NUM_STATES x NUM_CONTROLS), both row major - A[i*NUM_STATES + j] = dx_i/dx0_j. The
+        // gear is held fixed, a shift happens after the derivatives are taken, as do the sign
+        // changes and clamps of the model, which have a derivative of 0. Standing still with no
+        // slip at all the tire forces have a derivative of 0 too, as the force characteristic
+        // (tmxy_combined) is 0 there and has no slope. Costs 9 to 16 steps (see testJacobian8DOF),
+        // where one sided differences take 29 (one step and one for each of the 25 states and 3
+        // controls). About 40% of it is the pass over the tires, the rest mostly the pass of the
+        // chassis and the powertrain, which carries all 28 directions. No heap allocations happen in here
+        void step(VehicleState& v_states, TMeasyState* tires, const Controls& controls, double* A, double* B);
+
+        // the same on the states of a Simulator, whose time moves to the end of the step
+        void step(Simulator& sim, const Controls& controls, double* A, double* B);
+
+        // the states of a tire only depend on its own states, the chassis velocities and the
+        // steering in tireAdv4, so the tires are advanced with this many directions
+        static const int NUM_TIRE_DIRS = 8;
+
+      private:
+        typedef Dual<NUM_STATES + NUM_CONTROLS> D;
+        typedef Dual<NUM_TIRE_DIRS> DT;
+
+        // the step of the dual states of the model variant with the feature flags F
+        template <int F>
+        void stepVariant(const D& steering, const D& throttle, const D& braking, double t);
+
+        VehicleParam _v_params;
+        TMeasyParam _t_params;
+        VehicleInvariants _inv;
+        void (StepJacobian::*_stepFn)(const D&, const D&, const D&, double); // stepVariant for the flags of the vehicle
+
+        VehicleStateT<D> _v_states;
+        TMeasyStateT<D> _tires[4];
+
+        // the tires of the pass over the tires
+        TMeasyStateT<DT> _tiresTire[4];
+    };
+}
+
+#endif
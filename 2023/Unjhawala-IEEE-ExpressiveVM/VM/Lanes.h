@@ -0,0 +1,242 @@
+#ifndef LANES_H
+#define LANES_H
+#include <stdint.h>
+#include <cmath>
+#include "../utils.h"
+/*
+W values that go through every operation together, one in each lane of a SIMD register. The
+model instantiated with Lanes<W> (see Eightdof_impl.h) advances W vehicles at once, which is
+how Ensemble.h runs a batch of vehicles, and tireAdv4 in double puts the 4 tires of one vehicle
+in the lanes. The arithmetic is that of double, lane by lane, so every lane gets exactly the
+values of the double model. Comparisons give a LaneMask, and the model picks results with select
+where it branches on a value.
+The math functions call those of <cmath> lane by lane. Built with -DEDOF_VECTOR_MATH (and
+-mavx2 or -mavx512f) they call the SIMD versions of glibc's libmvec instead, which are much
+faster but only accurate to a few ulp, so the lanes no longer match the double model bit for bit.
+Uses the vector extensions of GCC and Clang
+*/
+
+#if defined(__AVX512F__)
+static const int NATIVE_LANES = 8;
+#elif defined(__AVX__)
+static const int NATIVE_LANES = 4;
+#else
+static const int NATIVE_LANES = 2;
+#endif
+
+template <int W>
+struct LaneMask{
+    typedef int64_t Vec __attribute__((vector_size(W * sizeof(double))));
+
+    Vec _m; // all ones in the lanes where the condition holds, 0 elsewhere
+
+    friend LaneMask operator&(const LaneMask& a, const LaneMask& b){ return LaneMask{a._m & b._m}; }
+    friend LaneMask operator|(const LaneMask& a, const LaneMask& b){ return LaneMask{a._m | b._m}; }
+    friend LaneMask operator!(const LaneMask& a){ return LaneMask{~a._m}; }
+};
+
+template <int W>
+struct Lanes{
+    typedef double Vec __attribute__((vector_size(W * sizeof(double))));
+
+    Lanes() : _v(Vec{}) {}
+
+    // the same value in every lane
+    Lanes(double v) : _v(Vec{} + v) {}
+
+    Vec _v;
+
+    Lanes& operator+=(const Lanes& b){ _v += b._v; return *this; }
+    Lanes& operator-=(const Lanes& b){ _v -= b._v; return *this; }
+    Lanes& operator*=(const Lanes& b){ _v *= b._v; return *this; }
+    Lanes& operator/=(const Lanes& b){ _v /= b._v; return *this; }
+
+    friend Lanes operator-(const Lanes& a){ Lanes r; r._v = -a._v; return r; }
+    friend Lanes operator+(const Lanes& a){ return a; }
+
+    // a double on either side is broadcast to all the lanes
+    friend Lanes operator+(const Lanes& a, const Lanes& b){ Lanes r; r._v = a._v + b._v; return r; }
+    friend Lanes operator-(const Lanes& a, const Lanes& b){ Lanes r; r._v = a._v - b._v; return r; }
+    friend Lanes operator*(const Lanes& a, const Lanes& b){ Lanes r; r._v = a._v * b._v; return r; }
+    friend Lanes operator/(const Lanes& a, const Lanes& b){ Lanes r; r._v = a._v / b._v; return r; }
+
+    friend LaneMask<W> operator<(const Lanes& a, const Lanes& b){ return LaneMask<W>{a._v < b._v}; }
+    friend LaneMask<W> operator>(const Lanes& a, const Lanes& b){ return LaneMask<W>{a._v > b._v}; }
+    friend LaneMask<W> operator<=(const Lanes& a, const Lanes& b){ return LaneMask<W>{a._v <= b._v}; }
+    friend LaneMask<W> operator>=(const Lanes& a, const Lanes& b){ return LaneMask<W>{a._v >= b._v}; }
+    friend LaneMask<W> operator==(const Lanes& a, const Lanes& b){ return LaneMask<W>{a._v == b._v}; }
+    friend LaneMask<W> operator!=(const Lanes& a, const Lanes& b){ return LaneMask<W>{a._v != b._v}; }
+};
+
+// a in the lanes where c holds and b elsewhere
+template <int W>
+inline Lanes<W> select(const LaneMask<W>& c, const Lanes<W>& a, const Lanes<W>& b){
+    Lanes<W> r;
+    r._v = c._m ? a._v : b._v;
+    return r;
+}
+
+// whether c holds in any lane
+template <int W>
+inline bool any(const LaneMask<W>& c){
+    for(int k = 0; k < W; k++){
+        if(c._m[k]){
+            return true;
+        }
+    }
+    return false;
+}
+
+// the model takes the plain value of the time and the time steps only, which are the same in
+// every lane - the value of the first lane
+template <int W>
+inline double primal(const Lanes<W>& x){ return x._v[0]; }
+
+
+#if defined(EDOF_VECTOR_MATH) && (defined(__AVX512F__) || defined(__AVX2__))
+
+// the libmvec functions for a register of NATIVE_LANES doubles
+typedef double NativeVec __attribute__((vector_size(NATIVE_LANES * sizeof(double))));
+#if defined(__AVX512F__)
+#define EDOF_LIBMVEC(name, args) _ZGVeN8##args##_##name
+#else
+#define EDOF_LIBMVEC(name, args) _ZGVdN4##args##_##name
+#endif
+extern "C"{
+    NativeVec EDOF_LIBMVEC(sin, v)(NativeVec x);
+    NativeVec EDOF_LIBMVEC(cos, v)(NativeVec x);
+    NativeVec EDOF_LIBMVEC(tan, v)(NativeVec x);
+    NativeVec EDOF_LIBMVEC(atan2, vv)(NativeVec y, NativeVec x);
+    NativeVec EDOF_LIBMVEC(hypot, vv)(NativeVec x, NativeVec y);
+    NativeVec EDOF_LIBMVEC(pow, vv)(NativeVec x, NativeVec y);
+}
+
+// f of every lane, one register of NATIVE_LANES at a time
+#define EDOF_LANES_MATH1(f, args)                                                       \
+    template <int W>                                                                    \
+    inline Lanes<W> f(const Lanes<W>& x){                                               \
+        static_assert(W % NATIVE_LANES == 0, "W has to be a multiple of NATIVE_LANES"); \
+        Lanes<W> r;                                                                     \
+        for(int k = 0; k < W; k += NATIVE_LANES){                                       \
+            NativeVec a;                                                                \
+            __builtin_memcpy(&a, (const double*)&x._v + k, sizeof(a));                  \
+            a = EDOF_LIBMVEC(f, args)(a);                                               \
+            __builtin_memcpy((double*)&r._v + k, &a, sizeof(a));                        \
+        }                                                                               \
+        return r;                                                                       \
+    }
+#define EDOF_LANES_MATH2(f, args)                                                       \
+    template <int W>                                                                    \
+    inline Lanes<W> f(const Lanes<W>& x, const Lanes<W>& y){                            \
+        static_assert(W % NATIVE_LANES == 0, "W has to be a multiple of NATIVE_LANES"); \
+        Lanes<W> r;                                                                     \
+        for(int k = 0; k < W; k += NATIVE_LANES){                                       \
+            NativeVec a, b;                                                             \
+            __builtin_memcpy(&a, (const double*)&x._v + k, sizeof(a));                  \
+            __builtin_memcpy(&b, (const double*)&y._v + k, sizeof(b));                  \
+            a = EDOF_LIBMVEC(f, args)(a, b);                                            \
+            __builtin_memcpy((double*)&r._v + k, &a, sizeof(a));                        \
+        }                                                                               \
+        return r;                                                                       \
+    }
+
+#else
+
+// f of every lane with the function of <cmath>
+#define EDOF_LANES_MATH1(f, args)                                                       \
+    template <int W>                                                                    \
+    inline Lanes<W> f(const Lanes<W>& x){                                               \
+        Lanes<W> r;                                                                     \
+        for(int k = 0; k < W; k++){                                                     \
+            r._v[k] = std::f(x._v[k]);                                                  \
+        }                                                                               \
+        return r;                                                                       \
+    }
+#define EDOF_LANES_MATH2(f, args)                                                       \
+    template <int W>                                                                    \
+    inline Lanes<W> f(const Lanes<W>& x, const Lanes<W>& y){                            \
+        Lanes<W> r;                                                                     \
+        for(int k = 0; k < W; k++){                                                     \
+            r._v[k] = std::f(x._v[k], y._v[k]);                                         \
+        }                                                                               \
+        return r;                                                                       \
+    }
+
+#endif
+
+EDOF_LANES_MATH1(sin, v)
+EDOF_LANES_MATH1(cos, v)
+EDOF_LANES_MATH1(tan, v)
+EDOF_LANES_MATH2(atan2, vv)
+EDOF_LANES_MATH2(hypot, vv)
+EDOF_LANES_MATH2(pow, vv)
+
+#undef EDOF_LANES_MATH1
+#undef EDOF_LANES_MATH2
+
+// clears the sign bit, exactly std::abs
+template <int W>
+inline Lanes<W> abs(const Lanes<W>& x){
+    typedef typename LaneMask<W>::Vec Bits;
+    Lanes<W> r;
+    r._v = (typename Lanes<W>::Vec)((Bits)x._v & (int64_t)0x7fffffffffffffffLL);
+    return r;
+}
+
+template <int W>
+inline Lanes<W> sqrt(const Lanes<W>& x){
+    Lanes<W> r;
+    for(int k = 0; k < W; k++){
+        r._v[k] = std::sqrt(x._v[k]);
+    }
+    return r;
+}
+
+// the model squares with pow(x, 2), which the compiler turns into x * x for double
+template <int W>
+inline Lanes<W> pow(const Lanes<W>& x, double n){
+    if(n == 2.){
+        return x * x;
+    }
+    return pow(x, Lanes<W>(n));
+}
+
+// sgn of utils.h - 1, -1 or 0 in every lane
+template <int W>
+inline Lanes<W> sgn(const Lanes<W>& x){
+    return select(Lanes<W>(0.) < x, Lanes<W>(1.), select(x < Lanes<W>(0.), Lanes<W>(-1.), Lanes<W>(0.)));
+}
+
+// clamp of utils.h
+template <int W>
+inline Lanes<W> clamp(const Lanes<W>& value, const Lanes<W>& limitMin, const Lanes<W>& limitMax){
+    return select(value < limitMin, limitMin, select(value > limitMax, limitMax, value));
+}
+
+// sineStep of utils.h - the sine is only evaluated if a lane is between x1 and x2
+template <int W>
+inline Lanes<W> sineStep(const Lanes<W>& x, double x1, double y1, double x2, double y2){
+    LaneMask<W> below = x <= x1;
+    LaneMask<W> above = x >= x2;
+    Lanes<W> r = select(below, Lanes<W>(y1), Lanes<W>(y2));
+    LaneMask<W> between = !(below | above);
+    if(any(between)){
+        double dx = x2 - x1;
+        double dy = y2 - y1;
+        Lanes<W> y = y1 + dy * (x - x1) / dx - (dy / C_2PI) * sin(C_2PI * (x - x1) / dx);
+        r = select(between, y, r);
+    }
+    return r;
+}
+
+// getMapY of utils.h, lane by lane
+template <int W>
+inline Lanes<W> getMapY(const std::vector<MapEntry>& map, const MapLUT& lut, const Lanes<W>& x){
+    Lanes<W> r;
+    for(int k = 0; k < W; k++){
+        r._v[k] = getMapY(map, lut, x._v[k]);
+    }
+    return r;
+}
+
+#endif
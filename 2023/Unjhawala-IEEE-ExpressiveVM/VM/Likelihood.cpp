@@ -0,0 +1,354 @@
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <mutex>
+#include <sys/stat.h>
+#include "Likelihood.h"
+#include "Simulator.h"
+
+using namespace EightDOF;
+
+/*
+Code for the likelihood. The observations are interpolated onto the samples of the model when
+they are loaded, so an evaluation is one pass of the model per run that sums the squared
+residuals of the samples as it goes
+*/
+
+static const double PI = 3.14159265358979323846;
+
+void EightDOF::setObservedRun(ObservedRun& run, const std::vector<Entry>& driverData, double endTime,
+                                const std::vector<int>& outputs, const double* times, const double* values, int nTimes,
+                                double step, int decimation){
+    run._driverData = driverData;
+    run._endTime = endTime;
+    run._step = step;
+    run._decimation = decimation;
+    run._outputs = outputs;
+
+    // the samples of the model that the recording covers
+    int nModel = batchSamples(endTime, step, decimation);
+    int n = 0;
+    while(n < nModel && nTimes > 0 && n * decimation * step <= times[nTimes - 1] + step/10){
+        n++;
+    }
+    run._nSamples = n;
+
+    size_t k = outputs.size();
+    run._values.assign(k * n, 0.);
+    run._norms.assign(k, 0.);
+    int i = 0;
+    for(int s = 0; s < n; s++){
+        double t = s * decimation * step;
+        while(i + 1 < nTimes && times[i + 1] <= t){
+            i++;
+        }
+        // between times[i] and times[i + 1], or at one of the ends
+        double w = 0.;
+        if(i + 1 < nTimes && t > times[i]){
+            w = (t - times[i]) / (times[i + 1] - times[i]);
+        }
+        for(size_t c = 0; c < k; c++){
+            const double* v = values + c * nTimes;
+            double x = (w == 0.) ? v[i] : v[i] + w * (v[i + 1] - v[i]);
+            run._values[c * n + s] = x;
+            run._norms[c] += x * x;
+        }
+    }
+    for(size_t c = 0; c < k; c++){
+        run._norms[c] = std::sqrt(run._norms[c]);
+    }
+}
+
+// reads a .npy file of doubles with 1 or 2 dimensions - shape gets the rows and columns
+static bool readNpy(std::vector<double>& data, int& rows, int& cols, const std::string& fileName, std::string& error){
+    std::ifstream in(fileName, std::ios::binary);
+    char magic[8];
+    if(!in.read(magic, 8) || std::memcmp(magic, "\x93NUMPY", 6) != 0){
+        error = "cannot read " + fileName + " as a .npy file";
+        return false;
+    }
+    // the header length is 2 bytes in version 1 and 4 bytes after that
+    uint32_t headerLen = 0;
+    unsigned char len[4] = {0, 0, 0, 0};
+    in.read((char*)len, magic[6] == 1 ? 2 : 4);
+    headerLen = len[0] | (len[1] << 8) | (len[2] << 16) | (uint32_t(len[3]) << 24);
+    std::string header(headerLen, ' ');
+    if(!in.read(&header[0], headerLen)){
+        error = "cannot read " + fileName + " as a .npy file";
+        return false;
+    }
+    if(header.find("'<f8'") == std::string::npos || header.find("'fortran_order': False") == std::string::npos){
+        error = fileName + " has to hold little endian doubles in C order";
+        return false;
+    }
+    size_t open = header.find('(', header.find("'shape'"));
+    size_t close = header.find(')', open);
+    if(open == std::string::npos || close == std::string::npos){
+        error = "no shape in " + fileName;
+        return false;
+    }
+    std::vector<long> shape;
+    std::istringstream dims(header.substr(open + 1, close - open - 1));
+    std::string dim;
+    while(std::getline(dims, dim, ',')){
+        if(dim.find_first_not_of(' ') != std::string::npos){
+            shape.push_back(std::atol(dim.c_str()));
+        }
+    }
+    if(shape.empty() || shape.size() > 2){
+        error = fileName + " has to have 1 or 2 dimensions";
+        return false;
+    }
+    rows = shape.size() == 2 ? shape[0] : 1;
+    cols = shape.back();
+    data.resize(size_t(rows) * cols);
+    if(!in.read((char*)data.data(), data.size() * sizeof(double))){
+        error = fileName + " is shorter than its shape";
+        return false;
+    }
+    return true;
+}
+
+// reads the time column and the named columns of a csv file with a header
+static bool readCsv(std::vector<double>& times, std::vector<double>& values, const std::string& fileName,
+                    const std::vector<std::string>& columns, std::string& error){
+    std::ifstream in(fileName);
+    std::string line;
+    if(!std::getline(in, line)){
+        error = "cannot read " + fileName;
+        return false;
+    }
+
+    // column of every name, with the spaces around the names of the header dropped
+    std::vector<std::string> names;
+    std::istringstream header(line);
+    std::string name;
+    while(std::getline(header, name, ',')){
+        size_t b = name.find_first_not_of(" \t\r");
+        size_t e = name.find_last_not_of(" \t\r");
+        names.push_back(b == std::string::npos ? "" : name.substr(b, e - b + 1));
+    }
+    auto column = [&](const std::string& n){
+        for(size_t i = 0; i < names.size(); i++){
+            if(names[i] == n){
+                return int(i);
+            }
+        }
+        return -1;
+    };
+    int timeColumn = column("time");
+    if(timeColumn < 0){
+        error = "no time column in " + fileName;
+        return false;
+    }
+    std::vector<int> index;
+    std::vector<double> sign;
+    for(const std::string& c : columns){
+        bool flip = !c.empty() && c[0] == '-';
+        int i = column(flip ? c.substr(1) : c);
+        if(i < 0){
+            error = "no column " + c + " in " + fileName;
+            return false;
+        }
+        index.push_back(i);
+        sign.push_back(flip ? -1. : 1.);
+    }
+
+    // rows first, then transposed to one block per channel
+    std::vector<double> rows;
+    std::vector<double> fields;
+    while(std::getline(in, line)){
+        fields.clear();
+        const char* p = line.c_str();
+        while(*p){
+            char* end;
+            fields.push_back(std::strtod(p, &end));
+            p = std::strchr(end, ',');
+            if(!p){
+                break;
+            }
+            p++;
+        }
+        if(fields.size() <= size_t(timeColumn)){
+            continue;
+        }
+        times.push_back(fields[timeColumn]);
+        for(size_t c = 0; c < index.size(); c++){
+            rows.push_back(size_t(index[c]) < fields.size() ? sign[c] * fields[index[c]] : 0.);
+        }
+    }
+    size_t n = times.size();
+    size_t k = index.size();
+    values.resize(k * n);
+    for(size_t i = 0; i < n; i++){
+        for(size_t c = 0; c < k; c++){
+            values[c * n + i] = rows[i * k + c];
+        }
+    }
+    return true;
+}
+
+bool EightDOF::loadObservedRun(ObservedRun& run, const std::string& inputFile, double endTime, const std::string& dataFile,
+                                const std::vector<std::string>& outputs, const std::vector<std::string>& columns,
+                                double dataStep, double step, int decimation, std::string& error){
+    std::vector<int> channels;
+    for(const std::string& name : outputs){
+        int c = outputIndex(name);
+        if(c < 0){
+            error = "unknown output " + name;
+            return false;
+        }
+        channels.push_back(c);
+    }
+
+    std::vector<Entry> driverData;
+    driverInput(driverData, inputFile);
+    if(driverData.empty()){
+        error = "no driver inputs read from " + inputFile;
+        return false;
+    }
+
+    std::vector<double> times, values;
+    bool npy = dataFile.size() > 4 && dataFile.compare(dataFile.size() - 4, 4, ".npy") == 0;
+    if(npy){
+        int rows, cols;
+        if(!readNpy(values, rows, cols, dataFile, error)){
+            return false;
+        }
+        if(size_t(rows) != channels.size()){
+            error = dataFile + " does not have one row per output";
+            return false;
+        }
+        for(int i = 0; i < cols; i++){
+            times.push_back(i * dataStep);
+        }
+    }
+    else{
+        if(columns.size() != channels.size()){
+            error = "a csv file needs one column per output";
+            return false;
+        }
+        if(!readCsv(times, values, dataFile, columns, error)){
+            return false;
+        }
+    }
+    setObservedRun(run, driverData, endTime, channels, times.data(), values.data(), times.size(), step, decimation);
+    return true;
+}
+
+
+// loaded runs, with the size and the modification time of the data file when it was read
+struct CachedRun{
+    off_t _size;
+    time_t _mtime;
+    std::shared_ptr<const ObservedRun> _run;
+};
+
+static std::mutex runCacheMutex;
+static std::map<std::string, CachedRun> runCache;
+
+std::shared_ptr<const ObservedRun> EightDOF::cachedObservedRun(const std::string& inputFile, double endTime,
+                                const std::string& dataFile, const std::vector<std::string>& outputs,
+                                const std::vector<std::string>& columns, double dataStep, double step,
+                                int decimation, std::string& error){
+    // all the arguments make the key
+    std::ostringstream key;
+    key.precision(17);
+    key<<inputFile<<'\n'<<endTime<<'\n'<<dataFile<<'\n'<<dataStep<<'\n'<<step<<'\n'<<decimation;
+    for(const std::string& o : outputs){
+        key<<'\n'<<o;
+    }
+    key<<'\n';
+    for(const std::string& c : columns){
+        key<<'\n'<<c;
+    }
+
+    struct stat st;
+    bool known = (stat(dataFile.c_str(), &st) == 0);
+    {
+        std::lock_guard<std::mutex> lock(runCacheMutex);
+        std::map<std::string, CachedRun>::const_iterator it = runCache.find(key.str());
+        if(known && it != runCache.end() && it->second._size == st.st_size && it->second._mtime == st.st_mtime){
+            return it->second._run;
+        }
+    }
+
+    // read outside the lock, a thread that read the same files at the same time only wastes the work
+    std::shared_ptr<ObservedRun> run = std::make_shared<ObservedRun>();
+    if(!loadObservedRun(*run, inputFile, endTime, dataFile, outputs, columns, dataStep, step, decimation, error)){
+        return nullptr;
+    }
+    if(known){
+        std::lock_guard<std::mutex> lock(runCacheMutex);
+        runCache[key.str()] = CachedRun{st.st_size, st.st_mtime, run};
+    }
+    return run;
+}
+
+
+Likelihood::Likelihood(const VehicleParam& v_params, const TMeasyParam& t_params, const ParamGroups& groups)
+    : _v_params(v_params), _t_params(t_params), _groups(groups) {}
+
+bool Likelihood::addRun(const std::shared_ptr<const ObservedRun>& run){
+    if(!run || run->_nSamples == 0 || run->_step != _v_params._step || (!_runs.empty() && run->_outputs.size() != numChannels())){
+        return false;
+    }
+    _runs.push_back(run);
+    return true;
+}
+
+double Likelihood::logLikelihood(const double* theta, const double* sigmas, double* residualNorms) const{
+    size_t k = numChannels();
+    VehicleParam veh_param = _v_params;
+    TMeasyParam tire_param = _t_params;
+    scaleParams(veh_param, tire_param, _groups, theta);
+    Simulator sim(veh_param, tire_param);
+    Controls controls;
+    double step = veh_param._step;
+
+    std::vector<double> total(k, 0.);
+    double like = 0.;
+    for(const std::shared_ptr<const ObservedRun>& run : _runs){
+        const ObservedRun& obs = *run;
+        int n = obs._nSamples;
+        std::vector<double> ss(k, 0.);
+
+        // only as far as the last sample compared
+        sim.reset();
+        Driver_input input(obs._driverData);
+        double t = 0;
+        int nSteps = (n - 1) * obs._decimation + 1;
+        for(int i = 0; i < nSteps; i++){
+            getControls(controls, input, t);
+            sim.step(controls);
+            t += step;
+
+            if(i % obs._decimation == 0){
+                int s = i / obs._decimation;
+                for(size_t c = 0; c < k; c++){
+                    double r = sim.getOutput(obs._outputs[c]) - obs._values[c * n + s];
+                    ss[c] += r * r;
+                }
+            }
+        }
+
+        double W = 0., S = 0., logs = 0.;
+        for(size_t c = 0; c < k; c++){
+            W += 1. / obs._norms[c];
+            S += ss[c] / (2. * sigmas[c] * sigmas[c]);
+            logs += n * std::log(2. * PI * sigmas[c] * sigmas[c]) / 2.;
+            total[c] += ss[c];
+        }
+        like += -(W * logs + k * W * S);
+    }
+
+    if(residualNorms){
+        for(size_t c = 0; c < k; c++){
+            residualNorms[c] = std::sqrt(total[c]);
+        }
+    }
+    return _runs.empty() ? 0. : like / _runs.size();
+}
@@ -0,0 +1,87 @@
+#ifndef LIKELIHOOD_H
+#define LIKELIHOOD_H
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../utils.h"
+#include "Eightdof.h"
+#include "Batch.h"
+/*
+Header file for the log likelihood of the calibrations, evaluated without handing the simulated
+trajectories back. The recorded data is read once and interpolated onto the output samples of
+the model, and the residuals are summed up while the model runs
+*/
+
+namespace EightDOF{
+
+    // A recorded run - the driver inputs and the observed channels at the output samples of the
+    // model, which are the samples simulate returns (the state after every step whose index is a
+    // multiple of decimation, taken at the time step index * step like the calibration scripts do)
+    struct ObservedRun{
+        std::vector<Entry> _driverData;
+        double _endTime;
+        double _step;
+        int _decimation;
+        std::vector<int> _outputs; // model output channel compared with each observed channel
+        int _nSamples; // samples compared - those inside both the run and the recording
+        std::vector<double> _values; // _values[c*_nSamples + s]
+        std::vector<double> _norms; // 2 norm of every observed channel
+    };
+
+    // Sets up run from the observations values[c*nTimes + i] of channel c at times[i] (increasing),
+    // interpolated linearly onto the samples of the model
+    void setObservedRun(ObservedRun& run, const std::vector<Entry>& driverData, double endTime,
+                        const std::vector<int>& outputs, const double* times, const double* values, int nTimes,
+                        double step, int decimation);
+
+    // Reads the observations from dataFile, either a csv file with a header that has a time column
+    // and the given columns (a leading '-' flips the sign of a column, e.g. "-x"), or a .npy file
+    // of little endian doubles with one row per channel (shape (channels, samples)) taken every
+    // dataStep seconds from 0 on. outputs are the model channels compared with them (see
+    // outputIndex). Returns false with the reason in error if a file cannot be read
+    bool loadObservedRun(ObservedRun& run, const std::string& inputFile, double endTime, const std::string& dataFile,
+                            const std::vector<std::string>& outputs, const std::vector<std::string>& columns,
+                            double dataStep, double step, int decimation, std::string& error);
+
+#ifndef SWIG
+    // Same as loadObservedRun, but the files are read only once per process for every set of
+    // arguments (and again when the data file changes) - for the calibration loop. Returns
+    // nullptr with the reason in error if they cannot be read. Safe to call from several threads
+    std::shared_ptr<const ObservedRun> cachedObservedRun(const std::string& inputFile, double endTime,
+                            const std::string& dataFile, const std::vector<std::string>& outputs,
+                            const std::vector<std::string>& columns, double dataStep, double step,
+                            int decimation, std::string& error);
+
+    // Gaussian log likelihood of the recorded runs for parameter multipliers theta, as the
+    // calibration scripts compute it: with k channels, n samples, the residuals r and the data d
+    // of a run,
+    //     L = -(W * sum_c n*log(2*pi*sigma_c^2)/2 + k*W*S),  W = sum_c 1/|d_c|,  S = sum_c |r_c|^2/(2*sigma_c^2)
+    // averaged over the runs. All the runs compare the same number of channels, with one sigma each
+    class Likelihood{
+      public:
+        // the parameters are copied and their groups multiplied by theta for every evaluation
+        Likelihood(const VehicleParam& v_params, const TMeasyParam& t_params, const ParamGroups& groups);
+
+        // false if run does not have the time step of the parameters or the channels of the
+        // runs added before
+        bool addRun(const std::shared_ptr<const ObservedRun>& run);
+
+        size_t numRuns() const { return _runs.size(); }
+        size_t numChannels() const { return _runs.empty() ? 0 : _runs[0]->_outputs.size(); }
+
+        // theta has one multiplier per group and sigmas one standard deviation per channel.
+        // residualNorms, if given, gets the 2 norm of the residuals of every channel over all the
+        // runs. Does not change the object, so threads can share it
+        double logLikelihood(const double* theta, const double* sigmas, double* residualNorms = nullptr) const;
+
+      private:
+        VehicleParam _v_params;
+        TMeasyParam _t_params;
+        ParamGroups _groups;
+        std::vector<std::shared_ptr<const ObservedRun>> _runs;
+    };
+#endif
+}
+
+#endif
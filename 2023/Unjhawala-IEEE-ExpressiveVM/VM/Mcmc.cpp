@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include "Mcmc.h"
+#include "ThreadPool.h"
+
+using namespace EightDOF;
+
+/*
+Code for the ensemble sampler. A walker only ever draws from its own random stream, three numbers
+per move whether it is accepted or not, so the chains are a function of the seed alone
+*/
+
+static const double NEG_INF = -std::numeric_limits<double>::infinity();
+
+double EightDOF::mcmcLogPrior(const McmcPrior& prior, double x){
+    if(prior._kind == MCMC_UNIFORM){
+        return (x >= prior._a && x <= prior._b) ? 0. : NEG_INF;
+    }
+    return x >= 0. ? -x * x / (2. * prior._a * prior._a) : NEG_INF;
+}
+
+// uniform on [0, 1) from the 53 high bits
+static double uniform(std::mt19937_64& rng){
+    return (rng() >> 11) * (1. / 9007199254740992.);
+}
+
+// log prior plus log likelihood, the likelihood is not evaluated outside the prior
+static double logPost(const McmcLogLike& loglike, const std::vector<McmcPrior>& priors, const double* x){
+    double lp = 0.;
+    for(size_t d = 0; d < priors.size(); d++){
+        lp += mcmcLogPrior(priors[d], x[d]);
+    }
+    if(lp == NEG_INF){
+        return lp;
+    }
+    lp += loglike(x);
+    return std::isnan(lp) ? NEG_INF : lp;
+}
+
+double EightDOF::sampleEnsemble(const McmcLogLike& loglike, const std::vector<McmcPrior>& priors,
+                                    const McmcSettings& settings, std::ostream& out, std::string& error){
+    int dims = priors.size();
+    int nWalkers = settings._walkers;
+    if(dims == 0 || nWalkers % 2 != 0 || nWalkers < 2 * dims || settings._draws < 1 || settings._tune < 0
+        || settings._thin < 1 || settings._stretch <= 1.){
+        error = "the walkers have to be even and at least twice the quantities sampled, the stretch above 1";
+        return -1.;
+    }
+    int nHalf = nWalkers / 2;
+    double a = settings._stretch;
+
+    std::vector<std::mt19937_64> rngs;
+    for(int w = 0; w < nWalkers; w++){
+        rngs.emplace_back(settings._seed + 0x9E3779B97F4A7C15ULL * (w + 1));
+    }
+    std::vector<double> x(nWalkers * dims);
+    std::vector<double> proposals(nWalkers * dims); // proposal of each walker, so a move does not allocate
+    std::vector<double> lp(nWalkers);
+    std::vector<long> accepted(nWalkers, 0);
+    ThreadPool pool(settings._threads);
+
+    // start every walker at a random point around the initial values that the posterior allows
+    pool.parallelFor(nWalkers, 1, [&](size_t w){
+        double* xw = &x[w * dims];
+        lp[w] = NEG_INF;
+        for(int tries = 0; tries < 1000 && lp[w] == NEG_INF; tries++){
+            for(int d = 0; d < dims; d++){
+                double init = priors[d]._init;
+                double width = settings._spread * (init != 0. ? std::abs(init) : 1.);
+                xw[d] = init + width * (2. * uniform(rngs[w]) - 1.);
+            }
+            lp[w] = logPost(loglike, priors, xw);
+        }
+    });
+    for(int w = 0; w < nWalkers; w++){
+        if(lp[w] == NEG_INF){
+            error = "no walker could be started where the posterior is positive, check the initial values";
+            return -1.;
+        }
+    }
+
+    // stretch move of walker k towards a walker of the other half, which does not move meanwhile
+    auto move = [&](int k, int other, bool count){
+        std::mt19937_64& rng = rngs[k];
+        int j = other + std::min(int(uniform(rng) * nHalf), nHalf - 1);
+        double u = uniform(rng);
+        double z = ((a - 1.) * u + 1.) * ((a - 1.) * u + 1.) / a;
+        double r = uniform(rng);
+
+        double* y = &proposals[k * dims];
+        const double* xk = &x[k * dims];
+        const double* xj = &x[j * dims];
+        for(int d = 0; d < dims; d++){
+            y[d] = xj[d] + z * (xk[d] - xj[d]);
+        }
+        double lpy = logPost(loglike, priors, y);
+        if(lpy != NEG_INF && std::log(r) < (dims - 1) * std::log(z) + lpy - lp[k]){
+            std::copy(y, y + dims, &x[k * dims]);
+            lp[k] = lpy;
+            if(count){
+                accepted[k]++;
+            }
+        }
+    };
+
+    out<<"chain,draw,lp";
+    for(const McmcPrior& p : priors){
+        out<<","<<p._name;
+    }
+    out<<"\n";
+
+    char buf[32];
+    int nSteps = settings._tune + settings._draws * settings._thin;
+    for(int step = 0; step < nSteps; step++){
+        bool tuned = step >= settings._tune;
+        for(int half = 0; half < 2; half++){
+            pool.parallelFor(nHalf, 1, [&](size_t i){
+                move(half * nHalf + i, (1 - half) * nHalf, tuned);
+            });
+        }
+        if(!tuned || (step - settings._tune) % settings._thin != settings._thin - 1){
+            continue;
+        }
+        int draw = (step - settings._tune) / settings._thin;
+        for(int w = 0; w < nWalkers; w++){
+            out<<w<<","<<draw;
+            std::snprintf(buf, sizeof(buf), ",%.17g", lp[w]);
+            out<<buf;
+            for(int d = 0; d < dims; d++){
+                std::snprintf(buf, sizeof(buf), ",%.17g", x[w * dims + d]);
+                out<<buf;
+            }
+            out<<"\n";
+        }
+    }
+
+    long total = 0;
+    for(long n : accepted){
+        total += n;
+    }
+    return double(total) / (double(nWalkers) * settings._draws * settings._thin);
+}
@@ -0,0 +1,57 @@
+#ifndef MCMC_H
+#define MCMC_H
+#include <stdint.h>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+/*
+Header file for the affine invariant ensemble sampler (the stretch move of Goodman and Weare) used
+to calibrate the 8 DOF model without python in the loop. The walkers are split into two halves and
+each half is moved in parallel on the thread pool using the positions of the other half. Every
+walker has its own random stream drawn from the seed, so the draws do not depend on the number of
+threads
+*/
+
+namespace EightDOF{
+
+    enum McmcPriorKind{
+        MCMC_UNIFORM, // between _a and _b
+        MCMC_HALFNORMAL // positive values, with scale _a
+    };
+
+    // prior of one sampled quantity and the point the walkers start around
+    struct McmcPrior{
+        std::string _name;
+        McmcPriorKind _kind;
+        double _a, _b;
+        double _init;
+    };
+
+    // log density of the prior up to a constant, -inf outside its support
+    double mcmcLogPrior(const McmcPrior& prior, double x);
+
+    struct McmcSettings{
+        int _walkers = 32; // even, and at least twice the number of sampled quantities
+        int _draws = 1000; // draws per walker written out
+        int _tune = 500; // steps per walker that are dropped before them
+        int _thin = 1; // keep every _thin-th step
+        double _stretch = 2.; // scale a of the stretch move, z has density 1/sqrt(z) on [1/a, a]
+        double _spread = 0.01; // the walkers start within _init*(1 -+ _spread)
+        uint64_t _seed = 1;
+        unsigned int _threads = 0; // 0 - all the cores
+    };
+
+    // log likelihood of the sampled quantities (one value per prior, in their order). Called from
+    // several threads at once, so it must not change shared data
+    typedef std::function<double(const double* x)> McmcLogLike;
+
+    // Runs the sampler and writes the draws to out as csv with the columns chain, draw, lp and the
+    // names of the priors - one row per walker and draw, the walkers being the chains. Returns the
+    // fraction of accepted moves after tuning, or -1 with the reason in error if the settings are
+    // bad or no walker could be started inside the prior
+    double sampleEnsemble(const McmcLogLike& loglike, const std::vector<McmcPrior>& priors,
+                            const McmcSettings& settings, std::ostream& out, std::string& error);
+}
+
+#endif
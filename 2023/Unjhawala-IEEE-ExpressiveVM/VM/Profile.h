@@ -0,0 +1,227 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+/*
+Header file for timing the stages of a model step (the tire transforms, tireAdv, evalPowertrain
+and vehAdv). It is switched on at compile time with -DEDOF_PROFILE, without it the macros below
+are empty and the model is exactly what it is without this file.
+When on, every stage call reads the time stamp counter before and after, and the cycles go into
+a histogram per stage and per thread (quarter octave bins, so nothing is allocated or locked
+while timing). The histograms of a thread are added to a global one when it exits, and the
+summary is printed to stderr at the exit of the program (or with printProfile at any time)
+*/
+
+#ifdef EDOF_PROFILE
+
+#include <stdint.h>
+#include <chrono>
+#include <mutex>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace EightDOF{
+
+    enum ProfileStage{
+        STAGE_VEH_TO_TIRE,
+        STAGE_TIRE_ADV,
+        STAGE_POWERTRAIN,
+        STAGE_TIRE_TO_VEH,
+        STAGE_VEH_ADV,
+        NUM_STAGES
+    };
+
+    static const char* const STAGE_NAMES[NUM_STAGES] = {
+        "vehToTireTransform", "tireAdv", "evalPowertrain", "tireToVehTransform", "vehAdv"
+    };
+
+    // time stamp counter - cycles on x86, the virtual counter on arm, nanoseconds elsewhere
+    inline uint64_t readCycles(){
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#elif defined(__aarch64__)
+        uint64_t v;
+        asm volatile("mrs %0, cntvct_el0" : "=r"(v));
+        return v;
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    // histogram of the cycles of one stage - 4 bins per power of 2
+    struct StageHistogram{
+        static const int BINS = 4 * 64;
+
+        uint64_t _calls, _total, _min, _max;
+        uint64_t _bins[BINS];
+
+        StageHistogram() { clear(); }
+
+        void clear(){
+            _calls = _total = _max = 0;
+            _min = ~uint64_t(0);
+            std::fill(_bins, _bins + BINS, 0);
+        }
+
+        static int bin(uint64_t c){
+            if(c < 4){
+                return int(c);
+            }
+            int e = 63 - __builtin_clzll(c);
+            return 4 * (e - 1) + int((c >> (e - 2)) & 3);
+        }
+
+        // lower edge of a bin
+        static double edge(int b){
+            if(b < 4){
+                return b;
+            }
+            int e = b / 4 + 1;
+            return double((uint64_t(4) | (b & 3)) << (e - 2));
+        }
+
+        void add(uint64_t c){
+            _calls++;
+            _total += c;
+            _min = std::min(_min, c);
+            _max = std::max(_max, c);
+            _bins[bin(c)]++;
+        }
+
+        void add(const StageHistogram& h){
+            _calls += h._calls;
+            _total += h._total;
+            _min = std::min(_min, h._min);
+            _max = std::max(_max, h._max);
+            for(int b = 0; b < BINS; b++){
+                _bins[b] += h._bins[b];
+            }
+        }
+
+        // p-th percentile (0 - 100), the lower edge of the bin it falls in
+        double percentile(double p) const{
+            uint64_t rank = std::max<uint64_t>(1, uint64_t(p / 100. * _calls + 0.5));
+            uint64_t seen = 0;
+            for(int b = 0; b < BINS; b++){
+                seen += _bins[b];
+                if(seen >= rank){
+                    return edge(b);
+                }
+            }
+            return double(_max);
+        }
+    };
+
+    // histograms of all the threads that have exited, printed at the exit of the program
+    class ProfileRegistry{
+      public:
+        ProfileRegistry()
+            : _startCycles(readCycles()), _startTime(std::chrono::steady_clock::now()) {}
+
+        ~ProfileRegistry() { print(std::cerr); }
+
+        void add(const StageHistogram* h){
+            std::lock_guard<std::mutex> lock(_mutex);
+            for(int s = 0; s < NUM_STAGES; s++){
+                _stages[s].add(h[s]);
+            }
+        }
+
+        // summary of the exited threads and of the histograms h (those of the calling thread)
+        void print(std::ostream& out, const StageHistogram* h = nullptr){
+            StageHistogram stages[NUM_STAGES];
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                for(int s = 0; s < NUM_STAGES; s++){
+                    stages[s].add(_stages[s]);
+                    if(h){
+                        stages[s].add(h[s]);
+                    }
+                }
+            }
+            // counter ticks per ns, measured over the life of the registry
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - _startTime).count();
+            double perNs = ns > 0. ? (readCycles() - _startCycles) / ns : 1.;
+
+            std::ios::fmtflags flags = out.flags();
+            out<<"Stage times (ns) - "<<perNs<<" counter ticks per ns\n";
+            out<<std::left<<std::setw(20)<<"stage"<<std::right<<std::setw(12)<<"calls"<<std::setw(12)<<"total ms"
+               <<std::setw(9)<<"mean"<<std::setw(9)<<"min"<<std::setw(9)<<"p50"<<std::setw(9)<<"p90"
+               <<std::setw(9)<<"p99"<<std::setw(11)<<"max"<<"\n";
+            out<<std::fixed<<std::setprecision(1);
+            for(int s = 0; s < NUM_STAGES; s++){
+                const StageHistogram& st = stages[s];
+                if(st._calls == 0){
+                    continue;
+                }
+                out<<std::left<<std::setw(20)<<STAGE_NAMES[s]<<std::right<<std::setw(12)<<st._calls
+                   <<std::setw(12)<<st._total / perNs * 1e-6<<std::setw(9)<<double(st._total) / st._calls / perNs
+                   <<std::setw(9)<<st._min / perNs<<std::setw(9)<<st.percentile(50.) / perNs
+                   <<std::setw(9)<<st.percentile(90.) / perNs<<std::setw(9)<<st.percentile(99.) / perNs
+                   <<std::setw(11)<<st._max / perNs<<"\n";
+            }
+            out.flags(flags);
+        }
+
+        static ProfileRegistry& instance(){
+            static ProfileRegistry registry;
+            return registry;
+        }
+
+      private:
+        std::mutex _mutex;
+        StageHistogram _stages[NUM_STAGES];
+        uint64_t _startCycles;
+        std::chrono::steady_clock::time_point _startTime;
+    };
+
+    // the histograms of one thread
+    struct ThreadProfile{
+        StageHistogram _stages[NUM_STAGES];
+        ProfileRegistry& _registry;
+
+        // the registry is made first, so that it outlives the thread profiles
+        ThreadProfile() : _registry(ProfileRegistry::instance()) {}
+        ~ThreadProfile() { _registry.add(_stages); }
+    };
+
+    inline thread_local ThreadProfile threadProfile;
+
+    // times the rest of the enclosing scope as one call of a stage
+    class StageTimer{
+      public:
+        explicit StageTimer(ProfileStage stage) : _stage(stage), _start(readCycles()) {}
+        ~StageTimer() { threadProfile._stages[_stage].add(readCycles() - _start); }
+
+      private:
+        ProfileStage _stage;
+        uint64_t _start;
+    };
+
+    // prints the summary so far (the exited threads and the calling one)
+    inline void printProfile(std::ostream& out){
+        ProfileRegistry::instance().print(out, threadProfile._stages);
+    }
+
+    // forgets the calls of the calling thread so far, to leave out a warm up
+    inline void resetProfile(){
+        for(int s = 0; s < NUM_STAGES; s++){
+            threadProfile._stages[s].clear();
+        }
+    }
+}
+
+#define EDOF_PROFILE_CONCAT2(a, b) a##b
+#define EDOF_PROFILE_CONCAT(a, b) EDOF_PROFILE_CONCAT2(a, b)
+#define EDOF_PROFILE_STAGE(stage) ::EightDOF::StageTimer EDOF_PROFILE_CONCAT(edof_stage_timer_, __LINE__)(::EightDOF::stage)
+
+#else
+
+#define EDOF_PROFILE_STAGE(stage)
+
+#endif
+
+#endif
@@ -0,0 +1,105 @@
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include "RealTime.h"
+
+using namespace EightDOF;
+
+/*
+Code for the paced runner. Every step has a fixed start on the wall clock, start + i * period.
+The runner sleeps until a little before it and busy waits the rest, so the lateness of the
+start (jitter) stays small, then takes the latest controls, steps and publishes the state
+*/
+
+// bins of the histograms - 1 us each, the last one counts everything longer
+static const size_t HIST_BINS = 10001;
+
+typedef std::chrono::steady_clock Clock;
+
+double RealTimeStats::percentile(const std::vector<uint64_t>& hist, double p){
+    uint64_t total = 0;
+    for(uint64_t n : hist){
+        total += n;
+    }
+    if(total == 0){
+        return 0.;
+    }
+    // the rank of the percentile, counted from 1
+    uint64_t rank = std::max<uint64_t>(1, uint64_t(std::ceil(p / 100. * total)));
+    uint64_t seen = 0;
+    for(size_t i = 0; i < hist.size(); i++){
+        seen += hist[i];
+        if(seen >= rank){
+            return double(i + 1);
+        }
+    }
+    return double(hist.size());
+}
+
+static void addToHist(std::vector<uint64_t>& hist, double& maxVal, std::chrono::nanoseconds t){
+    double us = std::chrono::duration<double, std::micro>(t).count();
+    maxVal = std::max(maxVal, us);
+    size_t bin = us <= 0. ? 0 : std::min<size_t>(size_t(us), hist.size() - 1);
+    hist[bin]++;
+}
+
+RealTimeRunner::RealTimeRunner(Simulator& sim, double period, double spin)
+    : _sim(sim), _stop(false) {
+    if(period <= 0.){
+        period = sim.getVehicleParam()._step;
+    }
+    _period = std::chrono::nanoseconds(int64_t(period * 1e9 + 0.5));
+    _spin = std::chrono::nanoseconds(int64_t(spin * 1e9 + 0.5));
+    _stats._stepHist.resize(HIST_BINS);
+    _stats._jitterHist.resize(HIST_BINS);
+}
+
+void RealTimeRunner::run(double endTime){
+    _stats._steps = _stats._misses = _stats._dropped = 0;
+    std::fill(_stats._stepHist.begin(), _stats._stepHist.end(), 0);
+    std::fill(_stats._jitterHist.begin(), _stats._jitterHist.end(), 0);
+    _stats._maxStep = _stats._maxJitter = 0.;
+    _stop.store(false);
+
+    double step = _sim.getVehicleParam()._step;
+    Controls controls;
+    controls._time = _sim.getTime();
+    controls._steering = controls._throttle = controls._braking = 0.;
+    RealTimeSample sample;
+
+    Clock::time_point start = Clock::now();
+    Clock::time_point next = start;
+    while(_sim.getTime() < (endTime - step/10) && !_stop.load(std::memory_order_relaxed)){
+        // sleep to a little before the start of the step and spin the rest
+        if(next - Clock::now() > _spin){
+            std::this_thread::sleep_until(next - _spin);
+        }
+        Clock::time_point wake = Clock::now();
+        while(wake < next){
+            std::this_thread::yield();
+            wake = Clock::now();
+        }
+
+        _controls.read(controls);
+        controls._time = _sim.getTime();
+        _sim.step(controls);
+        Clock::time_point done = Clock::now();
+
+        addToHist(_stats._jitterHist, _stats._maxJitter, wake - next);
+        addToHist(_stats._stepHist, _stats._maxStep, done - wake);
+        next += _period;
+        if(done > next){
+            _stats._misses++;
+        }
+
+        sample._step = _stats._steps++;
+        sample._wall = std::chrono::duration<double>(done - start).count();
+        sample._v_states = _sim.getVehicleState();
+        for(int i = 0; i < 4; i++){
+            sample._omega[i] = _sim.getTireState(i)._omega;
+        }
+        if(!_samples.push(sample)){
+            _stats._dropped++;
+        }
+    }
+}
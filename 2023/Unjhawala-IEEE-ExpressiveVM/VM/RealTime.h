@@ -0,0 +1,151 @@
+#ifndef REALTIME_H
+#define REALTIME_H
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include "../utils.h"
+#include "Eightdof.h"
+#include "Simulator.h"
+/*
+Header file for running a Simulator paced against the wall clock, for hardware in the loop tests.
+The controls come in through a ControlSlot that another thread writes whenever it likes, and the
+states go out through a single producer / single consumer ring. Neither blocks the simulation
+thread, and the runner keeps statistics of how well it kept to the clock
+*/
+
+namespace EightDOF{
+
+    // Latest controls handed from one writer thread to the simulation thread without locks
+    // (a triple buffer). The reader always gets the most recent complete write, older ones
+    // that were never read are dropped
+    class ControlSlot{
+      public:
+        ControlSlot() : _middle(1), _back(2), _front(0) {}
+
+        // writer side
+        void write(const Controls& controls){
+            _buf[_back] = controls;
+            _back = _middle.exchange(_back | FRESH, std::memory_order_acq_rel) & INDEX;
+        }
+
+        // reader side - true and the new controls if there was a write since the last read,
+        // otherwise controls is left as it is
+        bool read(Controls& controls){
+            if(!(_middle.load(std::memory_order_relaxed) & FRESH)){
+                return false;
+            }
+            _front = _middle.exchange(_front, std::memory_order_acq_rel) & INDEX;
+            controls = _buf[_front];
+            return true;
+        }
+
+      private:
+        static const int INDEX = 3;
+        static const int FRESH = 4;
+
+        Controls _buf[3];
+        std::atomic<int> _middle; // index of the buffer between the two, with FRESH set by a write
+        int _back; // writer's buffer
+        int _front; // reader's buffer
+    };
+
+
+    // Bounded ring for one producer and one consumer thread, N has to be a power of 2.
+    // push and pop never block or allocate
+    template <typename T, size_t N>
+    class SpscRing{
+        static_assert((N & (N - 1)) == 0, "the size of an SpscRing has to be a power of 2");
+      public:
+        SpscRing() : _head(0), _tail(0) {}
+
+        // producer side - false if the ring is full
+        bool push(const T& v){
+            size_t head = _head.load(std::memory_order_relaxed);
+            if(head - _tail.load(std::memory_order_acquire) == N){
+                return false;
+            }
+            _buf[head & (N - 1)] = v;
+            _head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // consumer side - false if the ring is empty
+        bool pop(T& v){
+            size_t tail = _tail.load(std::memory_order_relaxed);
+            if(tail == _head.load(std::memory_order_acquire)){
+                return false;
+            }
+            v = _buf[tail & (N - 1)];
+            _tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+      private:
+        // head and tail on their own cache lines so the two threads do not share one
+        alignas(64) std::atomic<size_t> _head; // next slot the producer writes
+        alignas(64) std::atomic<size_t> _tail; // next slot the consumer reads
+        alignas(64) T _buf[N];
+    };
+
+
+    // what the runner publishes after every step
+    struct RealTimeSample{
+        uint64_t _step; // index of the step
+        double _wall; // wall clock time since the start (s) when the step was done
+        VehicleState _v_states;
+        double _omega[4]; // wheel speeds
+    };
+
+    static const size_t REALTIME_RING_SIZE = 4096;
+    typedef SpscRing<RealTimeSample, REALTIME_RING_SIZE> RealTimeRing;
+
+
+    // Statistics of a paced run. Times are histograms with 1 us bins so that percentiles are
+    // available without storing every step
+    struct RealTimeStats{
+        uint64_t _steps; // steps taken
+        uint64_t _misses; // steps that ended after the start of the next period
+        uint64_t _dropped; // samples not published because the ring was full
+        std::vector<uint64_t> _stepHist; // time to compute a step (us), the last bin counts the longer ones
+        std::vector<uint64_t> _jitterHist; // lateness of the start of a step (us), same
+        double _maxStep, _maxJitter; // largest values (us)
+
+        // p-th percentile (0 - 100) of a histogram in us - the upper edge of the bin it falls in
+        static double percentile(const std::vector<uint64_t>& hist, double p);
+    };
+
+
+    class RealTimeRunner{
+      public:
+        // runs sim with one model step every period seconds of wall clock time - period = 0 uses
+        // the model's time step (real time). spin is the time (s) before each step that is busy
+        // waited instead of slept, as sleeping wakes up late by about that much
+        RealTimeRunner(Simulator& sim, double period = 0., double spin = 100e-6);
+
+        RealTimeRunner(const RealTimeRunner&) = delete;
+        RealTimeRunner& operator=(const RealTimeRunner&) = delete;
+
+        ControlSlot& controls() { return _controls; }
+        RealTimeRing& samples() { return _samples; }
+
+        // runs until the model time endTime or until stop is called (from another thread).
+        // Steps that end late are counted as misses, the following steps stay on the original
+        // schedule rather than shifting it. Nothing is allocated while it runs
+        void run(double endTime);
+        void stop() { _stop.store(true); }
+
+        const RealTimeStats& stats() const { return _stats; }
+
+      private:
+        Simulator& _sim;
+        std::chrono::nanoseconds _period;
+        std::chrono::nanoseconds _spin;
+        ControlSlot _controls;
+        RealTimeRing _samples;
+        RealTimeStats _stats;
+        std::atomic<bool> _stop;
+    };
+}
+
+#endif
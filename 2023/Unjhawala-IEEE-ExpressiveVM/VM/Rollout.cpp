@@ -0,0 +1,78 @@
+#include <atomic>
+#include <limits>
+#include <algorithm>
+#include "Rollout.h"
+
+using namespace EightDOF;
+
+/*
+Code for the rollouts. The candidates are split into a fixed number of chunks per thread so
+that the cost of handing them out does not grow with the number of candidates
+*/
+
+// chunks per thread - a few, so that threads that finish early take over the rest
+static const size_t CHUNKS_PER_THREAD = 4;
+
+RolloutEngine::RolloutEngine(const VehicleParam& v_params, const TMeasyParam& t_params, unsigned int num_threads)
+    : _pool(num_threads) {
+    for(unsigned int i = 0; i <= _pool.size(); i++){
+        _sims.emplace_back(new Simulator(v_params, t_params));
+    }
+}
+
+int RolloutEngine::evaluate(const SimulatorSnapshot& start, const double* controls, int nCandidates, int horizon, int hold,
+                            const RolloutStageCost& stage, const RolloutTerminalCost& terminal, double* costs,
+                            SimulatorSnapshot* terminal_states, std::chrono::steady_clock::time_point deadline){
+    bool timed = deadline != std::chrono::steady_clock::time_point::max();
+
+    // runs candidate k on the Simulator of the calling thread, false if it was skipped
+    auto run = [&](size_t k){
+        if(timed && std::chrono::steady_clock::now() >= deadline){
+            costs[k] = std::numeric_limits<double>::infinity();
+            if(terminal_states){
+                terminal_states[k] = start;
+            }
+            return false;
+        }
+
+        Simulator& sim = *_sims[_pool.workerIndex()];
+        sim.restore(start);
+        const double* u = controls + k * horizon * 3;
+        Controls c;
+        double cost = 0.;
+        for(int h = 0; h < horizon; h++, u += 3){
+            c._steering = u[0];
+            c._throttle = u[1];
+            c._braking = u[2];
+            for(int i = 0; i < hold; i++){
+                c._time = sim.getTime();
+                sim.step(c);
+            }
+            if(stage){
+                cost += stage(h, sim.getVehicleState(), u);
+            }
+        }
+        if(terminal){
+            cost += terminal(sim.getVehicleState());
+        }
+        costs[k] = cost;
+        if(terminal_states){
+            sim.snapshot(terminal_states[k]);
+        }
+        return true;
+    };
+
+    // exactly chunks tasks whatever the number of candidates, chunk c runs the candidates
+    // c*n/chunks up to (c+1)*n/chunks
+    std::atomic<int> evaluated(0);
+    size_t n = nCandidates > 0 ? size_t(nCandidates) : 0;
+    size_t chunks = std::min(n, CHUNKS_PER_THREAD * (_pool.size() + 1));
+    _pool.parallelFor(chunks, 1, [&](size_t c){
+        int done = 0;
+        for(size_t k = c * n / chunks; k < (c + 1) * n / chunks; k++){
+            done += run(k);
+        }
+        evaluated.fetch_add(done, std::memory_order_relaxed);
+    });
+    return evaluated.load();
+}
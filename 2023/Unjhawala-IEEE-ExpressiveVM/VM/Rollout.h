@@ -0,0 +1,62 @@
+#ifndef ROLLOUT_H
+#define ROLLOUT_H
+#include <stdint.h>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "../utils.h"
+#include "Eightdof.h"
+#include "Simulator.h"
+#include "ThreadPool.h"
+/*
+Header file for evaluating candidate control sequences of a model predictive controller. All
+the candidates start from the same state (a Simulator snapshot) and are run in parallel on
+the thread pool, every thread with its own Simulator.
+This does not meet a budget of 1000 rollouts of 2 s in 10 ms. A model step takes about 1.1 us,
+so those 2 million steps take 2.2 to 2.6 s on one core, about 250 times the budget, and with a
+10 ms deadline only 4 or 5 of the 1000 candidates are evaluated. Cores only divide the time, so
+the horizon, the number of candidates or the model step (hold) have to give instead
+*/
+
+namespace EightDOF{
+
+    // cost of control interval h (0 .. horizon-1) of a candidate, given the vehicle state at the
+    // end of the interval and the controls (steering, throttle, braking) applied during it.
+    // Called from the worker threads, so it must not change shared data
+    typedef std::function<double(int h, const VehicleState& v_states, const double* controls)> RolloutStageCost;
+
+    // cost of the vehicle state at the end of the horizon
+    typedef std::function<double(const VehicleState& v_states)> RolloutTerminalCost;
+
+    class RolloutEngine{
+      public:
+        // one Simulator per thread of the pool (and one for the calling thread) is set up here
+        // from the parameters, so evaluate only copies states. num_threads = 0 uses all the cores
+        RolloutEngine(const VehicleParam& v_params, const TMeasyParam& t_params, unsigned int num_threads = 0);
+
+        RolloutEngine(const RolloutEngine&) = delete;
+        RolloutEngine& operator=(const RolloutEngine&) = delete;
+
+        // Runs nCandidates control sequences from the state start. Candidate k applies
+        // controls[(k*horizon + h)*3 + c] (c - steering, throttle, braking) during interval h,
+        // which lasts hold model steps. costs[k] gets the sum of its stage costs and its terminal
+        // cost (either may be empty), and terminal_states[k], if it is not null, the state at the
+        // end. Candidates that have not started by the deadline are skipped and get an infinite
+        // cost, so that a late evaluation still returns in time with the candidates it managed.
+        // Returns the number of candidates evaluated. Running a candidate does not allocate,
+        // only handing the chunks of candidates to the threads does
+        int evaluate(const SimulatorSnapshot& start, const double* controls, int nCandidates, int horizon, int hold,
+                        const RolloutStageCost& stage, const RolloutTerminalCost& terminal, double* costs,
+                        SimulatorSnapshot* terminal_states = nullptr,
+                        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
+
+        unsigned int numThreads() const { return _pool.size(); }
+
+      private:
+        ThreadPool _pool;
+        std::vector<std::unique_ptr<Simulator>> _sims; // by ThreadPool::workerIndex
+    };
+}
+
+#endif
@@ -0,0 +1,131 @@
+#include <iostream>
+#include <vector>
+#include <stdint.h>
+#include <type_traits>
+#include "Simulator.h"
+#include "Eightdof_impl.h"
+#include "../utils.h"
+
+using namespace EightDOF;
+
+/*
+Code for the Simulator. step does exactly what the loop in test8DOF.cpp does (see stepT), but
+passes the steering angle, the throttle and the braking directly and keeps the forces in fixed
+arrays instead of creating new vectors every step
+*/
+
+void EightDOF::getControls(Controls& controls, const std::vector<Entry>& m_data, const double time){
+    double c[4];
+    ::getControls(c, m_data, time);
+    controls._time = c[0];
+    controls._steering = c[1];
+    controls._throttle = c[2];
+    controls._braking = c[3];
+}
+
+void EightDOF::getControls(Controls& controls, Driver_input& input, const double time){
+    double c[4];
+    input.getControls(c, time);
+    controls._time = c[0];
+    controls._steering = c[1];
+    controls._throttle = c[2];
+    controls._braking = c[3];
+}
+
+const char* const EightDOF::OUTPUT_NAMES[NUM_OUTPUTS] = {
+    "time", "x", "y", "u", "v", "phi", "psi", "wx", "wz", "wlf", "wrf", "wlr", "wrr",
+    "spl_tor", "current_gear", "engine_omega", "engine_torque",
+    "tc_inp_tor", "tc_out_tor", "tc_out_omg", "tc_sr"
+};
+
+int EightDOF::outputIndex(const std::string& name){
+    for(int i = 0; i < NUM_OUTPUTS; i++){
+        if(name == OUTPUT_NAMES[i]){
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+Simulator::Simulator()
+    : _stepFn(&Simulator::stepVariant<FEATURES_RUNTIME>), _time(0.) {
+    vehInvariants(_inv, _v_params);
+}
+
+Simulator::Simulator(const VehicleParam& v_params, const TMeasyParam& t_params)
+    : _stepFn(&Simulator::stepVariant<FEATURES_RUNTIME>), _time(0.) {
+    init(v_params, t_params);
+}
+
+void Simulator::init(const VehicleParam& v_params, const TMeasyParam& t_params){
+    _v_params = v_params;
+    _t_params = t_params;
+    mapsInit(_v_params);
+    tireInit(_t_params);
+    vehInvariants(_inv, _v_params);
+
+    // every combination of the flags is compiled as its own variant
+    switch(modelFeatures(_v_params)){
+        case 0: _stepFn = &Simulator::stepVariant<0>; break;
+        case 1: _stepFn = &Simulator::stepVariant<1>; break;
+        case 2: _stepFn = &Simulator::stepVariant<2>; break;
+        case 3: _stepFn = &Simulator::stepVariant<3>; break;
+        case 4: _stepFn = &Simulator::stepVariant<4>; break;
+        case 5: _stepFn = &Simulator::stepVariant<5>; break;
+        case 6: _stepFn = &Simulator::stepVariant<6>; break;
+        case 7: _stepFn = &Simulator::stepVariant<7>; break;
+        default: _stepFn = &Simulator::stepVariant<FEATURES_RUNTIME>; break;
+    }
+    reset();
+}
+
+void Simulator::reset(){
+    _v_states = VehicleState();
+    vehInit(_v_states, _v_params);
+    for(int i = 0; i < 4; i++){
+        _tires[i] = TMeasyState();
+    }
+    _time = 0.;
+}
+
+static_assert(std::is_trivially_copyable<SimulatorSnapshot>::value,
+              "SimulatorSnapshot has to stay plain data");
+
+void Simulator::snapshot(SimulatorSnapshot& s) const{
+    s._v_states = _v_states;
+    for(int i = 0; i < 4; i++){
+        s._tires[i] = _tires[i];
+    }
+    s._time = _time;
+    s._input_position = 0;
+}
+
+void Simulator::snapshot(SimulatorSnapshot& s, const Driver_input& input) const{
+    snapshot(s);
+    s._input_position = input.position();
+}
+
+void Simulator::restore(const SimulatorSnapshot& s){
+    _v_states = s._v_states;
+    for(int i = 0; i < 4; i++){
+        _tires[i] = s._tires[i];
+    }
+    _time = s._time;
+}
+
+void Simulator::restore(const SimulatorSnapshot& s, Driver_input& input){
+    restore(s);
+    input.setPosition(s._input_position);
+}
+
+template <int F>
+void Simulator::stepVariant(const Controls& controls){
+    stepT<F>(_v_states, _tires, _v_params, _t_params, _inv, controls._steering, controls._throttle, controls._braking,
+                controls._time);
+    _time = controls._time + _v_params._step;
+}
+
+double Simulator::getOutput(int channel) const{
+    return EightDOF::getOutput(channel, _time, _v_states, _tires);
+}
@@ -0,0 +1,151 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+#include <stdint.h>
+#include <vector>
+#include "../utils.h"
+#include "Eightdof.h"
+/*
+Header file for the Simulator - owns one vehicle, its four tires and all the scratch
+storage the 8 DOF functions need so that a time step does not touch the heap
+*/
+
+namespace EightDOF{
+
+    // Controls applied during one time step
+    struct Controls{
+        Controls() : _time(0.), _steering(0.), _throttle(0.), _braking(0.) {}
+
+        Controls(double time, double steering, double throttle, double braking)
+            : _time(time), _steering(steering), _throttle(throttle), _braking(braking) {}
+
+        double _time; // time at the start of the step
+        double _steering; // normalized steering input
+        double _throttle; // throttle [0,1]
+        double _braking; // braking [0,1]
+    };
+
+    // get the controls at a given time from the driver data - see getControls in utils.h
+    void getControls(Controls& controls, const std::vector<Entry>& m_data, const double time);
+
+    // same with a cursor over the driver data - for times that increase along a run
+    void getControls(Controls& controls, Driver_input& input, const double time);
+
+
+    // output channels of the simulator - the same names and order as the columns of the
+    // csv written by test8DOF
+    static const int NUM_OUTPUTS = 21;
+    extern const char* const OUTPUT_NAMES[NUM_OUTPUTS];
+
+    // index of the output channel with this name, -1 if there is none
+    int outputIndex(const std::string& name);
+
+    // value of an output channel for the given vehicle and the 4 tire states
+    template <typename T>
+    T getOutput(int channel, double time, const VehicleStateT<T>& v_states, const TMeasyStateT<T>* tires){
+        switch(channel){
+            case 0: return time;
+            case 1: return v_states._x;
+            case 2: return v_states._y;
+            case 3: return v_states._u;
+            case 4: return v_states._v;
+            case 5: return v_states._phi;
+            case 6: return v_states._psi;
+            case 7: return v_states._wx;
+            case 8: return v_states._wz;
+            case 9: return tires[0]._omega;
+            case 10: return tires[1]._omega;
+            case 11: return tires[2]._omega;
+            case 12: return tires[3]._omega;
+            case 13: return v_states._tor/4.;
+            case 14: return v_states._current_gr+1;
+            case 15: return v_states._crankOmega;
+            case 16: return v_states._debugtor;
+            case 17: return v_states._tc_inp_tor;
+            case 18: return v_states._tc_out_tor;
+            case 19: return v_states._tc_out_omg;
+            case 20: return v_states._sr;
+            default: return 0.;
+        }
+    }
+
+
+    // The complete state of a Simulator - the vehicle (with the gear and the crank speed), the 4
+    // tires, the time and the position of the driver inputs. It is plain data, so saving or
+    // restoring it is a copy of a few hundred bytes, and it can be written to a file as it is
+    // (read back by the same build). The parameters are not part of it
+    struct SimulatorSnapshot{
+        VehicleState _v_states;
+        TMeasyState _tires[4];
+        double _time;
+        uint64_t _input_position; // Driver_input::position, 0 if there was no Driver_input
+    };
+
+
+    class Simulator{
+      public:
+        Simulator();
+
+        // copies the parameters and initializes the states - tireInit is called on the
+        // copy of the tire parameters
+        Simulator(const VehicleParam& v_params, const TMeasyParam& t_params);
+
+        // same as the constructor. Also computes the parameter invariants and picks the variant of
+        // the model for the feature flags of the vehicle (see FEATURE_TC in Eightdof.h), so init
+        // has to be called again after the parameters are changed
+        void init(const VehicleParam& v_params, const TMeasyParam& t_params);
+
+        // puts the vehicle back at rest at the origin
+        void reset();
+
+        // Saves the state into s, along with the position of the driver inputs if they are given.
+        // restore continues from a saved state - the Simulator has to have the parameters of the
+        // one that was saved. A Simulator can also be copied, the copy continues from the same
+        // state as the original. To branch many futures from one state, make the copies once
+        // and restore the snapshot into them for every branch. None of these allocate
+        void snapshot(SimulatorSnapshot& s) const;
+        void snapshot(SimulatorSnapshot& s, const Driver_input& input) const;
+        void restore(const SimulatorSnapshot& s);
+        void restore(const SimulatorSnapshot& s, Driver_input& input);
+
+        // advance the vehicle and the 4 tires by one vehicle time step
+        // No heap allocations happen in here
+        void step(const Controls& controls){
+            (this->*_stepFn)(controls);
+        }
+
+        // time at the end of the last step
+        double getTime() const { return _time; }
+
+        VehicleState& getVehicleState() { return _v_states; }
+        const VehicleState& getVehicleState() const { return _v_states; }
+
+        // tires are numbered 0 - left front, 1 - right front, 2 - left rear, 3 - right rear
+        TMeasyState& getTireState(int i) { return _tires[i]; }
+        const TMeasyState& getTireState(int i) const { return _tires[i]; }
+
+        // value of one of the output channels (see OUTPUT_NAMES) after the last step
+        double getOutput(int channel) const;
+
+        VehicleParam& getVehicleParam() { return _v_params; }
+        const VehicleParam& getVehicleParam() const { return _v_params; }
+        TMeasyParam& getTireParam() { return _t_params; }
+        const TMeasyParam& getTireParam() const { return _t_params; }
+
+      private:
+        // step of the model variant with the feature flags F
+        template <int F>
+        void stepVariant(const Controls& controls);
+
+        VehicleParam _v_params;
+        TMeasyParam _t_params;
+        VehicleInvariants _inv; // parameter invariants of the chassis equations
+        void (Simulator::*_stepFn)(const Controls&); // stepVariant for the flags of the vehicle
+
+        VehicleState _v_states;
+        TMeasyState _tires[4];
+
+        double _time;
+    };
+}
+
+#endif
@@ -0,0 +1,263 @@
+#include <algorithm>
+#include <cmath>
+#include "Sobol.h"
+#include "Simulator.h"
+#include "ThreadPool.h"
+
+using namespace EightDOF;
+
+/*
+Code for the sensitivity analysis. A block of samples is drawn from the sequence, its model runs
+are spread over the threads into a buffer of block * (numGroups + 2) values per quantity, and the
+buffer is added to the sums in sample order. The buffer is the only memory that depends on the
+design, and it does not grow with the number of samples
+*/
+
+// direction numbers of dimensions 2 .. 40 (new-joe-kuo-6.21201) - degree s and coefficients a of
+// the primitive polynomial, then the s initial numbers m
+struct SobolDirections{
+    int _s;
+    int _a;
+    uint32_t _m[8];
+};
+
+static const SobolDirections SOBOL_DIRECTIONS[SobolSequence::MAX_DIMS - 1] = {
+    {1, 0, {1}},
+    {2, 1, {1, 3}},
+    {3, 1, {1, 3, 1}},
+    {3, 2, {1, 1, 1}},
+    {4, 1, {1, 1, 3, 3}},
+    {4, 4, {1, 3, 5, 13}},
+    {5, 2, {1, 1, 5, 5, 17}},
+    {5, 4, {1, 1, 5, 5, 5}},
+    {5, 7, {1, 1, 7, 11, 19}},
+    {5, 11, {1, 1, 5, 1, 1}},
+    {5, 13, {1, 1, 1, 3, 11}},
+    {5, 14, {1, 3, 5, 5, 31}},
+    {6, 1, {1, 3, 3, 9, 7, 49}},
+    {6, 13, {1, 1, 1, 15, 21, 21}},
+    {6, 16, {1, 3, 1, 13, 27, 49}},
+    {6, 19, {1, 1, 1, 15, 7, 5}},
+    {6, 22, {1, 3, 1, 15, 13, 25}},
+    {6, 25, {1, 1, 5, 5, 19, 61}},
+    {7, 1, {1, 3, 7, 11, 23, 15, 103}},
+    {7, 4, {1, 3, 7, 13, 13, 15, 69}},
+    {7, 7, {1, 1, 3, 13, 7, 35, 63}},
+    {7, 8, {1, 3, 5, 9, 1, 25, 53}},
+    {7, 14, {1, 3, 1, 13, 9, 35, 107}},
+    {7, 19, {1, 3, 1, 5, 27, 61, 31}},
+    {7, 21, {1, 1, 5, 11, 19, 41, 61}},
+    {7, 28, {1, 3, 5, 3, 3, 13, 69}},
+    {7, 31, {1, 1, 7, 13, 1, 19, 1}},
+    {7, 32, {1, 3, 7, 5, 13, 19, 59}},
+    {7, 37, {1, 1, 3, 9, 25, 29, 41}},
+    {7, 41, {1, 3, 5, 13, 23, 1, 55}},
+    {7, 42, {1, 3, 7, 3, 13, 59, 17}},
+    {7, 50, {1, 3, 1, 3, 5, 53, 69}},
+    {7, 55, {1, 1, 5, 5, 23, 33, 13}},
+    {7, 56, {1, 1, 7, 7, 1, 61, 123}},
+    {7, 59, {1, 1, 7, 9, 13, 61, 49}},
+    {7, 62, {1, 3, 3, 5, 3, 55, 33}},
+    {8, 14, {1, 3, 1, 15, 31, 13, 49, 245}},
+    {8, 21, {1, 3, 5, 15, 31, 59, 63, 97}},
+    {8, 22, {1, 3, 1, 11, 11, 11, 77, 249}}
+};
+
+SobolSequence::SobolSequence(int dims) : _dims(std::min(dims, int(MAX_DIMS))), _index(0), _v(_dims * 32), _x(_dims, 0){
+    for(int b = 0; b < 32; b++){
+        _v[b] = uint32_t(1) << (31 - b);
+    }
+    for(int d = 1; d < _dims; d++){
+        const SobolDirections& dir = SOBOL_DIRECTIONS[d - 1];
+        uint32_t* v = &_v[d * 32];
+        int s = dir._s;
+        for(int b = 0; b < 32; b++){
+            if(b < s){
+                v[b] = dir._m[b] << (31 - b);
+                continue;
+            }
+            v[b] = v[b - s] ^ (v[b - s] >> s);
+            for(int k = 1; k < s; k++){
+                if((dir._a >> (s - 1 - k)) & 1){
+                    v[b] ^= v[b - k];
+                }
+            }
+        }
+    }
+}
+
+void SobolSequence::next(double* x){
+    // the lowest zero bit of the index picks the direction numbers
+    int c = 0;
+    while((_index >> c) & 1){
+        c++;
+    }
+    _index++;
+    for(int d = 0; d < _dims; d++){
+        _x[d] ^= _v[d * 32 + c];
+        x[d] = _x[d] * (1. / 4294967296.);
+    }
+}
+
+
+bool EightDOF::parseSensitivityQuantity(SensitivityQuantity& q, const std::string& spec){
+    static const char* const STATS[] = {"final", "mean", "min", "max", "rms"};
+    size_t colon = spec.find(':');
+    if(colon == std::string::npos){
+        return false;
+    }
+    q._name = spec;
+    q._output = outputIndex(spec.substr(0, colon));
+    std::string stat = spec.substr(colon + 1);
+    for(int s = 0; s < 5; s++){
+        if(stat == STATS[s]){
+            q._stat = SensitivityStat(s);
+            return q._output >= 0;
+        }
+    }
+    return false;
+}
+
+
+SobolAccumulator::SobolAccumulator(int dims)
+    : _dims(dims), _n(0), _mean(0.), _m2(0.), _shift(0.), _first(dims, 0.), _diff(dims, 0.), _total(dims, 0.) {}
+
+void SobolAccumulator::add(double fA, double fB, const double* fAB){
+    if(_n == 0){
+        _shift = fA;
+    }
+    _n++;
+    // Welford update with the two values of the sample
+    long k = 2 * _n - 1;
+    double delta = fA - _mean;
+    _mean += delta / k;
+    _m2 += delta * (fA - _mean);
+    delta = fB - _mean;
+    _mean += delta / (k + 1);
+    _m2 += delta * (fB - _mean);
+
+    for(int i = 0; i < _dims; i++){
+        _first[i] += (fB - _shift) * (fAB[i] - fA);
+        _diff[i] += fAB[i] - fA;
+        _total[i] += (fA - fAB[i]) * (fA - fAB[i]);
+    }
+}
+
+double SobolAccumulator::variance() const{
+    return _n > 0 ? _m2 / (2 * _n) : 0.;
+}
+
+double SobolAccumulator::first(int i) const{
+    double var = variance();
+    // fB centered on the mean of all the values, which leaves the expectation as it is (the
+    // differences have mean 0) and keeps a large mean from drowning the index in noise
+    return var > 0. ? (_first[i] - (_mean - _shift) * _diff[i]) / _n / var : 0.;
+}
+
+double SobolAccumulator::total(int i) const{
+    double var = variance();
+    return var > 0. ? _total[i] / (2. * _n) / var : 0.;
+}
+
+
+// runs the model once with the multipliers theta and writes the quantities to out
+static void runQuantities(double* out, const VehicleParam& v_params, const TMeasyParam& t_params,
+                            const std::vector<Entry>& driverData, double endTime, const ParamGroups& groups,
+                            const double* theta, const std::vector<SensitivityQuantity>& quantities){
+    VehicleParam veh_param = v_params;
+    TMeasyParam tire_param = t_params;
+    scaleParams(veh_param, tire_param, groups, theta);
+
+    Simulator sim(veh_param, tire_param);
+    Driver_input input(driverData);
+    Controls controls;
+    size_t nQ = quantities.size();
+    std::vector<double> sum(nQ, 0.), lo(nQ, INFINITY), hi(nQ, -INFINITY);
+    double step = veh_param._step;
+    double t = 0;
+    long steps = 0;
+    while(t < (endTime - step/10)){
+        getControls(controls, input, t);
+        sim.step(controls);
+        t += step;
+        steps++;
+
+        for(size_t q = 0; q < nQ; q++){
+            double v = sim.getOutput(quantities[q]._output);
+            switch(quantities[q]._stat){
+                case SENS_MEAN: sum[q] += v; break;
+                case SENS_RMS: sum[q] += v * v; break;
+                case SENS_MIN: lo[q] = std::min(lo[q], v); break;
+                case SENS_MAX: hi[q] = std::max(hi[q], v); break;
+                default: break;
+            }
+        }
+    }
+    for(size_t q = 0; q < nQ; q++){
+        switch(quantities[q]._stat){
+            case SENS_FINAL: out[q] = sim.getOutput(quantities[q]._output); break;
+            case SENS_MEAN: out[q] = sum[q] / steps; break;
+            case SENS_RMS: out[q] = std::sqrt(sum[q] / steps); break;
+            case SENS_MIN: out[q] = lo[q]; break;
+            case SENS_MAX: out[q] = hi[q]; break;
+        }
+    }
+}
+
+bool EightDOF::sobolIndices(std::vector<SobolAccumulator>& acc, const VehicleParam& v_params, const TMeasyParam& t_params,
+                            const std::vector<Entry>& driverData, double endTime, const ParamGroups& groups,
+                            const double* lower, const double* upper, const std::vector<SensitivityQuantity>& quantities,
+                            long nSamples, int block, unsigned int num_threads){
+    int d = groups._names.size();
+    if(2 * d > SobolSequence::MAX_DIMS){
+        return false;
+    }
+    size_t nQ = quantities.size();
+    acc.assign(nQ, SobolAccumulator(d));
+    block = std::max(block, 1);
+    int runs = d + 2; // A, B and A with every column of B
+
+    SobolSequence seq(2 * d);
+    std::vector<double> points(size_t(block) * 2 * d);
+    std::vector<double> values(size_t(block) * runs * nQ);
+    std::vector<double> fAB(d);
+    ThreadPool pool(num_threads);
+
+    for(long first = 0; first < nSamples; first += block){
+        int n = std::min(long(block), nSamples - first);
+        // columns 0 .. d-1 of a point are A, d .. 2d-1 are B, both scaled to the multipliers
+        for(int j = 0; j < n; j++){
+            double* p = &points[size_t(j) * 2 * d];
+            seq.next(p);
+            for(int i = 0; i < 2 * d; i++){
+                int g = i % d;
+                p[i] = lower[g] + p[i] * (upper[g] - lower[g]);
+            }
+        }
+
+        pool.parallelFor(size_t(n) * runs, 1, [&](size_t r){
+            size_t j = r / runs;
+            int which = r % runs;
+            const double* a = &points[j * 2 * d];
+            std::vector<double> theta(a, a + d);
+            if(which == 1){
+                std::copy(a + d, a + 2 * d, theta.begin());
+            }
+            else if(which >= 2){
+                theta[which - 2] = a[d + which - 2];
+            }
+            runQuantities(&values[r * nQ], v_params, t_params, driverData, endTime, groups, theta.data(), quantities);
+        });
+
+        for(int j = 0; j < n; j++){
+            const double* f = &values[size_t(j) * runs * nQ];
+            for(size_t q = 0; q < nQ; q++){
+                for(int i = 0; i < d; i++){
+                    fAB[i] = f[(2 + i) * nQ + q];
+                }
+                acc[q].add(f[q], f[nQ + q], fAB.data());
+            }
+        }
+    }
+    return true;
+}
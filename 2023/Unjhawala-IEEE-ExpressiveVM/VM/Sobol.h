@@ -0,0 +1,89 @@
+#ifndef SOBOL_H
+#define SOBOL_H
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "../utils.h"
+#include "Eightdof.h"
+#include "Batch.h"
+/*
+Header file for the global sensitivity analysis of the 8 DOF model - first order and total Sobol
+indices of scalar quantities of a run with respect to parameter multipliers. The samples follow
+the Saltelli design on a Sobol sequence and the estimators are running sums, so the memory does
+not grow with the number of samples
+*/
+
+namespace EightDOF{
+
+    // Sobol low discrepancy sequence (direction numbers of Joe and Kuo) in up to MAX_DIMS dimensions,
+    // generated in gray code order. The first point (all zeros) is skipped
+    class SobolSequence{
+      public:
+        static const int MAX_DIMS = 40;
+
+        explicit SobolSequence(int dims);
+
+        // writes the next point, in [0, 1)^dims, to x
+        void next(double* x);
+
+        int dims() const { return _dims; }
+
+      private:
+        int _dims;
+        uint64_t _index;
+        std::vector<uint32_t> _v; // direction numbers, _v[d*32 + bit]
+        std::vector<uint32_t> _x;
+    };
+
+    // statistic of an output channel over a run
+    enum SensitivityStat{ SENS_FINAL, SENS_MEAN, SENS_MIN, SENS_MAX, SENS_RMS };
+
+    // a quantity of interest, written as "output:stat", e.g. "u:final", "psi:rms" (see OUTPUT_NAMES
+    // in Simulator.h, the stats are final, mean, min, max and rms)
+    struct SensitivityQuantity{
+        std::string _name;
+        int _output;
+        SensitivityStat _stat;
+    };
+
+    // false if the output or the statistic is unknown
+    bool parseSensitivityQuantity(SensitivityQuantity& q, const std::string& spec);
+
+    // Running sums of the Saltelli estimators of one quantity - for every sample the value at the
+    // point A, at the point B and at A with column i taken from B (fAB[i]). The first order index is
+    // the estimator of Saltelli et al. (2010), the total index the one of Jansen
+    class SobolAccumulator{
+      public:
+        explicit SobolAccumulator(int dims = 0);
+
+        void add(double fA, double fB, const double* fAB);
+
+        long count() const { return _n; }
+        double mean() const { return _mean; }
+        double variance() const; // of all the values at A and at B
+        double first(int i) const;
+        double total(int i) const;
+
+      private:
+        int _dims;
+        long _n;
+        double _mean, _m2; // Welford over fA and fB
+        double _shift; // fA of the first sample, subtracted from fB in _first
+        std::vector<double> _first; // sums of (fB - _shift)*(fAB[i] - fA)
+        std::vector<double> _diff; // sums of fAB[i] - fA
+        std::vector<double> _total; // sums of (fA - fAB[i])^2
+    };
+
+    // Sobol indices of quantities over runs of driverData up to endTime, with the multiplier of
+    // group i (see ParamGroups in Batch.h) between lower[i] and upper[i]. Every sample runs the
+    // model numGroups + 2 times. The samples are evaluated in blocks of block samples on
+    // num_threads threads (0 - all the cores) and added to acc (one per quantity, reset here) in
+    // order, so the result does not depend on the number of threads. Returns false if there are
+    // more than SobolSequence::MAX_DIMS/2 groups
+    bool sobolIndices(std::vector<SobolAccumulator>& acc, const VehicleParam& v_params, const TMeasyParam& t_params,
+                        const std::vector<Entry>& driverData, double endTime, const ParamGroups& groups,
+                        const double* lower, const double* upper, const std::vector<SensitivityQuantity>& quantities,
+                        long nSamples, int block, unsigned int num_threads);
+}
+
+#endif
@@ -0,0 +1,164 @@
+#include <algorithm>
+#include "ThreadPool.h"
+
+using namespace EightDOF;
+
+/*
+Code for the work stealing thread pool. Each worker owns a queue guarded by its own mutex
+so workers only meet on the pool mutex when they have nothing left to do
+*/
+
+// pool the calling thread belongs to and its index in it
+static thread_local const ThreadPool* tl_pool = nullptr;
+static thread_local unsigned int tl_index = 0;
+
+ThreadPool::ThreadPool(unsigned int num_threads) : _queued(0), _pending(0), _next(0), _stop(false) {
+    if(num_threads == 0){
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    // one extra queue for tasks submitted from outside the pool
+    for(unsigned int i = 0; i <= num_threads; i++){
+        _queues.emplace_back(new Queue());
+    }
+    for(unsigned int i = 0; i < num_threads; i++){
+        _threads.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool(){
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(_m);
+        _stop = true;
+    }
+    _cv_work.notify_all();
+    for(auto& t : _threads){
+        t.join();
+    }
+}
+
+int ThreadPool::workerIndex() const{
+    return (tl_pool == this) ? tl_index : size();
+}
+
+void ThreadPool::submit(std::function<void()> task){
+    unsigned int q;
+    if(tl_pool == this){
+        q = tl_index;
+    }
+    else{
+        q = _next.fetch_add(1, std::memory_order_relaxed) % _queues.size();
+    }
+
+    _pending.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(_queues[q]->_m);
+        _queues[q]->_tasks.push_back(std::move(task));
+    }
+    {
+        // under the pool mutex so that a worker going to sleep cannot miss it
+        std::lock_guard<std::mutex> lock(_m);
+        _queued.fetch_add(1);
+    }
+    _cv_work.notify_one();
+}
+
+bool ThreadPool::popTask(unsigned int me, std::function<void()>& task){
+    unsigned int n = _queues.size();
+    // own queue - newest first since its data is most likely still in cache
+    if(me < n){
+        Queue& own = *_queues[me];
+        std::lock_guard<std::mutex> lock(own._m);
+        if(!own._tasks.empty()){
+            task = std::move(own._tasks.back());
+            own._tasks.pop_back();
+            _queued.fetch_sub(1);
+            return true;
+        }
+    }
+    // steal the oldest task of someone else
+    for(unsigned int k = 1; k <= n; k++){
+        Queue& other = *_queues[(me + k) % n];
+        std::lock_guard<std::mutex> lock(other._m);
+        if(!other._tasks.empty()){
+            task = std::move(other._tasks.front());
+            other._tasks.pop_front();
+            _queued.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::runTask(std::function<void()>& task){
+    task();
+    task = nullptr;
+    if(_pending.fetch_sub(1) == 1){
+        std::lock_guard<std::mutex> lock(_m);
+        _cv_done.notify_all();
+    }
+}
+
+void ThreadPool::workerLoop(unsigned int me){
+    tl_pool = this;
+    tl_index = me;
+
+    std::function<void()> task;
+    while(true){
+        if(popTask(me, task)){
+            runTask(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(_m);
+        _cv_work.wait(lock, [this]{ return _stop || _queued.load() > 0; });
+        if(_stop && _queued.load() == 0){
+            return;
+        }
+    }
+}
+
+void ThreadPool::wait(){
+    // help with the queued work instead of just sleeping
+    unsigned int me = (tl_pool == this) ? tl_index : _queues.size() - 1;
+    std::function<void()> task;
+    while(_pending.load() > 0){
+        if(popTask(me, task)){
+            runTask(task);
+            continue;
+        }
+        // everything left is running on the workers
+        std::unique_lock<std::mutex> lock(_m);
+        _cv_done.wait(lock, [this]{ return _pending.load() == 0 || _queued.load() > 0; });
+    }
+}
+
+void ThreadPool::parallelFor(size_t n, size_t grain, const std::function<void(size_t)>& fn){
+    if(grain == 0){
+        grain = 1;
+    }
+    // counts only the chunks of this call so it can be used from inside a task as well
+    std::atomic<size_t> left((n + grain - 1) / grain);
+    for(size_t begin = 0; begin < n; begin += grain){
+        size_t end = std::min(n, begin + grain);
+        submit([this, &fn, &left, begin, end]{
+            for(size_t i = begin; i < end; i++){
+                fn(i);
+            }
+            if(left.fetch_sub(1) == 1){
+                std::lock_guard<std::mutex> lock(_m);
+                _cv_done.notify_all();
+            }
+        });
+    }
+
+    unsigned int me = (tl_pool == this) ? tl_index : _queues.size() - 1;
+    std::function<void()> task;
+    while(left.load() > 0){
+        if(popTask(me, task)){
+            runTask(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(_m);
+        _cv_done.wait(lock, [this, &left]{ return left.load() == 0 || _queued.load() > 0; });
+    }
+}
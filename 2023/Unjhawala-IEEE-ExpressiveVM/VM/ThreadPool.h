@@ -0,0 +1,71 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+/*
+Header file for a small work stealing thread pool. Every worker has its own queue and
+takes the most recently added task from it. A worker with an empty queue steals the oldest
+task of the other queues. Used to spread whole simulations (or chunks of them) over the cores
+*/
+
+namespace EightDOF{
+
+    class ThreadPool{
+      public:
+        // num_threads = 0 uses all the hardware threads
+        explicit ThreadPool(unsigned int num_threads = 0);
+
+        // waits for the queued tasks and joins the workers
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        // add a task - tasks submitted from a worker go to the queue of that worker
+        void submit(std::function<void()> task);
+
+        // blocks until all the submitted tasks are done. The calling thread runs
+        // queued tasks while it waits. Not to be called from inside a task
+        void wait();
+
+        // runs fn(i) for i in [0,n) split into chunks of grain and waits for those chunks
+        // only - fine to call from inside a task
+        void parallelFor(size_t n, size_t grain, const std::function<void(size_t)>& fn);
+
+        unsigned int size() const { return _threads.size(); }
+
+        // index of the worker running the calling thread, size() for any other thread
+        // (the waiting thread of wait() included) - handy for per thread scratch storage
+        int workerIndex() const;
+
+      private:
+        struct Queue{
+            std::mutex _m;
+            std::deque<std::function<void()>> _tasks;
+        };
+
+        // own queue from the back, else steal from the front of the others
+        bool popTask(unsigned int me, std::function<void()>& task);
+        void runTask(std::function<void()>& task);
+        void workerLoop(unsigned int me);
+
+        std::vector<std::unique_ptr<Queue>> _queues;
+        std::vector<std::thread> _threads;
+
+        std::mutex _m;
+        std::condition_variable _cv_work; // signalled when a task is queued
+        std::condition_variable _cv_done; // signalled when the last pending task is done
+        std::atomic<long> _queued; // tasks in the queues
+        std::atomic<long> _pending; // tasks submitted and not finished yet
+        std::atomic<unsigned int> _next; // round robin queue for tasks from outside the pool
+        bool _stop;
+    };
+}
+
+#endif
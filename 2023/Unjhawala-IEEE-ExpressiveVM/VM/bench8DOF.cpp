@@ -0,0 +1,407 @@
+#include <iostream>
+#include <fstream>
+#include <stdint.h>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include "../utils.h"
+#include "Eightdof.h"
+#include "Simulator.h"
+#include "Ensemble.h"
+#include "Eightdof_impl.h"
+
+using std::chrono::steady_clock;
+using std::chrono::duration;
+using namespace EightDOF;
+
+/*
+Micro benchmarks of the hot functions of the 8 DOF model. For every vehicle and driver input,
+one simulation is first run with the free functions (like test8DOF) and the inputs of every
+call are recorded. Each function is then timed replaying those recorded calls, so the branches
+taken are the ones of a real run. A full step is timed with the Simulator, with the free
+functions in double and in float (step_free_double, step_free_float) and per vehicle in an
+Ensemble (step_ensemble). tmxy_combined_lanes is tmxy_combined_select on the SIMD lanes of
+Lanes.h, as tireAdv4 runs it in an Ensemble, timed per tire.
+
+The results are written as csv (to stdout or to the file given) with the columns
+    vehicle,input,benchmark,calls,ns_per_call
+where ns_per_call is the best of the repeats. The "copy_*" rows are the cost of restoring the
+recorded states before each call, which is included in the rows of the functions that modify
+their arguments (tireAdv, tireAdv4, evalPowertrain, vehAdv).
+
+Run from the VM directory
+Usage : ./bench8DOF [results.csv] [repeats]
+*/
+
+// keeps the results alive so the compiler cannot drop the calls
+static volatile double sink;
+
+struct Vehicle{
+    const char* _name;
+    const char* _vehJSON;
+    const char* _tireJSON;
+};
+
+struct Result{
+    std::string _vehicle, _input, _bench;
+    size_t _calls;
+    double _ns;
+};
+
+// inputs of all the calls in one simulation
+struct Recording{
+    std::vector<double> _times;
+    std::vector<std::vector<double>> _controls; // front controls, the rear tires get steering 0
+    std::vector<VehicleState> _veh; // before the tires are advanced
+    std::vector<TMeasyState> _tiresBefore; // 4 per step, before tireAdv
+    std::vector<TMeasyState> _tiresPT; // 4 per step, before evalPowertrain
+    std::vector<VehicleState> _vehPT;
+    std::vector<VehicleState> _vehAdv; // before vehAdv
+    std::vector<double> _fx, _fy, _huf, _hur; // 4 forces per step for vehAdv
+};
+
+
+void record(Recording& rec, const VehicleParam& v_params, const TMeasyParam& t_params,
+            const std::vector<Entry>& driverData, double endTime){
+    VehicleState veh_st;
+    vehInit(veh_st, v_params);
+    TMeasyState tires[4];
+    std::vector<double> controls(4, 0.);
+    std::vector<double> fx(4), fy(4);
+    double step = v_params._step;
+
+    double t = 0;
+    while(t < (endTime - step/10)){
+        getControls(controls, driverData, t);
+        rec._times.push_back(t);
+        rec._controls.push_back(controls);
+
+        vehToTireTransform(tires[0], tires[1], tires[2], tires[3], veh_st, v_params, controls);
+        rec._veh.push_back(veh_st);
+        rec._tiresBefore.insert(rec._tiresBefore.end(), tires, tires + 4);
+
+        std::vector<double> mod_controls = {controls[0], 0, controls[2], controls[3]};
+        tireAdv(tires[0], t_params, veh_st, v_params, controls);
+        tireAdv(tires[1], t_params, veh_st, v_params, controls);
+        tireAdv(tires[2], t_params, veh_st, v_params, mod_controls);
+        tireAdv(tires[3], t_params, veh_st, v_params, mod_controls);
+
+        rec._vehPT.push_back(veh_st);
+        rec._tiresPT.insert(rec._tiresPT.end(), tires, tires + 4);
+        evalPowertrain(veh_st, tires[0], tires[1], tires[2], tires[3], v_params, t_params, controls);
+
+        tireToVehTransform(tires[0], tires[1], tires[2], tires[3], veh_st, v_params, controls);
+        for(int i = 0; i < 4; i++){
+            fx[i] = tires[i]._fx;
+            fy[i] = tires[i]._fy;
+        }
+        rec._vehAdv.push_back(veh_st);
+        rec._fx.insert(rec._fx.end(), fx.begin(), fx.end());
+        rec._fy.insert(rec._fy.end(), fy.begin(), fy.end());
+        rec._huf.push_back(tires[0]._rStat);
+        rec._hur.push_back(tires[3]._rStat);
+        vehAdv(veh_st, v_params, fx, fy, tires[0]._rStat, tires[3]._rStat);
+
+        t += step;
+    }
+}
+
+// n steps of the free functions with scalar type T, like the loop of test8DOF
+template <typename T>
+T freeSteps(const VehicleParamT<T>& v_params, const TMeasyParamT<T>& t_params, const std::vector<Entry>& driverData,
+            const std::vector<double>& times){
+    VehicleStateT<T> veh_st;
+    vehInit(veh_st, v_params);
+    TMeasyStateT<T> tires[4];
+    std::vector<double> controls(4, 0.), mod_controls(4, 0.);
+    std::vector<T> fx(4), fy(4);
+    for(double t : times){
+        getControls(controls, driverData, t);
+        mod_controls = controls;
+        mod_controls[1] = 0;
+        vehToTireTransform(tires[0], tires[1], tires[2], tires[3], veh_st, v_params, controls);
+        tireAdv(tires[0], t_params, veh_st, v_params, controls);
+        tireAdv(tires[1], t_params, veh_st, v_params, controls);
+        tireAdv(tires[2], t_params, veh_st, v_params, mod_controls);
+        tireAdv(tires[3], t_params, veh_st, v_params, mod_controls);
+        evalPowertrain(veh_st, tires[0], tires[1], tires[2], tires[3], v_params, t_params, controls);
+        tireToVehTransform(tires[0], tires[1], tires[2], tires[3], veh_st, v_params, controls);
+        for(int i = 0; i < 4; i++){
+            fx[i] = tires[i]._fx;
+            fy[i] = tires[i]._fy;
+        }
+        vehAdv(veh_st, v_params, fx, fy, tires[0]._rStat, tires[3]._rStat);
+    }
+    return veh_st._u;
+}
+
+// best time per call in ns of fn (which makes calls calls) over repeats runs
+template <typename Fn>
+double timeIt(Fn fn, size_t calls, int repeats){
+    double best = 1e300;
+    for(int r = 0; r < repeats; r++){
+        steady_clock::time_point start = steady_clock::now();
+        fn();
+        duration<double, std::nano> d = steady_clock::now() - start;
+        best = std::min(best, d.count() / calls);
+    }
+    return best;
+}
+
+
+void benchVehicle(std::vector<Result>& results, const Vehicle& vehicle, const std::string& input, int repeats){
+    VehicleParam v_params;
+    TMeasyParam t_params;
+    std::vector<Entry> driverData;
+    setVehParamsJSON(v_params, vehicle._vehJSON);
+    setTireParamsJSON(t_params, vehicle._tireJSON);
+    tireInit(t_params);
+    driverInput(driverData, input);
+    if(driverData.empty()){
+        std::cerr<<"No driver inputs read from "<<input<<"\n";
+        return;
+    }
+    v_params._step = 0.001;
+    t_params._step = 0.001;
+    double endTime = driverData.back().m_time;
+
+    Recording rec;
+    record(rec, v_params, t_params, driverData, endTime);
+    size_t n = rec._times.size();
+
+    auto add = [&](const std::string& bench, size_t calls, double ns){
+        results.push_back({vehicle._name, input, bench, calls, ns});
+    };
+
+    // getControls at the time of every step
+    std::vector<double> controls(4, 0.);
+    add("getControls", n, timeIt([&]{
+        double s = 0;
+        for(size_t i = 0; i < n; i++){
+            getControls(controls, driverData, rec._times[i]);
+            s += controls[2];
+        }
+        sink = s;
+    }, n, repeats));
+
+    // the same lookups with the cursor of Driver_input
+    add("getControls_cursor", n, timeIt([&]{
+        Driver_input cursor(driverData);
+        double s = 0;
+        for(size_t i = 0; i < n; i++){
+            cursor.getControls(controls, rec._times[i]);
+            s += controls[2];
+        }
+        sink = s;
+    }, n, repeats));
+
+    // tmxy_combined over combined slips from 0 to twice the sliding slip - all three branches
+    // of the force characteristic - with the longitudinal characteristic at the nominal load
+    {
+        const size_t m = 4096;
+        std::vector<double> slips(m);
+        double ss = t_params._sxsPn;
+        for(size_t i = 0; i < m; i++){
+            slips[(i * 2654435761u) % m] = 2. * ss * i / (m - 1); // scrambled so the branches do not predict
+        }
+        add("tmxy_combined", m, timeIt([&]{
+            double s = 0, f, fos;
+            for(size_t i = 0; i < m; i++){
+                tmxy_combined(f, fos, slips[i], t_params._dfx0Pn, t_params._sxmPn, t_params._fxmPn,
+                                t_params._sxsPn, t_params._fxsPn);
+                s += f + fos;
+            }
+            sink = s;
+        }, m, repeats));
+        add("tmxy_combined_select", m, timeIt([&]{
+            double s = 0, f, fos, dfds;
+            for(size_t i = 0; i < m; i++){
+                tmxy_combined_select(f, fos, dfds, slips[i], t_params._dfx0Pn, t_params._sxmPn, t_params._fxmPn,
+                                        t_params._sxsPn, t_params._fxsPn);
+                s += f + fos;
+            }
+            sink = s;
+        }, m, repeats));
+        // NATIVE_LANES tires per call
+        typedef Lanes<NATIVE_LANES> L;
+        add("tmxy_combined_lanes", m, timeIt([&]{
+            L s(0.), f, fos, dfds, slip;
+            for(size_t i = 0; i + NATIVE_LANES <= m; i += NATIVE_LANES){
+                std::memcpy(&slip._v, &slips[i], sizeof(slip._v));
+                tmxy_combined_select(f, fos, dfds, slip, L(t_params._dfx0Pn), L(t_params._sxmPn), L(t_params._fxmPn),
+                                        L(t_params._sxsPn), L(t_params._fxsPn));
+                s += f + fos;
+            }
+            sink = primal(s);
+        }, m, repeats));
+    }
+
+    // tireAdv on the recorded tire states
+    TMeasyState tire;
+    add("copy_tire", 4*n, timeIt([&]{
+        double s = 0;
+        for(size_t i = 0; i < 4*n; i++){
+            tire = rec._tiresBefore[i];
+            s += tire._xe;
+        }
+        sink = s;
+    }, 4*n, repeats));
+    std::vector<std::vector<double>> rear_controls(n);
+    for(size_t i = 0; i < n; i++){
+        rear_controls[i] = {rec._controls[i][0], 0, rec._controls[i][2], rec._controls[i][3]};
+    }
+    add("tireAdv", 4*n, timeIt([&]{
+        double s = 0;
+        for(size_t i = 0; i < 4*n; i++){
+            tire = rec._tiresBefore[i];
+            const std::vector<double>& c = ((i & 3) < 2) ? rec._controls[i/4] : rear_controls[i/4];
+            tireAdv(tire, t_params, rec._veh[i/4], v_params, c);
+            s += tire._fx;
+        }
+        sink = s;
+    }, 4*n, repeats));
+    // the 4 tires of a step at once - compare with 4 times tireAdv
+    TMeasyState corners[4];
+    add("tireAdv4", n, timeIt([&]{
+        double s = 0;
+        double delta[4];
+        for(size_t i = 0; i < n; i++){
+            std::copy(&rec._tiresBefore[4*i], &rec._tiresBefore[4*i] + 4, corners);
+            delta[0] = delta[1] = steerAngle(v_params, rec._controls[i][1]);
+            delta[2] = delta[3] = steerAngle(v_params, 0.);
+            tireAdv4(corners, t_params, v_params, delta, rec._controls[i][0]);
+            s += corners[0]._fx + corners[3]._fx;
+        }
+        sink = s;
+    }, n, repeats));
+
+    // evalPowertrain with the vehicle's drive line, and without the torque converter if it has one
+    VehicleState veh;
+    TMeasyState tires[4];
+    add("copy_powertrain", n, timeIt([&]{
+        double s = 0;
+        for(size_t i = 0; i < n; i++){
+            veh = rec._vehPT[i];
+            std::copy(&rec._tiresPT[4*i], &rec._tiresPT[4*i] + 4, tires);
+            s += tires[0]._omega;
+        }
+        sink = s;
+    }, n, repeats));
+    VehicleParam pt_params = v_params;
+    for(int tc = 1; tc >= 0; tc--){
+        if(tc && !v_params._tcbool){
+            continue;
+        }
+        pt_params._tcbool = tc;
+        add(tc ? "evalPowertrain_tc" : "evalPowertrain_notc", n, timeIt([&]{
+            double s = 0;
+            for(size_t i = 0; i < n; i++){
+                veh = rec._vehPT[i];
+                std::copy(&rec._tiresPT[4*i], &rec._tiresPT[4*i] + 4, tires);
+                evalPowertrain(veh, tires[0], tires[1], tires[2], tires[3], pt_params, t_params, rec._controls[i]);
+                s += tires[0]._omega;
+            }
+            sink = s;
+        }, n, repeats));
+    }
+
+    // vehAdv - the forces are copied into the vectors it takes, as test8DOF does
+    std::vector<double> fx(4), fy(4);
+    add("copy_veh", n, timeIt([&]{
+        double s = 0;
+        for(size_t i = 0; i < n; i++){
+            veh = rec._vehAdv[i];
+            std::copy(&rec._fx[4*i], &rec._fx[4*i] + 4, fx.begin());
+            std::copy(&rec._fy[4*i], &rec._fy[4*i] + 4, fy.begin());
+            s += veh._u;
+        }
+        sink = s;
+    }, n, repeats));
+    add("vehAdv", n, timeIt([&]{
+        double s = 0;
+        for(size_t i = 0; i < n; i++){
+            veh = rec._vehAdv[i];
+            std::copy(&rec._fx[4*i], &rec._fx[4*i] + 4, fx.begin());
+            std::copy(&rec._fy[4*i], &rec._fy[4*i] + 4, fy.begin());
+            vehAdv(veh, v_params, fx, fy, rec._huf[i], rec._hur[i]);
+            s += veh._u;
+        }
+        sink = s;
+    }, n, repeats));
+
+    // full step, controls included, over the whole input
+    Simulator sim(v_params, t_params);
+    Controls c;
+    add("step", n, timeIt([&]{
+        sim.reset();
+        for(size_t i = 0; i < n; i++){
+            getControls(c, driverData, rec._times[i]);
+            sim.step(c);
+        }
+        sink = sim.getVehicleState()._u;
+    }, n, repeats));
+
+    // the same steps with the free functions in double and in single precision
+    VehicleParamF v_params_f;
+    TMeasyParamF t_params_f;
+    convertParams(v_params_f, v_params);
+    convertParams(t_params_f, t_params);
+    add("step_free_double", n, timeIt([&]{
+        sink = freeSteps(v_params, t_params, driverData, rec._times);
+    }, n, repeats));
+    add("step_free_float", n, timeIt([&]{
+        sink = freeSteps(v_params_f, t_params_f, driverData, rec._times);
+    }, n, repeats));
+
+    // the same steps for a few blocks of vehicles in an Ensemble, per vehicle and step
+    const int vehicles = 4 * ENSEMBLE_LANES;
+    Ensemble ensemble(vehicles, v_params, t_params);
+    VehicleState v_st;
+    TMeasyState e_tires[4];
+    add("step_ensemble", n * vehicles, timeIt([&]{
+        ensemble.reset();
+        for(size_t i = 0; i < n; i++){
+            getControls(c, driverData, rec._times[i]);
+            ensemble.step(c);
+        }
+        ensemble.getState(0, v_st, e_tires);
+        sink = v_st._u;
+    }, n * vehicles, repeats));
+}
+
+
+int main(int argc, char *argv[]){
+
+    std::string outFile = (argc > 1) ? argv[1] : "";
+    int repeats = (argc > 2) ? std::max(1, std::atoi(argv[2])) : 5;
+
+    std::vector<Vehicle> vehicles = {
+        {"HMMWV", "./jsons/HMMWV.json", "./jsons/TMeasy.json"},
+        {"dART", "./jsons/dART.json", "./jsons/dARTTM.json"}
+    };
+    // acceleration and braking, a step steer and a slow throttle ramp
+    std::vector<std::string> inputs = {"./inputs/acc3.txt", "./inputs/st.txt", "./inputs/ramp_10sec.txt"};
+
+    std::vector<Result> results;
+    for(const Vehicle& v : vehicles){
+        for(const std::string& in : inputs){
+            benchVehicle(results, v, in, repeats);
+        }
+    }
+
+    std::ofstream file;
+    if(!outFile.empty()){
+        file.open(outFile.c_str());
+        if(!file){
+            std::cerr<<"Could not open "<<outFile<<"\n";
+            return 1;
+        }
+    }
+    std::ostream& out = outFile.empty() ? std::cout : file;
+    out<<"vehicle,input,benchmark,calls,ns_per_call\n";
+    for(const Result& r : results){
+        out<<r._vehicle<<","<<r._input<<","<<r._bench<<","<<r._calls<<","<<r._ns<<"\n";
+    }
+
+    return 0;
+}
@@ -5,11 +5,21 @@
 
 
 %{
+#define SWIG_FILE_WITH_INIT
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <numpy/arrayobject.h>
 #include "../utils.h"
 #include "Eightdof.h"
+#include "Simulator.h"
+#include "Batch.h"
+#include "Likelihood.h"
 using namespace EightDOF;
 %}
 
+%init %{
+import_array();
+%}
+
 // initiate our vector of entries and doubles
 %template(vector_entry) std::vector <Entry>;
 %template(vector_mapEntry) std::vector <MapEntry>;
@@ -18,3 +28,363 @@ using namespace EightDOF;
 %include "../utils.h"
 %include "Eightdof.h"
 
+// the model is templated on the scalar type - the double versions keep their old names and the
+// float versions get an F at the end of the struct names
+%template(TMeasyParam) EightDOF::TMeasyParamT<double>;
+%template(TMeasyState) EightDOF::TMeasyStateT<double>;
+%template(VehicleParam) EightDOF::VehicleParamT<double>;
+%template(VehicleState) EightDOF::VehicleStateT<double>;
+%template(TMeasyParamF) EightDOF::TMeasyParamT<float>;
+%template(TMeasyStateF) EightDOF::TMeasyStateT<float>;
+%template(VehicleParamF) EightDOF::VehicleParamT<float>;
+%template(VehicleStateF) EightDOF::VehicleStateT<float>;
+%template(vector_float) std::vector <float>;
+
+%define ROM_MODEL_FUNCTIONS(T)
+%template(vehInit) EightDOF::vehInit<T>;
+%template(evalPowertrain) EightDOF::evalPowertrain<T>;
+%template(vehAdv) EightDOF::vehAdv<T>;
+%template(vehToTireTransform) EightDOF::vehToTireTransform<T>;
+%template(tireToVehTransform) EightDOF::tireToVehTransform<T>;
+%template(tireInit) EightDOF::tireInit<T>;
+%template(tireAdv) EightDOF::tireAdv<T>;
+%enddef
+ROM_MODEL_FUNCTIONS(double)
+ROM_MODEL_FUNCTIONS(float)
+%template(convertParams) EightDOF::convertParams<float, double>;
+
+
+// Runs whole driver input files in C++ for many parameter sets at once
+//
+// simulate(vehJSON, tireJSON, inputFile, endTime, params, theta, outputs, step = 0.001,
+//          decimation = 10, num_threads = 0)
+//
+// params - list of parameter groups, each a comma separated string of JSON key names
+//          (plus torqueMapScale and lossesMapScale), "" to ignore a column of theta
+// theta - (nRuns, len(params)) array of multipliers, a 1D array is a single run
+// outputs - list of output channels - time, x, y, u, v, phi, psi, wx, wz, wlf, wrf, wlr, wrr,
+//          spl_tor, current_gear, engine_omega, engine_torque, tc_inp_tor, tc_out_tor,
+//          tc_out_omg, tc_sr
+//
+// Returns a dict of (nRuns, nSamples) arrays, one per output. The simulation writes straight
+// into the memory of the returned arrays and runs with the GIL released
+%{
+// list of python strings to a vector of strings, false if obj is not one
+static bool romStringList(std::vector<std::string>& out, PyObject* obj){
+    if(!PySequence_Check(obj) || PyUnicode_Check(obj)){
+        return false;
+    }
+    Py_ssize_t n = PySequence_Size(obj);
+    for(Py_ssize_t i = 0; i < n; i++){
+        PyObject* item = PySequence_GetItem(obj, i);
+        const char* s = item ? PyUnicode_AsUTF8(item) : NULL;
+        Py_XDECREF(item);
+        if(!s){
+            return false;
+        }
+        out.push_back(s);
+    }
+    return true;
+}
+
+// checks the arguments shared by simulate and simulateGradient, sets the python error if one is bad
+static bool romParseArgs(ParamGroups& groups, std::vector<std::string>& output_names, std::vector<int>& channels,
+                            PyObject* params, PyObject* outputs, double step, int decimation){
+    std::vector<std::string> param_specs;
+    if(!romStringList(param_specs, params)){
+        PyErr_SetString(PyExc_TypeError, "params has to be a list of strings");
+        return false;
+    }
+    if(!romStringList(output_names, outputs)){
+        PyErr_SetString(PyExc_TypeError, "outputs has to be a list of strings");
+        return false;
+    }
+    if(decimation < 1 || step <= 0.){
+        PyErr_SetString(PyExc_ValueError, "step and decimation have to be positive");
+        return false;
+    }
+
+    std::string bad;
+    if(!parseParamGroups(groups, param_specs, bad)){
+        PyErr_Format(PyExc_ValueError, "unknown parameter %s", bad.c_str());
+        return false;
+    }
+    for(const std::string& name : output_names){
+        int c = outputIndex(name);
+        if(c < 0){
+            PyErr_Format(PyExc_ValueError, "unknown output %s", name.c_str());
+            return false;
+        }
+        channels.push_back(c);
+    }
+    return true;
+}
+
+// reads the driver inputs and copies the parameters of the JSON files, which are parsed only
+// the first time (see setVehParamsCached) - a calibration calls this for every sample
+static bool romLoad(VehicleParam& veh_param, TMeasyParam& tire_param, std::vector<Entry>& driverData,
+                    const char* vehJSON, const char* tireJSON, const std::string& inputFile, double step){
+    setVehParamsCached(veh_param, vehJSON);
+    setTireParamsCached(tire_param, tireJSON);
+    driverInput(driverData, inputFile);
+    if(driverData.empty()){
+        PyErr_Format(PyExc_IOError, "no driver inputs read from %s", inputFile.c_str());
+        return false;
+    }
+    veh_param._step = step;
+    tire_param._step = step;
+    return true;
+}
+%}
+
+%inline %{
+PyObject* simulate(const char* vehJSON, const char* tireJSON, const std::string& inputFile, double endTime,
+                    PyObject* params, PyObject* theta, PyObject* outputs,
+                    double step = 0.001, int decimation = 10, int num_threads = 0){
+
+    std::vector<std::string> output_names;
+    ParamGroups groups;
+    std::vector<int> channels;
+    if(!romParseArgs(groups, output_names, channels, params, outputs, step, decimation)){
+        return NULL;
+    }
+
+    PyArrayObject* th = (PyArrayObject*)PyArray_FROM_OTF(theta, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY);
+    if(!th){
+        return NULL;
+    }
+    int nd = PyArray_NDIM(th);
+    npy_intp nRuns = (nd == 2) ? PyArray_DIM(th, 0) : 1;
+    npy_intp nCols = (nd == 2) ? PyArray_DIM(th, 1) : (nd == 1 ? PyArray_DIM(th, 0) : -1);
+    if(nCols != (npy_intp)groups._names.size() || nRuns < 1){
+        Py_DECREF(th);
+        PyErr_SetString(PyExc_ValueError, "theta has to be (nRuns, len(params))");
+        return NULL;
+    }
+
+    VehicleParam veh_param;
+    TMeasyParam tire_param;
+    std::vector<Entry> driverData;
+    if(!romLoad(veh_param, tire_param, driverData, vehJSON, tireJSON, inputFile, step)){
+        Py_DECREF(th);
+        return NULL;
+    }
+
+    // one block for all the outputs - the arrays handed back are views into it
+    npy_intp nSamples = batchSamples(endTime, step, decimation);
+    npy_intp dims[3] = {(npy_intp)channels.size(), nRuns, nSamples};
+    PyArrayObject* all = (PyArrayObject*)PyArray_SimpleNew(3, dims, NPY_DOUBLE);
+    if(!all){
+        Py_DECREF(th);
+        return NULL;
+    }
+    double* out = (double*)PyArray_DATA(all);
+    const double* th_data = (const double*)PyArray_DATA(th);
+
+    Py_BEGIN_ALLOW_THREADS
+    simulateBatch(out, veh_param, tire_param, driverData, endTime, groups, th_data, nRuns,
+                    channels, decimation, num_threads);
+    Py_END_ALLOW_THREADS
+    Py_DECREF(th);
+
+    PyObject* result = PyDict_New();
+    for(size_t o = 0; o < channels.size(); o++){
+        npy_intp view_dims[2] = {nRuns, nSamples};
+        PyObject* view = PyArray_SimpleNewFromData(2, view_dims, NPY_DOUBLE, out + o*nRuns*nSamples);
+        // the view keeps the block alive
+        Py_INCREF(all);
+        PyArray_SetBaseObject((PyArrayObject*)view, (PyObject*)all);
+        PyDict_SetItemString(result, output_names[o].c_str(), view);
+        Py_DECREF(view);
+    }
+    Py_DECREF(all);
+    return result;
+}
+%}
+
+
+// Derivatives of the outputs with respect to the parameter multipliers
+//
+// simulateGradient(vehJSON, tireJSON, inputFile, endTime, params, theta, outputs, step = 0.001,
+//                  decimation = 10)
+//
+// The arguments are those of simulate, but theta is a single run (len(params),). Returns a tuple
+// (values, grads) of dicts - values[name] is the (nSamples,) output and grads[name] the
+// (len(params), nSamples) derivatives of it with respect to every entry of theta. The model runs
+// on dual numbers, so this costs a few model runs and not one (or two) per parameter
+%inline %{
+PyObject* simulateGradient(const char* vehJSON, const char* tireJSON, const std::string& inputFile, double endTime,
+                            PyObject* params, PyObject* theta, PyObject* outputs,
+                            double step = 0.001, int decimation = 10){
+
+    std::vector<std::string> output_names;
+    ParamGroups groups;
+    std::vector<int> channels;
+    if(!romParseArgs(groups, output_names, channels, params, outputs, step, decimation)){
+        return NULL;
+    }
+
+    PyArrayObject* th = (PyArrayObject*)PyArray_FROM_OTF(theta, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY);
+    if(!th){
+        return NULL;
+    }
+    npy_intp numGroups = groups._names.size();
+    if(PyArray_SIZE(th) != numGroups){
+        Py_DECREF(th);
+        PyErr_SetString(PyExc_ValueError, "theta has to be (len(params),)");
+        return NULL;
+    }
+
+    VehicleParam veh_param;
+    TMeasyParam tire_param;
+    std::vector<Entry> driverData;
+    if(!romLoad(veh_param, tire_param, driverData, vehJSON, tireJSON, inputFile, step)){
+        Py_DECREF(th);
+        return NULL;
+    }
+
+    npy_intp nSamples = batchSamples(endTime, step, decimation);
+    npy_intp nOut = channels.size();
+    npy_intp out_dims[2] = {nOut, nSamples};
+    npy_intp grad_dims[3] = {nOut, numGroups, nSamples};
+    PyArrayObject* all = (PyArrayObject*)PyArray_SimpleNew(2, out_dims, NPY_DOUBLE);
+    PyArrayObject* all_grad = (PyArrayObject*)PyArray_SimpleNew(3, grad_dims, NPY_DOUBLE);
+    if(!all || !all_grad){
+        Py_XDECREF(all);
+        Py_XDECREF(all_grad);
+        Py_DECREF(th);
+        return NULL;
+    }
+    double* out = (double*)PyArray_DATA(all);
+    double* grad = (double*)PyArray_DATA(all_grad);
+    const double* th_data = (const double*)PyArray_DATA(th);
+
+    Py_BEGIN_ALLOW_THREADS
+    EightDOF::simulateGradient(out, grad, veh_param, tire_param, driverData, endTime, groups, th_data,
+                        channels, decimation);
+    Py_END_ALLOW_THREADS
+    Py_DECREF(th);
+
+    PyObject* values = PyDict_New();
+    PyObject* grads = PyDict_New();
+    for(npy_intp o = 0; o < nOut; o++){
+        // the views keep the blocks alive
+        PyObject* view = PyArray_SimpleNewFromData(1, &nSamples, NPY_DOUBLE, out + o*nSamples);
+        Py_INCREF(all);
+        PyArray_SetBaseObject((PyArrayObject*)view, (PyObject*)all);
+        PyDict_SetItemString(values, output_names[o].c_str(), view);
+        Py_DECREF(view);
+
+        npy_intp view_dims[2] = {numGroups, nSamples};
+        view = PyArray_SimpleNewFromData(2, view_dims, NPY_DOUBLE, grad + o*numGroups*nSamples);
+        Py_INCREF(all_grad);
+        PyArray_SetBaseObject((PyArrayObject*)view, (PyObject*)all_grad);
+        PyDict_SetItemString(grads, output_names[o].c_str(), view);
+        Py_DECREF(view);
+    }
+    Py_DECREF(all);
+    Py_DECREF(all_grad);
+    return Py_BuildValue("(NN)", values, grads);
+}
+%}
+
+
+// Log likelihood of recorded runs, the whole calibration likelihood in C++
+//
+// loglike(vehJSON, tireJSON, params, theta, sigmas, inputFiles, endTimes, dataFiles, outputs,
+//         columns = None, dataStep = 0.01, step = 0.001, decimation = 10, residuals = False)
+//
+// params and theta are those of simulate for a single run, sigmas has one standard deviation per
+// output. Run i drives inputFiles[i] up to endTimes[i] and compares the outputs with dataFiles[i],
+// either a .npy file of shape (len(outputs), samples) taken every dataStep seconds, or a csv file
+// with a time column and the given columns (a leading '-' flips the sign, e.g. "-yaw"). The data
+// files are read only on the first call. Returns the log likelihood, the mean over the runs of the
+// one the calibration scripts compute, and with residuals = True a tuple (loglike, norms) with the
+// 2 norm of the residuals of every output over all the runs. Runs with the GIL released
+%inline %{
+PyObject* loglike(const char* vehJSON, const char* tireJSON, PyObject* params, PyObject* theta, PyObject* sigmas,
+                    PyObject* inputFiles, PyObject* endTimes, PyObject* dataFiles, PyObject* outputs,
+                    PyObject* columns = Py_None, double dataStep = 0.01, double step = 0.001, int decimation = 10,
+                    bool residuals = false){
+
+    std::vector<std::string> output_names;
+    ParamGroups groups;
+    std::vector<int> channels;
+    if(!romParseArgs(groups, output_names, channels, params, outputs, step, decimation)){
+        return NULL;
+    }
+    std::vector<std::string> input_names, data_names, column_names;
+    if(!romStringList(input_names, inputFiles) || !romStringList(data_names, dataFiles)){
+        PyErr_SetString(PyExc_TypeError, "inputFiles and dataFiles have to be lists of strings");
+        return NULL;
+    }
+    if(columns != Py_None && !romStringList(column_names, columns)){
+        PyErr_SetString(PyExc_TypeError, "columns has to be a list of strings");
+        return NULL;
+    }
+    PyArrayObject* ends = (PyArrayObject*)PyArray_FROM_OTF(endTimes, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY);
+    if(!ends){
+        return NULL;
+    }
+    if(PyArray_SIZE(ends) != (npy_intp)input_names.size() || data_names.size() != input_names.size()){
+        Py_DECREF(ends);
+        PyErr_SetString(PyExc_ValueError, "inputFiles, endTimes and dataFiles have to have the same length");
+        return NULL;
+    }
+    PyArrayObject* th = (PyArrayObject*)PyArray_FROM_OTF(theta, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY);
+    PyArrayObject* sg = (PyArrayObject*)PyArray_FROM_OTF(sigmas, NPY_DOUBLE, NPY_ARRAY_IN_ARRAY);
+    if(!th || !sg || PyArray_SIZE(th) != (npy_intp)groups._names.size()
+                  || PyArray_SIZE(sg) != (npy_intp)channels.size()){
+        if(th && sg){
+            PyErr_SetString(PyExc_ValueError, "theta has to be (len(params),) and sigmas (len(outputs),)");
+        }
+        Py_XDECREF(th);
+        Py_XDECREF(sg);
+        Py_DECREF(ends);
+        return NULL;
+    }
+
+    VehicleParam veh_param;
+    TMeasyParam tire_param;
+    setVehParamsCached(veh_param, vehJSON);
+    setTireParamsCached(tire_param, tireJSON);
+    veh_param._step = step;
+    tire_param._step = step;
+    Likelihood like(veh_param, tire_param, groups);
+    const double* end_data = (const double*)PyArray_DATA(ends);
+    for(size_t i = 0; i < input_names.size(); i++){
+        std::string error;
+        std::shared_ptr<const ObservedRun> run = cachedObservedRun(input_names[i], end_data[i], data_names[i],
+                                    output_names, column_names, dataStep, step, decimation, error);
+        if(!run || !like.addRun(run)){
+            PyErr_Format(PyExc_IOError, "%s", run ? ("no samples to compare in " + data_names[i]).c_str() : error.c_str());
+            Py_DECREF(th);
+            Py_DECREF(sg);
+            Py_DECREF(ends);
+            return NULL;
+        }
+    }
+    Py_DECREF(ends);
+
+    const double* th_data = (const double*)PyArray_DATA(th);
+    const double* sg_data = (const double*)PyArray_DATA(sg);
+    std::vector<double> norms(channels.size());
+    double value;
+    Py_BEGIN_ALLOW_THREADS
+    value = like.logLikelihood(th_data, sg_data, norms.data());
+    Py_END_ALLOW_THREADS
+    Py_DECREF(th);
+    Py_DECREF(sg);
+
+    if(!residuals){
+        return PyFloat_FromDouble(value);
+    }
+    npy_intp dims = channels.size();
+    PyArrayObject* out = (PyArrayObject*)PyArray_SimpleNew(1, &dims, NPY_DOUBLE);
+    if(!out){
+        return NULL;
+    }
+    std::copy(norms.begin(), norms.end(), (double*)PyArray_DATA(out));
+    return Py_BuildValue("(dN)", value, out);
+}
+%}
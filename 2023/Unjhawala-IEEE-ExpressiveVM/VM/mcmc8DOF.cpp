@@ -0,0 +1,221 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdint.h>
+#include <chrono>
+#include "../utils.h"
+#include "Eightdof.h"
+#include "Batch.h"
+#include "Likelihood.h"
+#include "Mcmc.h"
+
+using std::chrono::high_resolution_clock;
+using std::chrono::duration;
+using namespace EightDOF;
+
+/*
+Calibration of the 8 DOF model with the ensemble sampler of Mcmc.h, the model and the likelihood
+running in process (see Likelihood.h). Reads a settings file where every line is one of
+
+    vehicle file.json                 - vehicle parameters
+    tire file.json                    - tire parameters
+    outputs u,psi                     - model channels compared with the data (see OUTPUT_NAMES in Simulator.h)
+    run input endTime data [columns]  - a recorded run, data is a .npy file of shape (outputs, samples)
+                                        or a csv file with the given comma separated columns
+    param name group prior            - a multiplier of the parameter group (see ParamGroups in Batch.h)
+    sigma name prior                  - the standard deviation of the next output channel
+    walkers, draws, tune, thin, seed, step, decimation, datastep, stretch, spread - numbers
+
+with prior either "uniform lower upper init" or "halfnormal scale init". There is one sigma per
+output. Lines starting with # are ignored. The draws are written to the csv file with the columns
+chain, draw, lp and the names of the params and sigmas (see the README to load it with ArviZ).
+Usage : ./mcmc8DOF settings.txt chain.csv [num_threads]
+*/
+
+struct RunSpec{
+    std::string _input, _data;
+    double _endTime;
+    std::vector<std::string> _columns;
+};
+
+struct Settings{
+    std::string _veh, _tire;
+    std::vector<std::string> _outputs;
+    std::vector<RunSpec> _runs;
+    std::vector<std::string> _groups;
+    std::vector<McmcPrior> _params, _sigmas;
+    double _step = 0.001, _dataStep = 0.01;
+    int _decimation = 10;
+    McmcSettings _mcmc;
+};
+
+
+// splits a comma separated list
+static std::vector<std::string> splitList(const std::string& s){
+    std::vector<std::string> out;
+    std::stringstream ss(s);
+    std::string item;
+    while(std::getline(ss, item, ',')){
+        out.push_back(item);
+    }
+    return out;
+}
+
+// reads "uniform lower upper init" or "halfnormal scale init"
+static bool readPrior(McmcPrior& prior, std::istringstream& iss){
+    std::string kind;
+    iss >> kind;
+    if(kind == "uniform"){
+        prior._kind = MCMC_UNIFORM;
+        iss >> prior._a >> prior._b >> prior._init;
+    }
+    else if(kind == "halfnormal"){
+        prior._kind = MCMC_HALFNORMAL;
+        prior._b = 0.;
+        iss >> prior._a >> prior._init;
+    }
+    else{
+        return false;
+    }
+    return !iss.fail();
+}
+
+// reads the settings file, returns false on a bad line
+static bool readSettings(Settings& s, const std::string& fileName){
+    std::ifstream ifile(fileName.c_str());
+    if(!ifile){
+        std::cout<<"Could not open "<<fileName<<"\n";
+        return false;
+    }
+    std::string line;
+    int lineNo = 0;
+    while(std::getline(ifile, line)){
+        lineNo++;
+        std::istringstream iss(line);
+        std::string key;
+        if(!(iss >> key) || key[0] == '#'){
+            continue;
+        }
+        bool ok = true;
+        if(key == "vehicle"){
+            ok = bool(iss >> s._veh);
+        }
+        else if(key == "tire"){
+            ok = bool(iss >> s._tire);
+        }
+        else if(key == "outputs"){
+            std::string list;
+            ok = bool(iss >> list);
+            s._outputs = splitList(list);
+        }
+        else if(key == "run"){
+            RunSpec run;
+            ok = bool(iss >> run._input >> run._endTime >> run._data);
+            std::string columns;
+            if(ok && iss >> columns){
+                run._columns = splitList(columns);
+            }
+            s._runs.push_back(run);
+        }
+        else if(key == "param"){
+            McmcPrior prior;
+            std::string group;
+            ok = (iss >> prior._name >> group) && readPrior(prior, iss);
+            // an empty group is written as "-"
+            s._groups.push_back(group == "-" ? "" : group);
+            s._params.push_back(prior);
+        }
+        else if(key == "sigma"){
+            McmcPrior prior;
+            ok = (iss >> prior._name) && readPrior(prior, iss);
+            s._sigmas.push_back(prior);
+        }
+        else if(key == "walkers"){ ok = bool(iss >> s._mcmc._walkers); }
+        else if(key == "draws"){ ok = bool(iss >> s._mcmc._draws); }
+        else if(key == "tune"){ ok = bool(iss >> s._mcmc._tune); }
+        else if(key == "thin"){ ok = bool(iss >> s._mcmc._thin); }
+        else if(key == "seed"){ ok = bool(iss >> s._mcmc._seed); }
+        else if(key == "stretch"){ ok = bool(iss >> s._mcmc._stretch); }
+        else if(key == "spread"){ ok = bool(iss >> s._mcmc._spread); }
+        else if(key == "step"){ ok = bool(iss >> s._step); }
+        else if(key == "decimation"){ ok = bool(iss >> s._decimation); }
+        else if(key == "datastep"){ ok = bool(iss >> s._dataStep); }
+        else{
+            ok = false;
+        }
+        if(!ok){
+            std::cout<<fileName<<":"<<lineNo<<" cannot read "<<line<<"\n";
+            return false;
+        }
+    }
+    if(s._veh.empty() || s._tire.empty() || s._runs.empty() || s._params.empty()
+        || s._sigmas.size() != s._outputs.size()){
+        std::cout<<fileName<<" needs a vehicle, a tire, runs, params and one sigma per output\n";
+        return false;
+    }
+    return true;
+}
+
+
+int main(int argc, char *argv[]){
+    if(argc < 3){
+        std::cout<<"Usage : ./mcmc8DOF settings.txt chain.csv [num_threads]\n";
+        return 1;
+    }
+    Settings settings;
+    if(!readSettings(settings, argv[1])){
+        return 1;
+    }
+    if(argc > 3){
+        settings._mcmc._threads = std::atoi(argv[3]);
+    }
+
+    ParamGroups groups;
+    std::string error;
+    if(!parseParamGroups(groups, settings._groups, error)){
+        std::cout<<"Unknown parameter "<<error<<"\n";
+        return 1;
+    }
+    VehicleParam veh_param;
+    TMeasyParam tire_param;
+    setVehParamsCached(veh_param, settings._veh.c_str());
+    setTireParamsCached(tire_param, settings._tire.c_str());
+    veh_param._step = settings._step;
+    tire_param._step = settings._step;
+
+    Likelihood like(veh_param, tire_param, groups);
+    for(const RunSpec& r : settings._runs){
+        std::shared_ptr<const ObservedRun> run = cachedObservedRun(r._input, r._endTime, r._data, settings._outputs,
+                                    r._columns, settings._dataStep, settings._step, settings._decimation, error);
+        if(!run || !like.addRun(run)){
+            std::cout<<"Cannot use the run "<<r._data<<" "<<error<<"\n";
+            return 1;
+        }
+    }
+
+    // the multipliers of the groups first, then the sigmas
+    std::vector<McmcPrior> priors = settings._params;
+    priors.insert(priors.end(), settings._sigmas.begin(), settings._sigmas.end());
+    size_t nGroups = settings._params.size();
+    McmcLogLike loglike = [&](const double* x){
+        return like.logLikelihood(x, x + nGroups);
+    };
+
+    std::ofstream out(argv[2]);
+    if(!out){
+        std::cout<<"Could not open "<<argv[2]<<"\n";
+        return 1;
+    }
+    auto start = high_resolution_clock::now();
+    double acceptance = sampleEnsemble(loglike, priors, settings._mcmc, out, error);
+    auto stop = high_resolution_clock::now();
+    if(acceptance < 0.){
+        std::cout<<error<<"\n";
+        return 1;
+    }
+    duration<double> time = stop - start;
+    long evals = long(settings._mcmc._walkers) * (settings._mcmc._tune + settings._mcmc._draws * settings._mcmc._thin);
+    std::cout<<settings._mcmc._walkers<<" walkers, "<<settings._mcmc._draws<<" draws each, acceptance "<<acceptance
+             <<"\n"<<evals<<" likelihood evaluations in "<<time.count()<<" s\n";
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include <iostream>
+#include <stdint.h>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <atomic>
+#include "../utils.h"
+#include "Eightdof.h"
+#include "Simulator.h"
+#include "RealTime.h"
+
+
+using namespace EightDOF;
+
+/*
+Runs the HMMWV paced against the wall clock, as it would run in a hardware in the loop test. A
+second thread plays the role of the hardware, writing the controls of an input file into the
+control slot at the wall clock time they are due, and a third one reads the published states
+(and writes them to a csv file if one is given). At the end the deadline misses, the histogram of
+the step times and the percentiles of the jitter of the step starts are reported.
+Usage : ./rt8DOF [input file] [end time] [period (s), 0 - model step] [output csv]
+*/
+
+
+// prints the non empty bins of a histogram, merged into bins of width us
+static void printHist(const std::vector<uint64_t>& hist, size_t width){
+    for(size_t i = 0; i < hist.size(); i += width){
+        uint64_t n = 0;
+        for(size_t j = i; j < std::min(hist.size(), i + width); j++){
+            n += hist[j];
+        }
+        if(n){
+            std::cout<<"  "<<i<<" - "<<i + width<<" us : "<<n<<"\n";
+        }
+    }
+}
+
+static void printPercentiles(const std::vector<uint64_t>& hist, double maxVal){
+    std::cout<<"  p50 "<<RealTimeStats::percentile(hist, 50.)<<" us, p90 "<<RealTimeStats::percentile(hist, 90.)
+             <<" us, p99 "<<RealTimeStats::percentile(hist, 99.)<<" us, p99.9 "<<RealTimeStats::percentile(hist, 99.9)
+             <<" us, max "<<maxVal<<" us\n";
+}
+
+
+int main(int argc, char *argv[]){
+
+    std::string fileName = "./inputs/acc3.txt";
+    double endTime = 10.0;
+    double period = 0.;
+    std::string outFile;
+    if(argc > 2){
+        fileName = argv[1];
+        endTime = std::atof(argv[2]);
+    }
+    if(argc > 3){
+        period = std::atof(argv[3]);
+    }
+    if(argc > 4){
+        outFile = argv[4];
+    }
+
+    VehicleParam veh_param;
+    setVehParamsJSON(veh_param, "./jsons/HMMWV.json");
+    TMeasyParam tire_param;
+    setTireParamsJSON(tire_param, "./jsons/TMeasy.json");
+    veh_param._step = 0.001;
+    tire_param._step = 0.001;
+    double step = veh_param._step;
+    if(period <= 0.){
+        period = step;
+    }
+
+    Simulator sim(veh_param, tire_param);
+    RealTimeRunner runner(sim, period);
+    std::atomic<bool> done(false);
+
+    // the hardware - the controls of the input file at the model time that corresponds to the wall clock
+    std::thread hardware([&](){
+        Driver_input input(fileName);
+        Controls controls;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        while(!done.load()){
+            double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            getControls(controls, input, wall / period * step);
+            runner.controls().write(controls);
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+    });
+
+    // the consumer of the states
+    uint64_t received = 0;
+    RealTimeSample last;
+    std::thread consumer([&](){
+        CSV_writer csv(",");
+        csv.stream().setf(std::ios::scientific | std::ios::showpos);
+        csv.stream().precision(8);
+        if(!outFile.empty()){
+            csv << "time" << "wall" << "x" << "y" << "u" << "v" << "psi" << "wz" << "wlf" << "wrf" << "wlr" << "wrr" << std::endl;
+        }
+        RealTimeSample sample;
+        for(;;){
+            bool finished = done.load();
+            while(runner.samples().pop(sample)){
+                received++;
+                if(!outFile.empty()){
+                    csv << (sample._step + 1) * step << sample._wall << sample._v_states._x << sample._v_states._y
+                        << sample._v_states._u << sample._v_states._v << sample._v_states._psi << sample._v_states._wz
+                        << sample._omega[0] << sample._omega[1] << sample._omega[2] << sample._omega[3] << std::endl;
+                }
+                last = sample;
+            }
+            if(finished){
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if(!outFile.empty()){
+            csv.write_to_file(outFile);
+        }
+    });
+
+    runner.run(endTime);
+    done.store(true);
+    hardware.join();
+    consumer.join();
+
+    const RealTimeStats& stats = runner.stats();
+    std::cout<<"Steps : "<<stats._steps<<" at a period of "<<period * 1e3<<" ms\n";
+    std::cout<<"Deadline misses : "<<stats._misses<<"\n";
+    std::cout<<"States received : "<<received<<", dropped (ring full) : "<<stats._dropped<<"\n";
+    std::cout<<"Step time histogram :\n";
+    printHist(stats._stepHist, 10);
+    std::cout<<"Step time :\n";
+    printPercentiles(stats._stepHist, stats._maxStep);
+    std::cout<<"Jitter of the step starts :\n";
+    printPercentiles(stats._jitterHist, stats._maxJitter);
+    std::cout<<"Final position : "<<last._v_states._x<<", "<<last._v_states._y<<"\n";
+
+    return received + stats._dropped == stats._steps ? 0 : 1;
+}
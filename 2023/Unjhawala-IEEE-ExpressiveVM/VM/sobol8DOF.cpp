@@ -0,0 +1,151 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdint.h>
+#include <chrono>
+#include "../utils.h"
+#include "Eightdof.h"
+#include "Batch.h"
+#include "Sobol.h"
+
+using std::chrono::high_resolution_clock;
+using std::chrono::duration;
+using namespace EightDOF;
+
+/*
+Global sensitivity analysis of the 8 DOF model with Sobol indices (see Sobol.h). Reads a settings
+file where every line is one of
+
+    vehicle file.json              - vehicle parameters
+    tire file.json                 - tire parameters
+    input file endTime             - driver input and the end of the runs
+    param name group lower upper   - a multiplier of the parameter group (see ParamGroups in Batch.h)
+    quantity output:stat           - a quantity of a run, stat is final, mean, min, max or rms
+    samples, block, step           - numbers
+
+Lines starting with # are ignored. Every sample runs the model (params + 2) times. Prints the first
+order and total indices of every quantity and param, and writes them to the csv file if one is given.
+Usage : ./sobol8DOF settings.txt [indices.csv] [num_threads]
+*/
+
+struct Settings{
+    std::string _veh, _tire, _input;
+    double _endTime = 0.;
+    std::vector<std::string> _names, _groups;
+    std::vector<double> _lower, _upper;
+    std::vector<SensitivityQuantity> _quantities;
+    long _samples = 1024;
+    int _block = 256;
+    double _step = 0.001;
+};
+
+
+// reads the settings file, returns false on a bad line
+static bool readSettings(Settings& s, const std::string& fileName){
+    std::ifstream ifile(fileName.c_str());
+    if(!ifile){
+        std::cout<<"Could not open "<<fileName<<"\n";
+        return false;
+    }
+    std::string line;
+    int lineNo = 0;
+    while(std::getline(ifile, line)){
+        lineNo++;
+        std::istringstream iss(line);
+        std::string key;
+        if(!(iss >> key) || key[0] == '#'){
+            continue;
+        }
+        bool ok = true;
+        if(key == "vehicle"){ ok = bool(iss >> s._veh); }
+        else if(key == "tire"){ ok = bool(iss >> s._tire); }
+        else if(key == "input"){ ok = bool(iss >> s._input >> s._endTime); }
+        else if(key == "param"){
+            std::string name, group;
+            double lower, upper;
+            ok = bool(iss >> name >> group >> lower >> upper) && lower <= upper;
+            s._names.push_back(name);
+            s._groups.push_back(group);
+            s._lower.push_back(lower);
+            s._upper.push_back(upper);
+        }
+        else if(key == "quantity"){
+            std::string spec;
+            SensitivityQuantity q;
+            ok = (iss >> spec) && parseSensitivityQuantity(q, spec);
+            s._quantities.push_back(q);
+        }
+        else if(key == "samples"){ ok = bool(iss >> s._samples); }
+        else if(key == "block"){ ok = bool(iss >> s._block); }
+        else if(key == "step"){ ok = bool(iss >> s._step); }
+        else{
+            ok = false;
+        }
+        if(!ok){
+            std::cout<<fileName<<":"<<lineNo<<" cannot read "<<line<<"\n";
+            return false;
+        }
+    }
+    if(s._veh.empty() || s._tire.empty() || s._input.empty() || s._names.empty() || s._quantities.empty()){
+        std::cout<<fileName<<" needs a vehicle, a tire, an input, params and quantities\n";
+        return false;
+    }
+    return true;
+}
+
+
+int main(int argc, char *argv[]){
+    if(argc < 2){
+        std::cout<<"Usage : ./sobol8DOF settings.txt [indices.csv] [num_threads]\n";
+        return 1;
+    }
+    Settings settings;
+    if(!readSettings(settings, argv[1])){
+        return 1;
+    }
+    unsigned int num_threads = argc > 3 ? std::atoi(argv[3]) : 0;
+
+    ParamGroups groups;
+    std::string bad;
+    if(!parseParamGroups(groups, settings._groups, bad)){
+        std::cout<<"Unknown parameter "<<bad<<"\n";
+        return 1;
+    }
+    VehicleParam veh_param;
+    TMeasyParam tire_param;
+    setVehParamsJSON(veh_param, settings._veh.c_str());
+    setTireParamsJSON(tire_param, settings._tire.c_str());
+    veh_param._step = settings._step;
+    tire_param._step = settings._step;
+    std::vector<Entry> driverData;
+    driverInput(driverData, settings._input);
+
+    std::vector<SobolAccumulator> acc;
+    auto start = high_resolution_clock::now();
+    if(!sobolIndices(acc, veh_param, tire_param, driverData, settings._endTime, groups, settings._lower.data(),
+                        settings._upper.data(), settings._quantities, settings._samples, settings._block, num_threads)){
+        std::cout<<"At most "<<SobolSequence::MAX_DIMS / 2<<" params\n";
+        return 1;
+    }
+    auto stop = high_resolution_clock::now();
+    duration<double> time = stop - start;
+    std::cout<<settings._samples<<" samples, "<<settings._samples * (settings._names.size() + 2)<<" runs in "
+             <<time.count()<<" s\n";
+
+    std::ofstream csv;
+    if(argc > 2){
+        csv.open(argv[2]);
+        csv<<"quantity,param,first,total\n";
+    }
+    for(size_t q = 0; q < acc.size(); q++){
+        std::cout<<settings._quantities[q]._name<<" (mean "<<acc[q].mean()<<", variance "<<acc[q].variance()<<")\n";
+        for(size_t i = 0; i < settings._names.size(); i++){
+            std::cout<<"    "<<settings._names[i]<<" : first "<<acc[q].first(i)<<", total "<<acc[q].total(i)<<"\n";
+            if(csv.is_open()){
+                csv<<settings._quantities[q]._name<<","<<settings._names[i]<<","<<acc[q].first(i)<<","
+                   <<acc[q].total(i)<<"\n";
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,331 @@
+#include <iostream>
+#include <stdint.h>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <filesystem>
+#include "../utils.h"
+#include "Eightdof.h"
+#include "Simulator.h"
+#include "ThreadPool.h"
+
+using std::chrono::high_resolution_clock;
+using std::chrono::duration;
+using namespace EightDOF;
+namespace fs = std::filesystem;
+
+/*
+Parameter sweep runner for the 8 DOF model. Reads a job file where every line is
+
+    vehicle.json tire.json input endTime output [name=value | name*=factor ...] [options]
+
+and runs all the jobs on a work stealing thread pool. The names are the keys of the JSON
+files (see getParamPtr in Eightdof.h), "step" sets the vehicle and the tire time step.
+If input is a directory, every .txt file in it and in its subdirectories is a job, and output
+is taken as a directory with one file per input in the same subdirectories. A directory
+without any .txt file is an error. Lines starting with # are ignored.
+Outputs ending in .bin are written with the streaming Binary_writer, anything else as csv.
+The options are
+    fields=u,v,psi - output channels to write (see OUTPUT_NAMES in Simulator.h), default all
+    decimation=10 - write the initial state and then every 10th step
+    float32 - store float32 values in .bin outputs
+Each JSON file and each driver input is read once and shared read only by all the jobs.
+
+Usage : ./sweep8DOF jobs.txt [num_threads]
+*/
+
+struct Override{
+    std::string _name;
+    double _value;
+    bool _scale; // multiply instead of set
+};
+
+struct Job{
+    std::string _veh, _tire, _input, _out;
+    double _endTime;
+    std::vector<Override> _overrides;
+    std::vector<int> _fields; // output channels
+    int _decimation;
+    bool _single;
+};
+
+// everything the jobs share - filled before any job runs and only read afterwards
+struct SharedData{
+    std::map<std::string, VehicleParam> _vehs;
+    std::map<std::string, TMeasyParam> _tires;
+    std::map<std::string, std::vector<Entry>> _inputs;
+};
+
+
+// parses "name=value" or "name*=factor", returns false if it is neither
+bool parseOverride(Override& o, const std::string& s){
+    size_t eq = s.find('=');
+    if(eq == std::string::npos || eq == 0){
+        return false;
+    }
+    o._scale = (s[eq - 1] == '*');
+    o._name = s.substr(0, o._scale ? eq - 1 : eq);
+    try{
+        size_t used;
+        o._value = std::stod(s.substr(eq + 1), &used);
+        if(used != s.size() - eq - 1){
+            return false;
+        }
+    }
+    catch(...){
+        return false;
+    }
+    return !o._name.empty();
+}
+
+// reads the job file, expanding the input directories. Returns false on a bad line
+bool readJobs(std::vector<Job>& jobs, const std::string& fileName){
+    std::ifstream ifile(fileName.c_str());
+    if(!ifile){
+        std::cout<<"Could not open "<<fileName<<"\n";
+        return false;
+    }
+    std::string line;
+    int lineNo = 0;
+    while(std::getline(ifile, line)){
+        lineNo++;
+        std::istringstream iss(line);
+        Job job;
+        std::string first;
+        if(!(iss >> first) || first[0] == '#'){
+            continue;
+        }
+        job._veh = first;
+        iss >> job._tire >> job._input >> job._endTime >> job._out;
+        if(iss.fail()){
+            std::cout<<fileName<<":"<<lineNo<<" expected - vehicle.json tire.json input endTime output\n";
+            return false;
+        }
+        job._decimation = 10;
+        job._single = false;
+        std::string ov;
+        while(iss >> ov){
+            if(ov.compare(0, 7, "fields=") == 0){
+                std::stringstream ss(ov.substr(7));
+                std::string name;
+                while(std::getline(ss, name, ',')){
+                    int c = outputIndex(name);
+                    if(c < 0){
+                        std::cout<<fileName<<":"<<lineNo<<" unknown output "<<name<<"\n";
+                        return false;
+                    }
+                    job._fields.push_back(c);
+                }
+                continue;
+            }
+            if(ov.compare(0, 11, "decimation=") == 0){
+                job._decimation = std::atoi(ov.c_str() + 11);
+                if(job._decimation < 1){
+                    std::cout<<fileName<<":"<<lineNo<<" bad decimation "<<ov<<"\n";
+                    return false;
+                }
+                continue;
+            }
+            if(ov == "float32"){
+                job._single = true;
+                continue;
+            }
+            Override o;
+            VehicleParam v;
+            TMeasyParam t;
+            if(!parseOverride(o, ov) || (o._name != "step" && getParamPtr(v, t, o._name) == nullptr)){
+                std::cout<<fileName<<":"<<lineNo<<" bad parameter override "<<ov<<"\n";
+                return false;
+            }
+            job._overrides.push_back(o);
+        }
+        if(job._fields.empty()){
+            for(int c = 0; c < NUM_OUTPUTS; c++){
+                job._fields.push_back(c);
+            }
+        }
+
+        if(fs::is_directory(job._input)){
+            // the .txt files in the directory and its subdirectories, the outputs go to the same
+            // subdirectories of the output directory
+            std::vector<fs::path> files;
+            for(const auto& f : fs::recursive_directory_iterator(job._input)){
+                if(f.is_regular_file() && f.path().extension() == ".txt"){
+                    files.push_back(fs::relative(f.path(), job._input));
+                }
+            }
+            if(files.empty()){
+                std::cout<<fileName<<":"<<lineNo<<" no .txt inputs in "<<job._input<<"\n";
+                return false;
+            }
+            std::sort(files.begin(), files.end());
+            std::string ext = fs::path(job._out).extension() == ".bin" ? ".bin" : ".csv";
+            for(const auto& f : files){
+                Job j = job;
+                j._input = (fs::path(job._input) / f).string();
+                fs::path out = fs::path(job._out) / f;
+                fs::create_directories(out.parent_path());
+                j._out = out.replace_extension(ext).string();
+                jobs.push_back(j);
+            }
+        }
+        else{
+            jobs.push_back(job);
+        }
+    }
+    return true;
+}
+
+
+// runs one job and writes the chosen outputs
+void runJob(const Job& job, const SharedData& shared){
+    VehicleParam veh_param = shared._vehs.at(job._veh);
+    TMeasyParam tire_param = shared._tires.at(job._tire);
+    const std::vector<Entry>& driverData = shared._inputs.at(job._input);
+
+    veh_param._step = 0.001;
+    tire_param._step = 0.001;
+    for(const Override& o : job._overrides){
+        if(o._name == "step"){
+            veh_param._step = o._scale ? veh_param._step * o._value : o._value;
+            tire_param._step = o._scale ? tire_param._step * o._value : o._value;
+            continue;
+        }
+        double* p = getParamPtr(veh_param, tire_param, o._name);
+        *p = o._scale ? *p * o._value : o._value;
+    }
+    double step = veh_param._step;
+
+    Simulator sim(veh_param, tire_param);
+    Driver_input input(driverData);
+    Controls controls;
+
+    double t = 0;
+    int timeStepNo = 0;
+    std::vector<double> row(job._fields.size());
+
+    // both formats get the initial state and then every decimation-th step
+    std::unique_ptr<Binary_writer> bin;
+    CSV_writer csv(",");
+    const int gear = outputIndex("current_gear");
+    if(fs::path(job._out).extension() == ".bin"){
+        std::vector<std::string> names;
+        for(int c : job._fields){
+            names.push_back(OUTPUT_NAMES[c]);
+        }
+        bin.reset(new Binary_writer(job._out, names, 1, job._single));
+    }
+    else{
+        csv.stream().setf(std::ios::scientific | std::ios::showpos);
+        csv.stream().precision(8);
+        for(int c : job._fields){
+            csv << OUTPUT_NAMES[c];
+        }
+        csv << std::endl;
+    }
+    auto writeRow = [&]{
+        if(bin){
+            for(size_t k = 0; k < job._fields.size(); k++){
+                row[k] = sim.getOutput(job._fields[k]);
+            }
+            bin->write(row);
+            return;
+        }
+        for(int c : job._fields){
+            // the gear is written as an integer
+            if(c == gear){
+                csv << sim.getVehicleState()._current_gr+1;
+            }
+            else{
+                csv << sim.getOutput(c);
+            }
+        }
+        csv << std::endl;
+    };
+
+    writeRow();
+    while(t < (job._endTime - step/10)){
+        getControls(controls, input, t);
+        sim.step(controls);
+        t += step;
+        timeStepNo += 1;
+
+        if(timeStepNo % job._decimation == 0){
+            writeRow();
+        }
+    }
+
+    if(!bin){
+        csv.write_to_file(job._out);
+    }
+}
+
+
+int main(int argc, char *argv[]){
+
+    if(argc < 2){
+        std::cout<<"Usage : "<<argv[0]<<" jobs.txt [num_threads]\n";
+        return 1;
+    }
+    unsigned int num_threads = (argc > 2) ? std::stoi(argv[2]) : 0;
+
+    std::vector<Job> jobs;
+    if(!readJobs(jobs, argv[1])){
+        return 1;
+    }
+
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+
+    // load every file once - the map entries are created here so that the pool only
+    // fills in existing entries
+    SharedData shared;
+    for(const Job& job : jobs){
+        shared._vehs[job._veh];
+        shared._tires[job._tire];
+        shared._inputs[job._input];
+    }
+    for(auto& v : shared._vehs){
+        setVehParamsJSON(v.second, v.first.c_str());
+    }
+    for(auto& t : shared._tires){
+        setTireParamsJSON(t.second, t.first.c_str());
+    }
+
+    ThreadPool pool(num_threads);
+    for(auto& in : shared._inputs){
+        std::vector<Entry>* data = &in.second;
+        const std::string* name = &in.first;
+        pool.submit([data, name]{ driverInput(*data, *name); });
+    }
+    pool.wait();
+    for(const auto& in : shared._inputs){
+        if(in.second.empty()){
+            std::cout<<"No driver inputs read from "<<in.first<<"\n";
+            return 1;
+        }
+    }
+
+    std::vector<double> job_times(jobs.size(), 0.);
+    for(size_t i = 0; i < jobs.size(); i++){
+        pool.submit([&jobs, &shared, &job_times, i]{
+            high_resolution_clock::time_point s = high_resolution_clock::now();
+            runJob(jobs[i], shared);
+            job_times[i] = duration<double, std::milli>(high_resolution_clock::now() - s).count();
+        });
+    }
+    pool.wait();
+
+    duration<double, std::milli> duration_sec = high_resolution_clock::now() - start;
+
+    double total = 0.;
+    for(double jt : job_times){
+        total += jt;
+    }
+    std::cout<<"Jobs : "<<jobs.size()<<"\n";
+    std::cout<<"Threads : "<<pool.size()<<"\n";
+    std::cout<<"Total time taken : "<<duration_sec.count()<<"\n";
+    std::cout<<"Sum of job times : "<<total<<"\n";
+
+    return 0;
+}
@@ -11,6 +11,7 @@ using namespace EightDOF;
 
 /*
 Test file for the eight DOF model with TMEasy implemented in c++
+Build with -DEDOF_PROFILE for the time taken by each stage of the step (see Profile.h)
 */
 
 
@@ -157,23 +158,6 @@ int main(int argc, char *argv[]){
     int timeStepNo = 0; // time step counter
     
 
-    high_resolution_clock::time_point start_veh_intg; 
-    high_resolution_clock::time_point end_veh_intg;
-    duration<double, std::milli> duration_sec_veh_intg;
-    double total_time_veh_intg = 0.;
-
-
-    high_resolution_clock::time_point start_tire_intg; 
-    high_resolution_clock::time_point end_tire_intg;
-    duration<double, std::milli> duration_sec_tire_intg;
-    double total_time_tire_intg = 0.;
-
-    high_resolution_clock::time_point start_pt_intg; 
-    high_resolution_clock::time_point end_pt_intg;
-    duration<double, std::milli> duration_sec_pt_intg;
-    double total_time_pt_intg = 0.;
-
-
 
 
 
@@ -189,8 +173,6 @@ int main(int argc, char *argv[]){
         vehToTireTransform(tirelf_st,tirerf_st,tirelr_st,tirerr_st,veh1_st,veh1_param,controls);
 
         // advance our 4 tires
-        // start_tire_intg =  high_resolution_clock::now();
-
         tireAdv(tirelf_st, tire_param, veh1_st, veh1_param, controls);
         tireAdv(tirerf_st, tire_param, veh1_st, veh1_param, controls);
 
@@ -199,19 +181,10 @@ int main(int argc, char *argv[]){
         tireAdv(tirelr_st, tire_param, veh1_st, veh1_param, mod_controls);
         tireAdv(tirerr_st, tire_param, veh1_st, veh1_param, mod_controls);
 
-        // end_tire_intg = high_resolution_clock::now();
-        // duration_sec_tire_intg = std::chrono::duration_cast<duration<double, std::milli>>(end_tire_intg - start_tire_intg);
-        // total_time_tire_intg += duration_sec_tire_intg.count();
-
         // Evalaute the powertrain and advance the tire angular velocities and the angular
         // velocity of the crank shaft (if we have Torque converter on)
-        // start_pt_intg = high_resolution_clock::now();
-
         evalPowertrain(veh1_st, tirelf_st, tirerf_st, tirelr_st, tirerr_st, veh1_param, tire_param, controls);
 
-        // end_pt_intg = high_resolution_clock::now();
-        // duration_sec_pt_intg = std::chrono::duration_cast<duration<double, std::milli>>(end_pt_intg - start_pt_intg);
-        // total_time_pt_intg += duration_sec_pt_intg.count(); 
         // transform tire forces to vehicle frame
         tireToVehTransform(tirelf_st,tirerf_st,tirelr_st,tirerr_st,veh1_st,veh1_param,controls);
 
@@ -220,15 +193,9 @@ int main(int argc, char *argv[]){
         std::vector<double> fy = {tirelf_st._fy,tirerf_st._fy,tirelr_st._fy,tirerr_st._fy};
         double huf = tirelf_st._rStat;
         double hur = tirerr_st._rStat;
-        
-        // start_veh_intg = high_resolution_clock::now();
 
         vehAdv(veh1_st,veh1_param, fx,fy,huf,hur);
 
-        // end_veh_intg = high_resolution_clock::now();
-        // duration_sec_veh_intg =  std::chrono::duration_cast<duration<double, std::milli>>(end_veh_intg - start_veh_intg);
-        // total_time_veh_intg += duration_sec_veh_intg.count();
-        
         t += step;
         timeStepNo += 1;
 
@@ -269,9 +236,6 @@ int main(int argc, char *argv[]){
 
     // Durations are converted to milliseconds already thanks to std::chrono::duration_cast
     std::cout<<"Total time taken : "<<duration_sec.count()<<"\n";
-    std::cout<<"Total time taken for tires : "<<total_time_tire_intg<<"\n";
-    std::cout<<"Total time taken for Vehicle : "<<total_time_veh_intg<<"\n";
-    std::cout<<"Total time taken for Powertrain : "<<total_time_pt_intg<<"\n";
 
 
     bool data_output = 1;
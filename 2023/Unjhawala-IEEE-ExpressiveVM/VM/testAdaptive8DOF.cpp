@@ -0,0 +1,142 @@
+#include <iostream>
+#include <stdint.h>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include "../utils.h"
+#include "Eightdof.h"
+#include "Simulator.h"
+#include "Adaptive.h"
+
+
+using std::chrono::high_resolution_clock;
+using std::chrono::duration;
+using namespace EightDOF;
+
+/*
+Test file for the adaptive integrator. Runs of the HMMWV (torque converter) and the dART are
+integrated with AdaptiveSimulator and with Simulator at the default step of 1e-3 s, and both
+are compared with Simulator at a step of 1e-5 s. Every adaptive run has to get to its end, follow
+the small step run at least as closely as the default step does and take fewer steps than it.
+Also reports the rejected steps, the right hand side evaluations and the run times
+Usage : ./testAdaptive
+*/
+
+// channels compared every SAMPLE seconds
+static const char* const CHANNELS[] = {"x", "y", "u", "v", "psi", "wz"};
+static const int NUM_CHANNELS = sizeof(CHANNELS) / sizeof(CHANNELS[0]);
+static const double SAMPLE = 0.1;
+
+// outputs of a fixed step run at every sample, returns the run time
+static double runFixed(std::vector<double>& out, VehicleParam v_params, TMeasyParam t_params,
+                        const std::vector<Entry>& driverData, double endTime, double step){
+    v_params._step = step;
+    t_params._step = step;
+    Simulator sim(v_params, t_params);
+    Driver_input input(driverData);
+    Controls controls;
+    int samples = int(endTime / SAMPLE + 0.5);
+    int every = int(SAMPLE / step + 0.5);
+    out.clear();
+    auto start = high_resolution_clock::now();
+    for(int s = 0; s < samples; s++){
+        for(int i = 0; i < every; i++){
+            getControls(controls, input, sim.getTime());
+            sim.step(controls);
+        }
+        for(int c = 0; c < NUM_CHANNELS; c++){
+            out.push_back(sim.getOutput(outputIndex(CHANNELS[c])));
+        }
+    }
+    duration<double> t = high_resolution_clock::now() - start;
+    return t.count();
+}
+
+// largest difference of every channel to the reference, relative to the largest value of the
+// channel in the reference (or 1)
+static double compare(const std::vector<double>& out, const std::vector<double>& ref){
+    double worst = 0.;
+    for(int c = 0; c < NUM_CHANNELS; c++){
+        double scale = 1., err = 0.;
+        for(size_t k = c; k < ref.size(); k += NUM_CHANNELS){
+            scale = std::max(scale, std::abs(ref[k]));
+            err = std::max(err, std::abs(out[k] - ref[k]));
+        }
+        worst = std::max(worst, err / scale);
+    }
+    return worst;
+}
+
+
+int main(int argc, char *argv[]){
+    int failures = 0;
+    struct Run{
+        const char* _veh;
+        const char* _tire;
+        const char* _input;
+        double _endTime;
+    };
+    Run runs[] = {
+        {"./jsons/HMMWV.json", "./jsons/TMeasy.json", "./inputs/ramp_10sec.txt", 10.},
+        {"./jsons/HMMWV.json", "./jsons/TMeasy.json", "./inputs/ramp_steer2.txt", 14.5},
+        {"./jsons/dART.json", "./jsons/dARTTM.json", "./inputs/acc3.txt", 10.},
+        {"./jsons/dART.json", "./jsons/dARTTM.json", "./inputs/st.txt", 10.}
+    };
+    for(const Run& r : runs){
+        VehicleParam v_params;
+        TMeasyParam t_params;
+        setVehParamsJSON(v_params, r._veh);
+        setTireParamsJSON(t_params, r._tire);
+        std::vector<Entry> driverData;
+        driverInput(driverData, r._input);
+
+        std::vector<double> ref, fixed, adaptive;
+        runFixed(ref, v_params, t_params, driverData, r._endTime, 1e-5);
+        double timeFixed = runFixed(fixed, v_params, t_params, driverData, r._endTime, 1e-3);
+
+        AdaptiveSimulator sim(v_params, t_params);
+        bool ok = true;
+        int samples = int(r._endTime / SAMPLE + 0.5);
+        auto start = high_resolution_clock::now();
+        for(int s = 1; s <= samples && ok; s++){
+            ok = sim.advance(driverData, SAMPLE * s);
+            for(int c = 0; c < NUM_CHANNELS; c++){
+                adaptive.push_back(sim.getOutput(outputIndex(CHANNELS[c])));
+            }
+        }
+        duration<double> timeAdaptive = high_resolution_clock::now() - start;
+        for(int c = 0; c < NUM_OUTPUTS; c++){
+            if(!std::isfinite(sim.getOutput(c))){
+                std::cout<<r._veh<<" "<<r._input<<" : "<<OUTPUT_NAMES[c]<<" is not finite at t = "<<sim.getTime()<<"\n";
+                failures++;
+            }
+        }
+        const AdaptiveStats& stats = sim.getStats();
+        if(!ok){
+            std::cout<<r._veh<<" "<<r._input<<" : the adaptive run stopped at t = "<<sim.getTime()<<" after "
+                     <<stats._steps<<" steps\n";
+            failures++;
+            continue;
+        }
+
+        int stepsFixed = int(r._endTime / 1e-3 + 0.5);
+        double errFixed = compare(fixed, ref);
+        double errAdaptive = compare(adaptive, ref);
+        std::cout<<r._veh<<" "<<r._input<<" : difference to 1e-5 s steps - adaptive "<<errAdaptive
+                 <<", 1e-3 s steps "<<errFixed<<"\n"
+                 <<"    adaptive "<<stats._steps<<" steps ("<<stats._rejected<<" rejected, "
+                 <<stats._events<<" on events), "
+                 <<stats._rhsEvals<<" evaluations, "<<timeAdaptive.count() * 1e3<<" ms - 1e-3 s steps "
+                 <<stepsFixed<<" steps, "<<timeFixed * 1e3<<" ms\n";
+        if(!(errAdaptive <= errFixed)){
+            failures++;
+        }
+        if(stats._steps >= (unsigned long)stepsFixed){
+            std::cout<<"the adaptive run takes no fewer steps than the 1e-3 s one\n";
+            failures++;
+        }
+    }
+
+    std::cout<<(failures == 0 ? "passed" : "FAILED")<<"\n";
+    return failures == 0 ? 0 : 1;
+}
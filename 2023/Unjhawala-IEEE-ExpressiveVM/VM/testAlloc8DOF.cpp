@@ -0,0 +1,109 @@
+#include <iostream>
+#include <stdint.h>
+#include <cstdlib>
+#include <new>
+#include "../utils.h"
+#include "Eightdof.h"
+#include "Simulator.h"
+
+using namespace EightDOF;
+
+/*
+Test file that checks that Simulator::step does not allocate on the heap, nor does copying
+parameters from the cache into structures that already hold them. The global operator new
+is replaced by one that counts the allocations. Returns 1 if any allocation happens inside
+the time loop or the copies
+*/
+
+static size_t num_allocations = 0;
+
+void* operator new(std::size_t size){
+    num_allocations++;
+    void* p = std::malloc(size == 0 ? 1 : size);
+    if(!p){
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept{
+    std::free(p);
+}
+
+
+// runs the simulator over the whole input file and returns the number of allocations
+// that happened inside the time loop
+size_t countStepAllocations(const std::string& fileName, const char* vehParamsJSON, const char* tireParamsJSON, double endTime){
+
+    std::vector<Entry> driverData;
+    driverInput(driverData, fileName);
+
+    VehicleParam veh_param;
+    setVehParamsJSON(veh_param, vehParamsJSON);
+    TMeasyParam tire_param;
+    setTireParamsJSON(tire_param, tireParamsJSON);
+
+    veh_param._step = 0.001;
+    tire_param._step = 0.001;
+    double step = veh_param._step;
+
+    Simulator sim(veh_param, tire_param);
+    Controls controls;
+
+    size_t before = num_allocations;
+    double t = 0;
+    while(t < (endTime - step/10)){
+        getControls(controls, driverData, t);
+        sim.step(controls);
+        t += step;
+    }
+    return num_allocations - before;
+}
+
+
+// copies the cached parameters into the same structures a number of times, as the setup of the
+// samples of a calibration does, and returns the number of allocations after the first copy
+size_t countCloneAllocations(const char* vehParamsJSON, const char* tireParamsJSON){
+    VehicleParam veh_param;
+    TMeasyParam tire_param;
+    setVehParamsCached(veh_param, vehParamsJSON);
+    setTireParamsCached(tire_param, tireParamsJSON);
+
+    size_t before = num_allocations;
+    for(int i = 0; i < 100; i++){
+        setVehParamsCached(veh_param, vehParamsJSON);
+        setTireParamsCached(tire_param, tireParamsJSON);
+    }
+    return num_allocations - before;
+}
+
+
+int main(int argc, char *argv[]){
+
+    // HMMWV with the torque converter and the dART with the non linear steering map
+    size_t hmmwv = countStepAllocations("./inputs/ramp_steer2.txt", "./jsons/HMMWV.json", "./jsons/TMeasy.json", 14.5);
+    size_t dart = countStepAllocations("./inputs/multi_run_acc/ramp/test0.txt", "../calibration/ART/jsons/dART_play.json",
+                                        "../calibration/ART/jsons/dARTTM_play.json", 12.);
+
+    std::cout<<"Allocations in the time loop (HMMWV) : "<<hmmwv<<"\n";
+    std::cout<<"Allocations in the time loop (dART) : "<<dart<<"\n";
+
+    size_t clones = countCloneAllocations("./jsons/HMMWV.json", "./jsons/TMeasy.json") +
+                    countCloneAllocations("../calibration/ART/jsons/dART_play.json", "../calibration/ART/jsons/dARTTM_play.json");
+    std::cout<<"Allocations copying cached parameters : "<<clones<<"\n";
+
+    if(hmmwv != 0 || dart != 0){
+        std::cout<<"FAILED - Simulator::step allocates\n";
+        return 1;
+    }
+    if(clones != 0){
+        std::cout<<"FAILED - copying the cached parameters allocates\n";
+        return 1;
+    }
+    std::cout<<"PASSED\n";
+    return 0;
+}
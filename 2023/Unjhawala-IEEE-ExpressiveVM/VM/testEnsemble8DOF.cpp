@@ -0,0 +1,207 @@
+#include <iostream>
+#include <stdint.h>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include "../utils.h"
+#include "Eightdof.h"
+#include "Simulator.h"
+#include "Ensemble.h"
+
+
+using std::chrono::high_resolution_clock;
+using std::chrono::duration;
+using namespace EightDOF;
+
+/*
+Test file for the ensemble version of the eight DOF model. Runs an ensemble of vehicles
+with perturbed tire parameters, checks a few of them against the scalar model and the
+Simulator run with the same parameters and compares the vehicles per second. The vehicles
+have to match bit for bit, unless the ensemble is built with -DEDOF_VECTOR_MATH (see Lanes.h)
+Usage : ./testEnsemble [number of vehicles]
+*/
+
+
+// scalar parameters of ensemble member i - tire stiffness and peak forces scaled
+// by up to +-10 % across the ensemble
+void memberParams(VehicleParam& veh_param, TMeasyParam& tire_param, int i, int n){
+    double theta = 1. + 0.2 * ((double)i / n - 0.5);
+    tire_param._dfy0Pn = tire_param._dfy0Pn * theta;
+    tire_param._dfy0P2n = tire_param._dfy0P2n * theta;
+    tire_param._fxmPn = tire_param._fxmPn * theta;
+    tire_param._fxmP2n = tire_param._fxmP2n * theta;
+    veh_param._lossesScale = theta;
+}
+
+// scalar run - exactly the loop in test8DOF.cpp. Stores the states every 10 steps in out
+void runScalar(const std::vector<Entry>& driverData, VehicleParam veh1_param, TMeasyParam tire_param,
+                double endTime, std::vector<double>& out){
+
+    std::vector <double> controls(4,0);
+    VehicleState veh1_st;
+    vehInit(veh1_st,veh1_param);
+    TMeasyState tirelf_st, tirerf_st, tirelr_st, tirerr_st;
+    double step = veh1_param._step;
+    std::vector<Entry> data = driverData;
+
+    double t = 0;
+    int timeStepNo = 0;
+    while(t < (endTime - step/10)){
+        getControls(controls, data, t);
+        vehToTireTransform(tirelf_st,tirerf_st,tirelr_st,tirerr_st,veh1_st,veh1_param,controls);
+        tireAdv(tirelf_st, tire_param, veh1_st, veh1_param, controls);
+        tireAdv(tirerf_st, tire_param, veh1_st, veh1_param, controls);
+        std::vector <double> mod_controls = {controls[0],0,controls[2],controls[3]};
+        tireAdv(tirelr_st, tire_param, veh1_st, veh1_param, mod_controls);
+        tireAdv(tirerr_st, tire_param, veh1_st, veh1_param, mod_controls);
+        evalPowertrain(veh1_st, tirelf_st, tirerf_st, tirelr_st, tirerr_st, veh1_param, tire_param, controls);
+        tireToVehTransform(tirelf_st,tirerf_st,tirelr_st,tirerr_st,veh1_st,veh1_param,controls);
+        std::vector<double> fx = {tirelf_st._fx,tirerf_st._fx,tirelr_st._fx,tirerr_st._fx};
+        std::vector<double> fy = {tirelf_st._fy,tirerf_st._fy,tirelr_st._fy,tirerr_st._fy};
+        vehAdv(veh1_st,veh1_param, fx,fy,tirelf_st._rStat,tirerr_st._rStat);
+        t += step;
+        timeStepNo += 1;
+        if(timeStepNo % 10 == 0){
+            double row[] = {veh1_st._x, veh1_st._y, veh1_st._u, veh1_st._v, veh1_st._phi, veh1_st._psi,
+                            veh1_st._wx, veh1_st._wz, tirelf_st._omega, tirerf_st._omega, tirelr_st._omega, tirerr_st._omega};
+            out.insert(out.end(), row, row + 12);
+        }
+    }
+}
+
+
+int main(int argc, char *argv[]){
+
+    int n = 256;
+    if(argc > 1){
+        n = std::atoi(argv[1]);
+    }
+
+    std::string fileName = "./inputs/ramp_steer2.txt";
+    // std::string fileName = "./inputs/acc3.txt";
+
+    char *vehParamsJSON = (char *)"./jsons/HMMWV.json";
+    char *tireParamsJSON = (char *)"./jsons/TMeasy.json";
+
+    double endTime = 14.5;
+
+    std::vector<Entry> driverData;
+    driverInput(driverData, fileName);
+
+    VehicleParam veh_param;
+    setVehParamsJSON(veh_param,vehParamsJSON);
+    TMeasyParam tire_param;
+    setTireParamsJSON(tire_param,tireParamsJSON);
+    tireInit(tire_param);
+
+    veh_param._step = 0.001;
+    tire_param._step = 0.001;
+    double step = veh_param._step;
+
+    // set up the ensemble
+    Ensemble ensemble(n, veh_param, tire_param);
+    for(int i = 0; i < n; i++){
+        VehicleParam v = veh_param;
+        TMeasyParam tp = tire_param;
+        memberParams(v, tp, i, n);
+        ensemble.setParams(i, v, tp);
+    }
+    ensemble.reset();
+
+    // members that are checked against the scalar model
+    int check[3] = {0, n/2, n-1};
+    std::vector<double> ref[3];
+    std::vector<double> sim_out[3];
+    std::vector<double> ens_out[3];
+
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+    for(int k = 0; k < 3; k++){
+        VehicleParam v = veh_param;
+        TMeasyParam tp = tire_param;
+        memberParams(v, tp, check[k], n);
+        runScalar(driverData, v, tp, endTime, ref[k]);
+    }
+    high_resolution_clock::time_point end = high_resolution_clock::now();
+    double scalar_ms = std::chrono::duration_cast<duration<double, std::milli>>(end - start).count() / 3.;
+
+    // the same vehicles in a Simulator
+    Controls controls;
+    start = high_resolution_clock::now();
+    for(int k = 0; k < 3; k++){
+        VehicleParam v = veh_param;
+        TMeasyParam tp = tire_param;
+        memberParams(v, tp, check[k], n);
+        Simulator sim(v, tp);
+        double t = 0;
+        int timeStepNo = 0;
+        while(t < (endTime - step/10)){
+            getControls(controls, driverData, t);
+            sim.step(controls);
+            t += step;
+            timeStepNo += 1;
+            if(timeStepNo % 10 == 0){
+                const VehicleState& vs = sim.getVehicleState();
+                double row[] = {vs._x, vs._y, vs._u, vs._v, vs._phi, vs._psi, vs._wx, vs._wz,
+                                sim.getTireState(0)._omega, sim.getTireState(1)._omega,
+                                sim.getTireState(2)._omega, sim.getTireState(3)._omega};
+                sim_out[k].insert(sim_out[k].end(), row, row + 12);
+            }
+        }
+    }
+    end = high_resolution_clock::now();
+    double simulator_ms = std::chrono::duration_cast<duration<double, std::milli>>(end - start).count() / 3.;
+
+    VehicleState v_st;
+    TMeasyState tires[4];
+    double t = 0;
+    int timeStepNo = 0;
+    start = high_resolution_clock::now();
+    while(t < (endTime - step/10)){
+        getControls(controls, driverData, t);
+        ensemble.step(controls);
+        t += step;
+        timeStepNo += 1;
+
+        if(timeStepNo % 10 == 0){
+            for(int k = 0; k < 3; k++){
+                ensemble.getState(check[k], v_st, tires);
+                double row[] = {v_st._x, v_st._y, v_st._u, v_st._v, v_st._phi, v_st._psi, v_st._wx, v_st._wz,
+                                tires[0]._omega, tires[1]._omega, tires[2]._omega, tires[3]._omega};
+                ens_out[k].insert(ens_out[k].end(), row, row + 12);
+            }
+        }
+    }
+    end = high_resolution_clock::now();
+    double ensemble_ms = std::chrono::duration_cast<duration<double, std::milli>>(end - start).count();
+
+    // compare
+    double max_diff = 0.;
+    size_t mismatches = 0;
+    for(int k = 0; k < 3; k++){
+        for(size_t j = 0; j < ref[k].size(); j++){
+            double d = std::max(std::abs(ref[k][j] - ens_out[k][j]), std::abs(sim_out[k][j] - ens_out[k][j]));
+            max_diff = std::max(max_diff, d);
+            if(ref[k][j] != ens_out[k][j] || sim_out[k][j] != ens_out[k][j]){
+                mismatches++;
+            }
+        }
+    }
+
+    std::cout<<"Vehicles : "<<n<<" in blocks of "<<ENSEMBLE_LANES<<"\n";
+    std::cout<<"Scalar time per vehicle (ms) : "<<scalar_ms<<"\n";
+    std::cout<<"Simulator time per vehicle (ms) : "<<simulator_ms<<"\n";
+    std::cout<<"Ensemble time per vehicle (ms) : "<<ensemble_ms / n<<"\n";
+    std::cout<<"Speed up over the scalar loop : "<<scalar_ms / (ensemble_ms / n)<<"\n";
+    std::cout<<"Speed up over the Simulator : "<<simulator_ms / (ensemble_ms / n)<<"\n";
+    std::cout<<"Max abs difference to scalar : "<<max_diff<<"\n";
+    std::cout<<"Values not bit identical : "<<mismatches<<"\n";
+
+#ifdef EDOF_VECTOR_MATH
+    // the vector math functions are a few ulp off, which the runs amplify over time
+    bool ok = max_diff < 1e-3;
+#else
+    bool ok = mismatches == 0;
+#endif
+    std::cout<<(ok ? "passed" : "FAILED")<<"\n";
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+#include <iostream>
+#include <stdint.h>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include "../utils.h"
+#include "Eightdof.h"
+#include "Simulator.h"
+#include "Batch.h"
+
+
+using std::chrono::high_resolution_clock;
+using std::chrono::duration;
+using namespace EightDOF;
+
+/*
+Test file for the derivatives of the trajectories with respect to the parameters (simulateGradient).
+The outputs have to be exactly those of simulateBatch and the derivatives are compared to
+central finite differences of simulateBatch runs.
+Usage : ./testGradient [input file] [end time]
+*/
+
+
+int main(int argc, char *argv[]){
+
+    std::string fileName = "./inputs/ramp_steer2.txt";
+    double endTime = 14.5;
+    if(argc > 2){
+        fileName = argv[1];
+        endTime = std::atof(argv[2]);
+    }
+
+    char *vehParamsJSON = (char *)"./jsons/HMMWV.json";
+    char *tireParamsJSON = (char *)"./jsons/TMeasy.json";
+
+    std::vector<Entry> driverData;
+    driverInput(driverData, fileName);
+
+    VehicleParam veh_param;
+    setVehParamsJSON(veh_param,vehParamsJSON);
+    TMeasyParam tire_param;
+    setTireParamsJSON(tire_param,tireParamsJSON);
+    veh_param._step = 0.001;
+    tire_param._step = 0.001;
+
+    // the parameter groups of the HMMWV calibration
+    std::vector<std::string> specs = {"dfy0Pn,dfy0P2n", "fymPn,fymP2n,maxSteer", "dfx0Pn,dfx0P2n",
+                                      "fxmPn,fxmP2n,lossesMapScale", "", "torqueMapScale"};
+    std::vector<double> theta = {1.05, 0.95, 1.1, 0.9, 1., 1.02};
+    ParamGroups groups;
+    std::string bad;
+    parseParamGroups(groups, specs, bad);
+    size_t numGroups = specs.size();
+
+    std::vector<std::string> names = {"u", "v", "psi", "wz", "wlf", "engine_omega"};
+    std::vector<int> outputs;
+    for(const std::string& name : names){
+        outputs.push_back(outputIndex(name));
+    }
+    int decimation = 10;
+    int nSamples = batchSamples(endTime, veh_param._step, decimation);
+    size_t nOut = outputs.size();
+
+    std::vector<double> ref(nOut * nSamples);
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+    simulateBatch(ref.data(), veh_param, tire_param, driverData, endTime, groups, theta.data(), 1, outputs, decimation, 1);
+    high_resolution_clock::time_point end = high_resolution_clock::now();
+    double run_ms = std::chrono::duration_cast<duration<double, std::milli>>(end - start).count();
+
+    std::vector<double> out(nOut * nSamples);
+    std::vector<double> grad(nOut * numGroups * nSamples);
+    start = high_resolution_clock::now();
+    simulateGradient(out.data(), grad.data(), veh_param, tire_param, driverData, endTime, groups, theta.data(), outputs, decimation);
+    end = high_resolution_clock::now();
+    double grad_ms = std::chrono::duration_cast<duration<double, std::milli>>(end - start).count();
+
+    size_t mismatches = 0;
+    for(size_t j = 0; j < ref.size(); j++){
+        if(ref[j] != out[j]){
+            mismatches++;
+        }
+    }
+
+    // central differences - theta +- h for every group, the 2 runs of a group in one batch
+    double h = 1e-6;
+    double worst = 0.;
+    std::vector<double> fd(nOut * 2 * nSamples);
+    for(size_t g = 0; g < numGroups; g++){
+        std::vector<double> th(2 * numGroups);
+        for(size_t k = 0; k < numGroups; k++){
+            th[k] = th[numGroups + k] = theta[k];
+        }
+        th[g] += h;
+        th[numGroups + g] -= h;
+        simulateBatch(fd.data(), veh_param, tire_param, driverData, endTime, groups, th.data(), 2, outputs, decimation, 1);
+
+        for(size_t o = 0; o < nOut; o++){
+            // error relative to the largest derivative of the channel
+            double scale = 0., err = 0.;
+            for(int s = 0; s < nSamples; s++){
+                double d_fd = (fd[(o*2)*nSamples + s] - fd[(o*2 + 1)*nSamples + s]) / (2. * h);
+                double d_ad = grad[(o*numGroups + g)*nSamples + s];
+                scale = std::max(scale, std::abs(d_fd));
+                err = std::max(err, std::abs(d_fd - d_ad));
+            }
+            // a derivative that is 0 (lateral parameters on a straight line run) only shows the
+            // round off of the finite differences, so small ones are compared absolutely
+            double rel = err / std::max(scale, 1e-4);
+            worst = std::max(worst, rel);
+            std::cout<<"d "<<names[o]<<" / d theta["<<g<<"] ("<<specs[g]<<") : max |d| "<<scale
+                     <<", relative difference to finite differences "<<rel<<"\n";
+        }
+    }
+
+    std::cout<<"Time of a run (ms) : "<<run_ms<<"\n";
+    std::cout<<"Time of a run with the derivatives (ms) : "<<grad_ms<<"\n";
+    std::cout<<"Outputs not bit identical : "<<mismatches<<"\n";
+    std::cout<<"Worst relative difference to finite differences : "<<worst<<"\n";
+
+    return (mismatches == 0 && worst < 1e-3) ? 0 : 1;
+}
@@ -0,0 +1,188 @@
+#include <iostream>
+#include <stdint.h>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <filesystem>
+#include "../utils.h"
+
+
+using std::chrono::high_resolution_clock;
+using std::chrono::duration;
+
+/*
+Test file for reading the driver inputs. driverInput has to give exactly the entries of the
+getline and istringstream parser it replaced, for every .txt file in the input folders, and so
+does its binary cache. The controls of Driver_input, in memory and streamed from the file in
+small chunks, have to be exactly those of getControls - at every step of a run, on the entries
+themselves, outside the inputs and at times that jump back and forth.
+Usage : ./testInput [input file] [end time]
+*/
+
+
+// the parser driverInput had before
+static void driverInputStream(std::vector<Entry>& m_data, const std::string& filename){
+    std::ifstream ifile(filename.c_str());
+    std::string line;
+    while(std::getline(ifile,line)){
+        std::istringstream iss(line);
+        double time, steering, throttle, braking;
+        iss >> time >> steering >> throttle >> braking;
+        if (iss.fail())
+            break;
+        m_data.push_back(Entry(time,steering,throttle,braking));
+    }
+}
+
+// false if the entries differ in any bit
+static bool sameEntries(const std::vector<Entry>& a, const std::vector<Entry>& b){
+    if(a.size() != b.size()){
+        return false;
+    }
+    for(size_t i = 0; i < a.size(); i++){
+        if(a[i].m_time != b[i].m_time || a[i].m_steering != b[i].m_steering ||
+           a[i].m_throttle != b[i].m_throttle || a[i].m_braking != b[i].m_braking){
+            return false;
+        }
+    }
+    return true;
+}
+
+// number of lookups where a Driver_input differs from getControls
+static size_t compare(Driver_input& input, const std::vector<Entry>& driverData, const std::vector<double>& times){
+    size_t mismatches = 0;
+    double ref[4], cur[4];
+    for(double t : times){
+        getControls(ref, driverData, t);
+        input.getControls(cur, t);
+        for(int k = 0; k < 4; k++){
+            if(ref[k] != cur[k]){
+                mismatches++;
+                break;
+            }
+        }
+    }
+    return mismatches;
+}
+
+
+int main(int argc, char *argv[]){
+
+    std::string fileName = "./inputs/ramp_steer2.txt";
+    double endTime = 14.5;
+    if(argc > 2){
+        fileName = argv[1];
+        endTime = std::atof(argv[2]);
+    }
+
+    // the parser on all the driver inputs, with lines the stream rejects or reads partly
+    std::vector<std::string> files = {"./testInput_odd.txt"};
+    {
+        std::ofstream odd(files[0]);
+        odd << "0 +0.5 1e-3 0\n\t.5 -.25 1.E1 0 trailing words\r\n1 2 3 4";
+        odd << "\n1.5 1e 0 0\n2 0 0 0\n";
+    }
+    for(const char* dir : {"./inputs", "../calibration/ART/inputs"}){
+        if(!std::filesystem::is_directory(dir)){
+            continue;
+        }
+        for(const auto& f : std::filesystem::recursive_directory_iterator(dir)){
+            if(f.is_regular_file() && f.path().extension() == ".txt"){
+                files.push_back(f.path().string());
+            }
+        }
+    }
+    size_t parseMismatches = 0, cacheMismatches = 0;
+    double stream_ms = 0, parse_ms = 0, cache_ms = 0;
+    for(const std::string& f : files){
+        std::vector<Entry> ref, parsed, cached, cachedAgain;
+        high_resolution_clock::time_point t0 = high_resolution_clock::now();
+        driverInputStream(ref, f);
+        high_resolution_clock::time_point t1 = high_resolution_clock::now();
+        driverInput(parsed, f);
+        high_resolution_clock::time_point t2 = high_resolution_clock::now();
+        std::string cacheName = f + ".edofcache";
+        std::filesystem::remove(cacheName);
+        driverInput(cached, f, true);
+        high_resolution_clock::time_point t3 = high_resolution_clock::now();
+        driverInput(cachedAgain, f, true);
+        high_resolution_clock::time_point t4 = high_resolution_clock::now();
+        std::filesystem::remove(cacheName);
+
+        stream_ms += std::chrono::duration_cast<duration<double, std::milli>>(t1 - t0).count();
+        parse_ms += std::chrono::duration_cast<duration<double, std::milli>>(t2 - t1).count();
+        cache_ms += std::chrono::duration_cast<duration<double, std::milli>>(t4 - t3).count();
+        if(!sameEntries(ref, parsed)){
+            std::cout<<"driverInput differs from the stream parser for "<<f<<"\n";
+            parseMismatches++;
+        }
+        if(!sameEntries(ref, cached) || !sameEntries(ref, cachedAgain)){
+            std::cout<<"cached driverInput differs for "<<f<<"\n";
+            cacheMismatches++;
+        }
+    }
+    std::filesystem::remove(files[0]);
+    std::cout<<"Files read : "<<files.size()<<", differing : "<<parseMismatches<<", with the cache : "<<cacheMismatches<<"\n";
+    std::cout<<"Time to read them (ms) - stream : "<<stream_ms<<", driverInput : "<<parse_ms
+             <<", from the cache : "<<cache_ms<<"\n";
+
+    std::vector<Entry> driverData;
+    driverInput(driverData, fileName);
+    if(driverData.empty()){
+        std::cout<<"No driver inputs in "<<fileName<<"\n";
+        return 1;
+    }
+
+    // the times of a run with a 1 ms step, past the end of the inputs
+    double step = 0.001;
+    std::vector<double> run;
+    for(double t = 0; t < (endTime + 1. - step/10); t += step){
+        run.push_back(t);
+    }
+
+    // the entries themselves, before the first one and times in random order
+    std::vector<double> jumps;
+    for(const Entry& e : driverData){
+        jumps.push_back(e.m_time);
+    }
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> dist(driverData[0].m_time - 1., driverData.back().m_time + 1.);
+    for(int i = 0; i < 2000; i++){
+        jumps.push_back(dist(gen));
+    }
+
+    size_t mismatches = 0;
+    for(size_t chunk : {size_t(1), size_t(3), size_t(4096)}){
+        Driver_input memory(driverData);
+        Driver_input streamed(fileName, chunk);
+        mismatches += compare(memory, driverData, run) + compare(streamed, driverData, run);
+        mismatches += compare(memory, driverData, jumps) + compare(streamed, driverData, jumps);
+    }
+    std::cout<<"Lookups not bit identical : "<<mismatches<<"\n";
+
+    // time of a run with both
+    double c[4];
+    double sum = 0;
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+    for(double t : run){
+        getControls(c, driverData, t);
+        sum += c[1];
+    }
+    high_resolution_clock::time_point end = high_resolution_clock::now();
+    double search_ns = std::chrono::duration_cast<duration<double, std::nano>>(end - start).count() / run.size();
+
+    Driver_input input(driverData);
+    start = high_resolution_clock::now();
+    for(double t : run){
+        input.getControls(c, t);
+        sum -= c[1];
+    }
+    end = high_resolution_clock::now();
+    double cursor_ns = std::chrono::duration_cast<duration<double, std::nano>>(end - start).count() / run.size();
+
+    std::cout<<"Entries : "<<driverData.size()<<", lookups : "<<run.size()<<" ("<<sum<<")\n";
+    std::cout<<"getControls (ns per lookup) : "<<search_ns<<"\n";
+    std::cout<<"Driver_input (ns per lookup) : "<<cursor_ns<<"\n";
+
+    return (mismatches == 0 && parseMismatches == 0 && cacheMismatches == 0) ? 0 : 1;
+}
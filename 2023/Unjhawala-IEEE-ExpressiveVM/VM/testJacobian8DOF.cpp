@@ -0,0 +1,241 @@
+#include <iostream>
+#include <stdint.h>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include "../utils.h"
+#include "Eightdof.h"
+#include "Simulator.h"
+#include "Jacobian.h"
+
+
+using std::chrono::high_resolution_clock;
+using std::chrono::duration;
+using namespace EightDOF;
+
+/*
+Test file for the step Jacobian. At points along runs of the HMMWV (torque converter) and the
+dART (throttle modulation), StepJacobian::step has to advance the states exactly as
+Simulator::step does, the step must not depend on anything but the packed states (and the
+gear), and every column of the Jacobians has to match central differences of Simulator::step.
+The time of a Jacobian is reported against that of a step and may not exceed MAX_STEPS steps.
+Usage : ./testJacobian
+*/
+
+static const int NX = StepJacobian::NUM_STATES;
+static const int NU = StepJacobian::NUM_CONTROLS;
+static const double MAX_STEPS = 20.;
+
+
+// packed states after one Simulator::step from s with the controls
+static void stepFrom(double* x, Simulator& sim, const SimulatorSnapshot& s, const Controls& controls){
+    sim.restore(s);
+    sim.step(controls);
+    StepJacobian::pack(x, sim.getVehicleState(), &sim.getTireState(0));
+}
+
+// central differences of column j (a state, then the controls) with the step h times the scale
+// of the entry, and the largest difference between the two one sided ones relative to fd
+static void centralDifference(double* fd, double& sides, Simulator& sim, const SimulatorSnapshot& s,
+                                const Controls& controls, int j, double h){
+    double x0[NX], xp[NX], xm[NX], xs[NX];
+    StepJacobian::pack(x0, s._v_states, s._tires);
+    stepFrom(xs, sim, s, controls);
+    SimulatorSnapshot p = s, m = s;
+    Controls cp = controls, cm = controls;
+    if(j < NX){
+        h *= std::max(1., std::abs(x0[j]));
+        double x[NX];
+        std::copy(x0, x0 + NX, x);
+        x[j] = x0[j] + h;
+        StepJacobian::unpack(x, p._v_states, p._tires);
+        x[j] = x0[j] - h;
+        StepJacobian::unpack(x, m._v_states, m._tires);
+    }
+    else{
+        double* up[NU] = {&cp._steering, &cp._throttle, &cp._braking};
+        double* um[NU] = {&cm._steering, &cm._throttle, &cm._braking};
+        *up[j - NX] += h;
+        *um[j - NX] -= h;
+    }
+    stepFrom(xp, sim, p, cp);
+    stepFrom(xm, sim, m, cm);
+    sides = 0.;
+    for(int i = 0; i < NX; i++){
+        fd[i] = (xp[i] - xm[i]) / (2. * h);
+        double forward = (xp[i] - xs[i]) / h, backward = (xs[i] - xm[i]) / h;
+        sides = std::max(sides, std::abs(forward - backward) / std::max(1., std::abs(fd[i])));
+    }
+}
+
+// largest difference between A, B and central differences, relative to the largest entry of
+// each column (or 1). Columns where two step sizes or the two sides do not agree are across a
+// jump or a kink of the model (a sign change, a clamp), where the derivative is one sided, and
+// do not count
+static double compareDifferences(Simulator& sim, const SimulatorSnapshot& s, const Controls& controls,
+                                    const double* A, const double* B, int& skipped){
+    double worst = 0.;
+    for(int j = 0; j < NX + NU; j++){
+        double fd[NX], fd4[NX], sides = 0., sides4 = 0.;
+        centralDifference(fd, sides, sim, s, controls, j, 1e-6);
+        centralDifference(fd4, sides4, sim, s, controls, j, 4e-6);
+        double scale = 1., err = 0., smooth = 0.;
+        for(int i = 0; i < NX; i++){
+            double ad = j < NX ? A[i*NX + j] : B[i*NU + j - NX];
+            scale = std::max(scale, std::abs(ad));
+            err = std::max(err, std::abs(ad - fd[i]));
+            smooth = std::max(smooth, std::abs(fd[i] - fd4[i]) / std::max(1., std::abs(fd[i])));
+        }
+        if(smooth > 1e-4 || sides4 > 1e-2){
+            skipped++;
+            continue;
+        }
+        worst = std::max(worst, err / scale);
+    }
+    return worst;
+}
+
+// checks the Jacobian along a run, returns the number of failures
+static int checkRun(const char* vehJSON, const char* tireJSON, const std::string& fileName, double endTime,
+                    int checks, double& worst, int& skipped, double& timeStep, double& timeJacobian){
+    VehicleParam v_params;
+    TMeasyParam t_params;
+    setVehParamsJSON(v_params, vehJSON);
+    setTireParamsJSON(t_params, tireJSON);
+    v_params._step = 0.001;
+    t_params._step = 0.001;
+    std::vector<Entry> driverData;
+    driverInput(driverData, fileName);
+
+    Simulator sim(v_params, t_params), other(v_params, t_params);
+    StepJacobian jac(v_params, t_params);
+    Driver_input input(driverData);
+    Controls controls;
+    double A[NX*NX], B[NX*NU];
+    int failures = 0;
+    int steps = int(endTime / v_params._step + 0.5);
+    int every = steps / checks;
+    for(int i = 0; i < steps; i++){
+        getControls(controls, input, sim.getTime());
+        if(i % every != every / 2){
+            sim.step(controls);
+            continue;
+        }
+        SimulatorSnapshot s;
+        sim.snapshot(s);
+
+        // the same states as the step
+        other.restore(s);
+        jac.step(other, controls, A, B);
+        sim.step(controls);
+        double xa[NX], xb[NX];
+        StepJacobian::pack(xa, sim.getVehicleState(), &sim.getTireState(0));
+        StepJacobian::pack(xb, other.getVehicleState(), &other.getTireState(0));
+        bool same = other.getTime() == sim.getTime();
+        for(int k = 0; k < NX; k++){
+            same = same && xa[k] == xb[k];
+        }
+        for(int c = 1; c < NUM_OUTPUTS; c++){
+            same = same && sim.getOutput(c) == other.getOutput(c);
+        }
+        if(!same){
+            std::cout<<fileName<<" : the states differ from Simulator::step at t = "<<s._time<<"\n";
+            failures++;
+        }
+
+        // nothing but the packed states and the gear is carried over
+        SimulatorSnapshot bare = s;
+        bare._v_states = VehicleState();
+        bare._v_states._current_gr = s._v_states._current_gr;
+        for(int k = 0; k < 4; k++){
+            bare._tires[k] = TMeasyState();
+        }
+        double x0[NX];
+        StepJacobian::pack(x0, s._v_states, s._tires);
+        StepJacobian::unpack(x0, bare._v_states, bare._tires);
+        stepFrom(xb, other, bare, controls);
+        for(int k = 0; k < NX; k++){
+            if(xa[k] != xb[k]){
+                std::cout<<fileName<<" : the step depends on more than the packed states at t = "<<s._time<<"\n";
+                failures++;
+                break;
+            }
+        }
+
+        // standing still at zero slip the force characteristic of the model has no slope (see
+        // Jacobian.h), while the differences see that of the slightest slip
+        bool standing = s._v_states._u == 0.;
+        for(int k = 0; k < 4; k++){
+            standing = standing && s._tires[k]._omega == 0.;
+        }
+        if(standing){
+            skipped += NX + NU;
+            continue;
+        }
+        worst = std::max(worst, compareDifferences(other, s, controls, A, B, skipped));
+    }
+
+    // times from the last state of the run, in a few rounds. The ratio is that of the round
+    // with the smallest one, so that a busy machine does not fail the bound in main
+    SimulatorSnapshot s;
+    sim.snapshot(s);
+    const int n = 1000;
+    double best = 1e9;
+    for(int r = 0; r < 5; r++){
+        auto start = high_resolution_clock::now();
+        for(int i = 0; i < n; i++){
+            sim.restore(s);
+            sim.step(controls);
+        }
+        auto mid = high_resolution_clock::now();
+        for(int i = 0; i < n; i++){
+            jac.step(sim, controls, A, B);
+            sim.restore(s);
+        }
+        auto stop = high_resolution_clock::now();
+        duration<double> t1 = mid - start, t2 = stop - mid;
+        if(t2.count() / t1.count() < best){
+            best = t2.count() / t1.count();
+            timeStep = t1.count() / n;
+            timeJacobian = t2.count() / n;
+        }
+    }
+    return failures;
+}
+
+
+int main(int argc, char *argv[]){
+    int failures = 0;
+    struct Run{
+        const char* _veh;
+        const char* _tire;
+        const char* _input;
+        double _endTime;
+    };
+    Run runs[] = {
+        {"./jsons/HMMWV.json", "./jsons/TMeasy.json", "./inputs/acc3.txt", 10.},
+        {"./jsons/HMMWV.json", "./jsons/TMeasy.json", "./inputs/ramp_steer2.txt", 14.5},
+        {"./jsons/dART.json", "./jsons/dARTTM.json", "./inputs/acc3.txt", 10.},
+        {"./jsons/dART.json", "./jsons/dARTTM.json", "./inputs/st.txt", 10.}
+    };
+    for(const Run& r : runs){
+        double worst = 0., timeStep = 0., timeJacobian = 0.;
+        int skipped = 0;
+        failures += checkRun(r._veh, r._tire, r._input, r._endTime, 20, worst, skipped, timeStep, timeJacobian);
+        std::cout<<r._veh<<" "<<r._input<<" : largest difference to finite differences "<<worst
+                 <<" ("<<skipped<<" of "<<20 * (NX + NU)<<" columns not smooth)"
+                 <<", step "<<timeStep * 1e6<<" us, Jacobian "<<timeJacobian * 1e6<<" us ("
+                 <<timeJacobian / timeStep<<" steps, one sided differences take "<<NX + NU + 1<<")\n";
+        if(worst > 1e-4){
+            failures++;
+        }
+        // one sided differences take NX + NU + 1 steps
+        if(timeJacobian > MAX_STEPS * timeStep){
+            std::cout<<"the Jacobian costs more than "<<MAX_STEPS<<" steps\n";
+            failures++;
+        }
+    }
+
+    std::cout<<(failures == 0 ? "passed" : "FAILED")<<"\n";
+    return failures == 0 ? 0 : 1;
+}
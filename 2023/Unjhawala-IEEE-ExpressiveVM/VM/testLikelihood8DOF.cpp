@@ -0,0 +1,163 @@
+#include <iostream>
+#include <stdint.h>
+#include <chrono>
+#include <cmath>
+#include "../utils.h"
+#include "Eightdof.h"
+#include "Simulator.h"
+#include "Batch.h"
+#include "Likelihood.h"
+
+
+using namespace EightDOF;
+
+/*
+Test file for the likelihood. The HMMWV calibration data is read from the csv and the .npy files,
+and its log likelihood has to match the one computed the way the calibration script does, from
+the outputs of simulateBatch, for a few parameter multipliers. Prints the time of an evaluation.
+Usage : ./testLikelihood
+*/
+
+
+static const char* vehJSON = "../calibration/HMMWV/jsons/HMMWV.json";
+static const char* tireJSON = "../calibration/HMMWV/jsons/TMeasy.json";
+static const double endTime = 20.009;
+static const int decimation = 10;
+
+
+// the likelihood of one run as HMMWV_calib.py computes it, from the simulated and the observed
+// channels of n samples
+static double scriptLike(const std::vector<double>& mod, int nMod, const ObservedRun& obs, const double* sigmas){
+    int k = obs._outputs.size();
+    int n = obs._nSamples;
+    double logs = 0., S = 0.;
+    std::vector<double> norms(k, 0.);
+    for(int c = 0; c < k; c++){
+        double ss = 0.;
+        for(int s = 0; s < n; s++){
+            double d = obs._values[c*n + s];
+            double r = mod[c*nMod + s] - d;
+            ss += r * r;
+            norms[c] += d * d;
+        }
+        logs += n * std::log(2. * M_PI * sigmas[c] * sigmas[c]) / 2.;
+        S += ss / (2. * sigmas[c] * sigmas[c]);
+    }
+    // the script adds the whole sum of squares to every channel before dividing by its norm
+    double like = 0.;
+    for(int c = 0; c < k; c++){
+        like -= (logs + k * S) / std::sqrt(norms[c]);
+    }
+    return like;
+}
+
+
+int main(int argc, char *argv[]){
+
+    VehicleParam v_params;
+    TMeasyParam t_params;
+    setVehParamsCached(v_params, vehJSON);
+    setTireParamsCached(t_params, tireJSON);
+    v_params._step = 0.001;
+    t_params._step = 0.001;
+
+    ParamGroups groups;
+    std::string bad;
+    parseParamGroups(groups, {"dfy0Pn,dfy0P2n", "fymPn,fymP2n,maxSteer", "dfx0Pn,dfx0P2n",
+                                "fxmPn,fxmP2n,lossesMapScale", "", "torqueMapScale"}, bad);
+    std::vector<std::string> outputs = {"u", "psi"};
+    std::vector<std::string> columns = {"vx", "yaw"};
+
+    // the same recording as a csv and a .npy file, and a csv only one
+    std::string error;
+    std::shared_ptr<const ObservedRun> runs[3];
+    runs[0] = cachedObservedRun("../calibration/HMMWV/inputs/st3_right.txt", endTime,
+                                "../calibration/HMMWV/data/st3_right_shafts.csv", outputs, columns, 0.01, 0.001, decimation, error);
+    runs[1] = cachedObservedRun("../calibration/HMMWV/inputs/st3_right.txt", endTime,
+                                "../calibration/HMMWV/data/st3_right_shafts.npy", outputs, {}, 0.01, 0.001, decimation, error);
+    runs[2] = cachedObservedRun("../calibration/HMMWV/inputs/double_lane3.txt", endTime,
+                                "../calibration/HMMWV/data/double_lane3_shafts.csv", outputs, columns, 0.01, 0.001, decimation, error);
+    for(int r = 0; r < 3; r++){
+        if(!runs[r]){
+            std::cout<<"Cannot load the data : "<<error<<"\n";
+            return 1;
+        }
+    }
+    int failures = 0;
+
+    // the .npy file of st3_right is the csv one with noise added
+    int n = runs[0]->_nSamples;
+    double rms[2] = {0., 0.};
+    for(int c = 0; c < 2; c++){
+        for(int s = 0; s < n; s++){
+            double d = runs[0]->_values[c*n + s] - runs[1]->_values[c*n + s];
+            rms[c] += d * d;
+        }
+        rms[c] = std::sqrt(rms[c] / n);
+    }
+    std::cout<<"Samples compared : "<<n<<", rms of the noise of the .npy file "<<rms[0]<<" "<<rms[1]<<"\n";
+    if(runs[1]->_nSamples != n || !(rms[0] < 0.5 && rms[1] < 0.05)){
+        failures++;
+    }
+
+    // loading again hands back the same object
+    std::shared_ptr<const ObservedRun> again = cachedObservedRun("../calibration/HMMWV/inputs/st3_right.txt", endTime,
+                                "../calibration/HMMWV/data/st3_right_shafts.csv", outputs, columns, 0.01, 0.001, decimation, error);
+    if(again != runs[0]){
+        std::cout<<"The cache read the csv file again\n";
+        failures++;
+    }
+
+    Likelihood like(v_params, t_params, groups);
+    like.addRun(runs[1]);
+    like.addRun(runs[2]);
+
+    std::vector<int> channels = runs[1]->_outputs;
+    int nMod = batchSamples(endTime, v_params._step, decimation);
+    std::vector<double> mod(channels.size() * nMod);
+    double sigmas[2] = {0.2, 0.02};
+    double thetas[3][6] = {{1., 1., 1., 1., 1., 1.},
+                           {1.2, 0.9, 1.1, 0.8, 1., 0.95},
+                           {0.7, 1.3, 0.9, 1.1, 1., 1.1}};
+    for(int j = 0; j < 3; j++){
+        double norms[2];
+        double value = like.logLikelihood(thetas[j], sigmas, norms);
+
+        double expected = 0.;
+        for(int r = 1; r < 3; r++){
+            const std::vector<Entry>& driverData = runs[r]->_driverData;
+            simulateBatch(mod.data(), v_params, t_params, driverData, endTime, groups, thetas[j], 1, channels, decimation, 1);
+            expected += scriptLike(mod, nMod, *runs[r], sigmas);
+        }
+        expected /= 2;
+        double err = std::abs(value - expected) / std::abs(expected);
+        std::cout<<"theta "<<j<<" : "<<value<<" (script "<<expected<<", relative error "<<err<<"), residual norms "
+                 <<norms[0]<<" "<<norms[1]<<"\n";
+        if(!(err < 1e-12)){
+            failures++;
+        }
+    }
+
+    // time of an evaluation, and of simulating the runs the way the script does
+    int reps = 5;
+    auto start = std::chrono::high_resolution_clock::now();
+    double sink = 0.;
+    for(int i = 0; i < reps; i++){
+        sink += like.logLikelihood(thetas[1], sigmas);
+    }
+    auto mid = std::chrono::high_resolution_clock::now();
+    for(int i = 0; i < reps; i++){
+        for(int r = 1; r < 3; r++){
+            simulateBatch(mod.data(), v_params, t_params, runs[r]->_driverData, endTime, groups, thetas[1], 1, channels, decimation, 1);
+            sink += scriptLike(mod, nMod, *runs[r], sigmas);
+        }
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+    auto ll = std::chrono::duration_cast<std::chrono::microseconds>(mid - start);
+    auto sb = std::chrono::duration_cast<std::chrono::microseconds>(stop - mid);
+    std::cout<<"logLikelihood : "<<ll.count() / reps / 1000.<<" ms per evaluation, simulateBatch and the sums : "
+             <<sb.count() / reps / 1000.<<" ms ("<<(sink != 0.)<<")\n";
+
+    std::cout<<(failures == 0 ? "passed" : "FAILED")<<"\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,91 @@
+#include <iostream>
+#include <sstream>
+#include <stdint.h>
+#include <cmath>
+#include "Mcmc.h"
+
+
+using namespace EightDOF;
+
+/*
+Test file for the ensemble sampler. The draws from a correlated gaussian have to have its mean
+and covariance, and the chains written with 1 and with 3 threads have to be the same.
+Usage : ./testMcmc
+*/
+
+
+// correlated gaussian, mean (1, -2), standard deviations (0.5, 2) and correlation 0.8
+static double gaussian(const double* x){
+    double a = (x[0] - 1.) / 0.5;
+    double b = (x[1] + 2.) / 2.;
+    double rho = 0.8;
+    return -(a * a - 2. * rho * a * b + b * b) / (2. * (1. - rho * rho));
+}
+
+
+int main(int argc, char *argv[]){
+
+    std::vector<McmcPrior> priors = {{"x", MCMC_UNIFORM, -10., 10., 0.5},
+                                     {"y", MCMC_UNIFORM, -10., 10., -1.}};
+    McmcSettings settings;
+    settings._walkers = 16;
+    settings._tune = 500;
+    settings._draws = 4000;
+    settings._seed = 7;
+    settings._threads = 1;
+    int failures = 0;
+
+    std::ostringstream one;
+    std::string error;
+    double acceptance = sampleEnsemble(gaussian, priors, settings, one, error);
+
+    // moments of the draws
+    std::istringstream in(one.str());
+    std::string line;
+    std::getline(in, line);
+    double n = 0., sx = 0., sy = 0., sxx = 0., syy = 0., sxy = 0.;
+    while(std::getline(in, line)){
+        double v[5];
+        std::istringstream row(line);
+        std::string field;
+        for(int i = 0; i < 5 && std::getline(row, field, ','); i++){
+            v[i] = std::stod(field);
+        }
+        n++;
+        sx += v[3];
+        sy += v[4];
+        sxx += v[3] * v[3];
+        syy += v[4] * v[4];
+        sxy += v[3] * v[4];
+    }
+    double mx = sx / n, my = sy / n;
+    double vx = sxx / n - mx * mx, vy = syy / n - my * my;
+    double rho = (sxy / n - mx * my) / std::sqrt(vx * vy);
+    std::cout<<"acceptance "<<acceptance<<", "<<n<<" draws : mean "<<mx<<" "<<my<<", sd "<<std::sqrt(vx)<<" "
+             <<std::sqrt(vy)<<", correlation "<<rho<<"\n";
+    if(std::abs(mx - 1.) > 0.05 || std::abs(my + 2.) > 0.2 || std::abs(std::sqrt(vx) - 0.5) > 0.05
+        || std::abs(std::sqrt(vy) - 2.) > 0.2 || std::abs(rho - 0.8) > 0.05){
+        std::cout<<"The draws do not follow the gaussian\n";
+        failures++;
+    }
+
+    // the same seed gives the same chains whatever the number of threads
+    settings._threads = 3;
+    std::ostringstream three;
+    sampleEnsemble(gaussian, priors, settings, three, error);
+    if(three.str() != one.str()){
+        std::cout<<"The chains depend on the number of threads\n";
+        failures++;
+    }
+
+    // bad settings are refused
+    settings._walkers = 3;
+    std::ostringstream bad;
+    if(sampleEnsemble(gaussian, priors, settings, bad, error) >= 0.){
+        std::cout<<"An odd number of walkers was accepted\n";
+        failures++;
+    }
+
+    std::cout<<(failures == 0 ? "passed" : "FAILED")<<"\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,127 @@
+#include <iostream>
+#include <stdint.h>
+#include <chrono>
+#include <fstream>
+#include <cstdio>
+#include "../utils.h"
+#include "Eightdof.h"
+#include "Simulator.h"
+#include "Batch.h"
+
+
+using std::chrono::high_resolution_clock;
+using std::chrono::duration;
+using namespace EightDOF;
+
+/*
+Test file for the parameter cache. A run with parameters from cloneParams has to be exactly a
+run with parameters freshly read with setVehParamsJSON/setTireParamsJSON and scaled by the same
+theta, a changed JSON file has to be parsed again, and the time of the setup of a sample is
+reported both ways.
+Usage : ./testParams
+*/
+
+
+// outputs of one run of the input with the given parameters
+static std::vector<double> run(const VehicleParam& veh_param, const TMeasyParam& tire_param,
+                               const std::vector<Entry>& driverData, double endTime, const std::vector<int>& outputs){
+    ParamGroups none;
+    std::vector<double> out(outputs.size() * batchSamples(endTime, veh_param._step, 1));
+    simulateBatch(out.data(), veh_param, tire_param, driverData, endTime, none, nullptr, 1, outputs, 1, 1);
+    return out;
+}
+
+// number of outputs that differ between the cached and the freshly read parameters
+static size_t compareRun(const char* vehJSON, const char* tireJSON, const std::string& input, double endTime,
+                         const ParamGroups& groups, const std::vector<double>& theta){
+    std::vector<Entry> driverData;
+    driverInput(driverData, input);
+    std::vector<int> outputs = {outputIndex("x"), outputIndex("y"), outputIndex("u"), outputIndex("v"),
+                                outputIndex("psi"), outputIndex("wz"), outputIndex("engine_omega")};
+
+    VehicleParam veh_param;
+    TMeasyParam tire_param;
+    setVehParamsJSON(veh_param, vehJSON);
+    setTireParamsJSON(tire_param, tireJSON);
+    scaleParams(veh_param, tire_param, groups, theta.data());
+    veh_param._step = tire_param._step = 0.001;
+
+    VehicleParam veh_clone;
+    TMeasyParam tire_clone;
+    cloneParams(veh_clone, tire_clone, vehJSON, tireJSON, groups, theta.data());
+    veh_clone._step = tire_clone._step = 0.001;
+
+    std::vector<double> ref = run(veh_param, tire_param, driverData, endTime, outputs);
+    std::vector<double> cur = run(veh_clone, tire_clone, driverData, endTime, outputs);
+    size_t mismatches = 0;
+    for(size_t j = 0; j < ref.size(); j++){
+        if(ref[j] != cur[j]){
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+
+int main(int argc, char *argv[]){
+
+    std::vector<std::string> specs = {"dfy0Pn,dfy0P2n", "fymPn,fymP2n,maxSteer", "dfx0Pn,dfx0P2n",
+                                      "fxmPn,fxmP2n,lossesMapScale", "", "torqueMapScale"};
+    std::vector<double> theta = {1.05, 0.95, 1.1, 0.9, 1., 1.02};
+    ParamGroups groups;
+    std::string bad;
+    parseParamGroups(groups, specs, bad);
+
+    // the cloned parameters are used twice so that the second run copies the stored ones
+    size_t mismatches = 0;
+    for(int i = 0; i < 2; i++){
+        mismatches += compareRun("./jsons/HMMWV.json", "./jsons/TMeasy.json", "./inputs/ramp_steer2.txt", 14.5, groups, theta);
+        mismatches += compareRun("../calibration/ART/jsons/dART_play.json", "../calibration/ART/jsons/dARTTM_play.json",
+                                 "./inputs/multi_run_acc/ramp/test0.txt", 12., groups, theta);
+    }
+    std::cout<<"Outputs not bit identical : "<<mismatches<<"\n";
+
+    // a changed file is parsed again
+    const char* tmpJSON = "./testParams_tmp.json";
+    {
+        std::ifstream src("./jsons/HMMWV.json");
+        std::ofstream dst(tmpJSON);
+        dst << src.rdbuf();
+    }
+    std::shared_ptr<const VehicleParam> first = cachedVehParams(tmpJSON);
+    bool reused = (cachedVehParams(tmpJSON) == first);
+    {
+        std::ofstream dst(tmpJSON, std::ios::app);
+        dst << "\n";
+    }
+    bool reparsed = (cachedVehParams(tmpJSON) != first);
+    std::remove(tmpJSON);
+    std::cout<<"Unchanged file reused : "<<reused<<", changed file parsed again : "<<reparsed<<"\n";
+
+    // setup of one sample - reading the JSON files against copying the cached parameters
+    int n = 1000;
+    VehicleParam veh_param;
+    TMeasyParam tire_param;
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+    for(int i = 0; i < n; i++){
+        VehicleParam v;
+        TMeasyParam t;
+        setVehParamsJSON(v, "./jsons/HMMWV.json");
+        setTireParamsJSON(t, "./jsons/TMeasy.json");
+        scaleParams(v, t, groups, theta.data());
+    }
+    high_resolution_clock::time_point end = high_resolution_clock::now();
+    double json_us = std::chrono::duration_cast<duration<double, std::micro>>(end - start).count() / n;
+
+    start = high_resolution_clock::now();
+    for(int i = 0; i < n; i++){
+        cloneParams(veh_param, tire_param, "./jsons/HMMWV.json", "./jsons/TMeasy.json", groups, theta.data());
+    }
+    end = high_resolution_clock::now();
+    double clone_us = std::chrono::duration_cast<duration<double, std::micro>>(end - start).count() / n;
+
+    std::cout<<"Setup of a sample from the JSON files (us) : "<<json_us<<"\n";
+    std::cout<<"Setup of a sample with cloneParams (us) : "<<clone_us<<"\n";
+
+    return (mismatches == 0 && reused && reparsed) ? 0 : 1;
+}
@@ -0,0 +1,159 @@
+#include <iostream>
+#include <stdint.h>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <atomic>
+#include <new>
+#include "../utils.h"
+#include "Eightdof.h"
+#include "Simulator.h"
+#include "Rollout.h"
+
+
+using std::chrono::high_resolution_clock;
+using std::chrono::duration;
+using namespace EightDOF;
+
+/*
+Test file for the rollouts of candidate control sequences (RolloutEngine) with the dART. The costs
+and end states have to be exactly those of running every candidate on its own, the allocations
+of an evaluation must not grow with the number of candidates, and the time of 1000 rollouts of
+2 s is reported along with how many of them fit in a 10 ms deadline.
+Usage : ./testRollout [number of threads]
+*/
+
+static std::atomic<size_t> num_allocations(0);
+
+// not inlined, or GCC pairs the malloc and free inside them with the new and delete of the
+// standard containers and warns about mismatched allocation functions
+__attribute__((noinline)) void* operator new(std::size_t size){
+    num_allocations++;
+    void* p = std::malloc(size == 0 ? 1 : size);
+    if(!p){
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept{
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, std::size_t) noexcept{
+    std::free(p);
+}
+
+
+// tracks a speed of 2 m/s without turning, with a small penalty on the controls
+static double stageCost(int h, const VehicleState& v_states, const double* controls){
+    double du = v_states._u - 2.;
+    return du * du + 0.5 * v_states._wz * v_states._wz + 0.01 * (controls[0] * controls[0] + controls[2] * controls[2]);
+}
+
+static double terminalCost(const VehicleState& v_states){
+    return 10. * v_states._v * v_states._v;
+}
+
+
+int main(int argc, char *argv[]){
+
+    unsigned int num_threads = 0;
+    if(argc > 1){
+        num_threads = std::atoi(argv[1]);
+    }
+
+    VehicleParam veh_param;
+    setVehParamsJSON(veh_param, "../calibration/ART/jsons/dART_play.json");
+    TMeasyParam tire_param;
+    setTireParamsJSON(tire_param, "../calibration/ART/jsons/dARTTM_play.json");
+    veh_param._step = 0.001;
+    tire_param._step = 0.001;
+
+    // the state after 3 s of a recorded run is the start of all the rollouts
+    std::vector<Entry> driverData;
+    driverInput(driverData, "./inputs/multi_run_acc/ramp/test0.txt");
+    Simulator sim(veh_param, tire_param);
+    Driver_input input(driverData);
+    Controls controls;
+    double t = 0;
+    while(t < (3. - veh_param._step/10)){
+        getControls(controls, input, t);
+        sim.step(controls);
+        t += veh_param._step;
+    }
+    SimulatorSnapshot start;
+    sim.snapshot(start);
+
+    // K random candidates over 2 s, the controls held for 20 ms
+    int K = 1000, hold = 20, horizon = 100;
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<double> steer(-1., 1.), pedal(0., 1.);
+    std::vector<double> candidates(size_t(K) * horizon * 3);
+    for(int k = 0; k < K; k++){
+        for(int h = 0; h < horizon; h++){
+            double* u = &candidates[(size_t(k) * horizon + h) * 3];
+            u[0] = steer(gen);
+            u[1] = pedal(gen);
+            u[2] = (h % 10 == 0) ? 0.2 * pedal(gen) : 0.;
+        }
+    }
+
+    RolloutEngine engine(veh_param, tire_param, num_threads);
+    std::vector<double> costs(K);
+    std::vector<SimulatorSnapshot> ends(K);
+
+    // a first evaluation and the allocations of a small and a full one
+    engine.evaluate(start, candidates.data(), K, horizon, hold, stageCost, terminalCost, costs.data(), ends.data());
+    size_t before = num_allocations;
+    engine.evaluate(start, candidates.data(), 64, horizon, hold, stageCost, terminalCost, costs.data(), ends.data());
+    size_t small = num_allocations - before;
+    before = num_allocations;
+    high_resolution_clock::time_point t0 = high_resolution_clock::now();
+    int done = engine.evaluate(start, candidates.data(), K, horizon, hold, stageCost, terminalCost, costs.data(), ends.data());
+    high_resolution_clock::time_point t1 = high_resolution_clock::now();
+    size_t full = num_allocations - before;
+    double full_ms = std::chrono::duration_cast<duration<double, std::milli>>(t1 - t0).count();
+
+    // every candidate on its own
+    int mismatches = 0;
+    Simulator ref(veh_param, tire_param);
+    for(int k = 0; k < K; k++){
+        ref.restore(start);
+        double cost = 0.;
+        for(int h = 0; h < horizon; h++){
+            const double* u = &candidates[(size_t(k) * horizon + h) * 3];
+            for(int i = 0; i < hold; i++){
+                Controls c;
+                c._time = ref.getTime();
+                c._steering = u[0];
+                c._throttle = u[1];
+                c._braking = u[2];
+                ref.step(c);
+            }
+            cost += stageCost(h, ref.getVehicleState(), u);
+        }
+        cost += terminalCost(ref.getVehicleState());
+        const VehicleState& e = ends[k]._v_states;
+        const VehicleState& r = ref.getVehicleState();
+        if(cost != costs[k] || e._x != r._x || e._y != r._y || e._u != r._u || e._psi != r._psi ||
+           ends[k]._time != ref.getTime()){
+            mismatches++;
+        }
+    }
+
+    // as many as fit in 10 ms
+    high_resolution_clock::time_point deadline_start = high_resolution_clock::now();
+    int in_budget = engine.evaluate(start, candidates.data(), K, horizon, hold, stageCost, terminalCost, costs.data(), nullptr,
+                                    std::chrono::steady_clock::now() + std::chrono::milliseconds(10));
+    double budget_ms = std::chrono::duration_cast<duration<double, std::milli>>(high_resolution_clock::now() - deadline_start).count();
+
+    std::cout<<"Threads : "<<engine.numThreads()<<"\n";
+    std::cout<<"Candidates not bit identical to single runs : "<<mismatches<<"\n";
+    std::cout<<"Allocations of an evaluation of 64 / "<<K<<" candidates : "<<small<<" / "<<full<<"\n";
+    std::cout<<K<<" rollouts of "<<horizon * hold * veh_param._step<<" s ("<<done<<" evaluated) : "<<full_ms<<" ms, "
+             <<1e3 * full_ms / (double(K) * horizon * hold)<<" us per model step\n";
+    std::cout<<"Rollouts evaluated with a 10 ms deadline : "<<in_budget<<" of "<<K<<" ("<<budget_ms<<" ms)\n";
+
+    return (mismatches == 0 && done == K && full == small) ? 0 : 1;
+}
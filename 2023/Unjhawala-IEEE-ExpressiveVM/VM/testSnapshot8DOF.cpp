@@ -0,0 +1,148 @@
+#include <iostream>
+#include <stdint.h>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <fstream>
+#include "../utils.h"
+#include "Eightdof.h"
+#include "Simulator.h"
+
+
+using std::chrono::high_resolution_clock;
+using std::chrono::duration;
+using namespace EightDOF;
+
+/*
+Test file for Simulator snapshots. A run that is saved halfway and continued - in the same
+Simulator, in another one after the snapshot went through a file, or in a copy of the Simulator -
+has to end exactly where the uninterrupted run ends. It also reports the time to restore a
+snapshot and that of branching what-if futures from it against simulating the shared start again.
+Usage : ./testSnapshot [input file] [end time]
+*/
+
+
+// outputs compared at the end of the runs
+static const int NUM_CHECKED = 9;
+static const char* CHECKED[NUM_CHECKED] = {"x", "y", "u", "v", "psi", "wz", "wlf", "current_gear", "engine_omega"};
+
+// steps sim up to endTime, the throttle multiplied by throttleScale
+static void advance(Simulator& sim, Driver_input& input, double endTime, double throttleScale = 1.){
+    Controls controls;
+    double step = sim.getVehicleParam()._step;
+    double t = sim.getTime();
+    while(t < (endTime - step/10)){
+        getControls(controls, input, t);
+        controls._throttle = std::min(1., controls._throttle * throttleScale);
+        sim.step(controls);
+        t += step;
+    }
+}
+
+// number of checked outputs that differ between the two simulators
+static int compare(const Simulator& a, const Simulator& b){
+    int mismatches = 0;
+    for(int k = 0; k < NUM_CHECKED; k++){
+        int c = outputIndex(CHECKED[k]);
+        if(a.getOutput(c) != b.getOutput(c)){
+            mismatches++;
+        }
+    }
+    return mismatches + (a.getTime() != b.getTime());
+}
+
+
+int main(int argc, char *argv[]){
+
+    std::string fileName = "./inputs/ramp_steer2.txt";
+    double endTime = 14.5;
+    if(argc > 2){
+        fileName = argv[1];
+        endTime = std::atof(argv[2]);
+    }
+    double midTime = endTime / 2.;
+
+    std::vector<Entry> driverData;
+    driverInput(driverData, fileName);
+
+    VehicleParam veh_param;
+    setVehParamsJSON(veh_param, "./jsons/HMMWV.json");
+    TMeasyParam tire_param;
+    setTireParamsJSON(tire_param, "./jsons/TMeasy.json");
+    veh_param._step = 0.001;
+    tire_param._step = 0.001;
+
+    // uninterrupted run
+    Simulator ref(veh_param, tire_param);
+    Driver_input ref_input(driverData);
+    advance(ref, ref_input, endTime);
+
+    // halfway, saved and continued
+    Simulator sim(veh_param, tire_param);
+    Driver_input input(driverData);
+    advance(sim, input, midTime);
+    SimulatorSnapshot snap;
+    sim.snapshot(snap, input);
+    Simulator forked(sim);
+
+    // the snapshot through a file into a new Simulator with the driver inputs streamed from disk
+    const char* snapFile = "./testSnapshot_tmp.bin";
+    {
+        std::ofstream out(snapFile, std::ios::binary);
+        out.write((const char*)&snap, sizeof(snap));
+    }
+    SimulatorSnapshot loaded;
+    {
+        std::ifstream in(snapFile, std::ios::binary);
+        in.read((char*)&loaded, sizeof(loaded));
+    }
+    std::remove(snapFile);
+    Simulator fromFile(veh_param, tire_param);
+    Driver_input streamed(fileName, 4);
+    fromFile.restore(loaded, streamed);
+    advance(fromFile, streamed, endTime);
+
+    // the original continued, changed by a different future and then restored
+    advance(sim, input, endTime);
+    int mismatches = compare(ref, sim);
+    advance(forked, input, endTime, 0.5);
+    forked.restore(snap, input);
+    advance(forked, input, endTime);
+    mismatches += compare(ref, forked) + compare(ref, fromFile);
+    std::cout<<"Snapshot size (bytes) : "<<sizeof(SimulatorSnapshot)<<"\n";
+    std::cout<<"Outputs not bit identical : "<<mismatches<<"\n";
+
+    // restoring into a Simulator
+    int n = 100000;
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+    for(int i = 0; i < n; i++){
+        sim.restore(snap, input);
+    }
+    high_resolution_clock::time_point end = high_resolution_clock::now();
+    double restore_ns = std::chrono::duration_cast<duration<double, std::nano>>(end - start).count() / n;
+    std::cout<<"Time to restore a snapshot (ns) : "<<restore_ns<<"\n";
+
+    // what-if futures with different throttle from the halfway state, against simulating the
+    // shared start again for every one of them
+    int futures = 10;
+    start = high_resolution_clock::now();
+    for(int f = 0; f < futures; f++){
+        sim.restore(snap, input);
+        advance(sim, input, endTime, 0.5 + 0.1 * f);
+    }
+    end = high_resolution_clock::now();
+    double branch_ms = std::chrono::duration_cast<duration<double, std::milli>>(end - start).count();
+
+    start = high_resolution_clock::now();
+    for(int f = 0; f < futures; f++){
+        sim.reset();
+        advance(sim, input, midTime);
+        advance(sim, input, endTime, 0.5 + 0.1 * f);
+    }
+    end = high_resolution_clock::now();
+    double rerun_ms = std::chrono::duration_cast<duration<double, std::milli>>(end - start).count();
+    std::cout<<"Time of "<<futures<<" futures from the snapshot (ms) : "<<branch_ms<<"\n";
+    std::cout<<"Time of "<<futures<<" futures simulating the start again (ms) : "<<rerun_ms<<"\n";
+
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+#include <iostream>
+#include <stdint.h>
+#include <cmath>
+#include "../utils.h"
+#include "Eightdof.h"
+#include "Batch.h"
+#include "Sobol.h"
+
+
+using namespace EightDOF;
+
+/*
+Test file for the sensitivity analysis. The Sobol sequence has to start with the known points
+and put one of its first 1024 points in every 1/1024 of each dimension. The indices of the
+Ishigami function have to match the analytical ones. Over runs of the HMMWV, a parameter group
+that is empty has to get indices of exactly 0, and 1 and 3 threads have to give the same indices.
+Usage : ./testSobol
+*/
+
+
+static double ishigami(const double* x){
+    return std::sin(x[0]) + 7. * std::sin(x[1]) * std::sin(x[1]) + 0.1 * std::pow(x[2], 4) * std::sin(x[0]);
+}
+
+
+int main(int argc, char *argv[]){
+    int failures = 0;
+
+    // the sequence
+    SobolSequence pairs(2);
+    double expected[5][2] = {{0.5, 0.5}, {0.75, 0.25}, {0.25, 0.75}, {0.375, 0.375}, {0.875, 0.875}};
+    for(int j = 0; j < 5; j++){
+        double p[2];
+        pairs.next(p);
+        if(p[0] != expected[j][0] || p[1] != expected[j][1]){
+            std::cout<<"Point "<<j + 1<<" of the sequence is "<<p[0]<<" "<<p[1]<<"\n";
+            failures++;
+        }
+    }
+    SobolSequence all(SobolSequence::MAX_DIMS);
+    std::vector<int> hits(SobolSequence::MAX_DIMS * 1024, 0);
+    std::vector<double> p(SobolSequence::MAX_DIMS);
+    for(int j = 0; j < 1023; j++){
+        all.next(p.data());
+        for(int d = 0; d < SobolSequence::MAX_DIMS; d++){
+            hits[d * 1024 + int(p[d] * 1024)]++;
+        }
+    }
+    int empty = 0;
+    for(int d = 0; d < SobolSequence::MAX_DIMS; d++){
+        // the point left out, all zeros, is in the first bin
+        for(int b = 1; b < 1024; b++){
+            empty += (hits[d * 1024 + b] != 1);
+        }
+    }
+    if(empty > 0){
+        std::cout<<"The first points of the sequence are not stratified ("<<empty<<" bins)\n";
+        failures++;
+    }
+
+    // Ishigami function on [-pi, pi]^3
+    SobolSequence seq(6);
+    SobolAccumulator ish(3);
+    for(int j = 0; j < (1 << 14); j++){
+        double x[6], ab[3], fAB[3];
+        seq.next(x);
+        for(int i = 0; i < 6; i++){
+            x[i] = M_PI * (2. * x[i] - 1.);
+        }
+        for(int i = 0; i < 3; i++){
+            std::copy(x, x + 3, ab);
+            ab[i] = x[3 + i];
+            fAB[i] = ishigami(ab);
+        }
+        ish.add(ishigami(x), ishigami(x + 3), fAB);
+    }
+    double first[3] = {0.3139, 0.4424, 0.};
+    double total[3] = {0.5576, 0.4424, 0.2437};
+    for(int i = 0; i < 3; i++){
+        std::cout<<"Ishigami x"<<i + 1<<" : first "<<ish.first(i)<<" ("<<first[i]<<"), total "<<ish.total(i)
+                 <<" ("<<total[i]<<")\n";
+        if(std::abs(ish.first(i) - first[i]) > 0.02 || std::abs(ish.total(i) - total[i]) > 0.02){
+            failures++;
+        }
+    }
+
+    // the model
+    VehicleParam v_params;
+    TMeasyParam t_params;
+    setVehParamsJSON(v_params, "./jsons/HMMWV.json");
+    setTireParamsJSON(t_params, "./jsons/TMeasy.json");
+    v_params._step = 0.001;
+    t_params._step = 0.001;
+    std::vector<Entry> driverData;
+    driverInput(driverData, "./inputs/acc3.txt");
+
+    ParamGroups groups;
+    std::string bad;
+    parseParamGroups(groups, {"torqueMapScale", "", "dfx0Pn,dfx0P2n"}, bad);
+    double lower[3] = {0.8, 0.8, 0.5};
+    double upper[3] = {1.2, 1.2, 1.5};
+    std::vector<SensitivityQuantity> quantities(2);
+    parseSensitivityQuantity(quantities[0], "u:final");
+    parseSensitivityQuantity(quantities[1], "wlf:max");
+
+    std::vector<SobolAccumulator> one, three;
+    sobolIndices(one, v_params, t_params, driverData, 10., groups, lower, upper, quantities, 40, 16, 1);
+    sobolIndices(three, v_params, t_params, driverData, 10., groups, lower, upper, quantities, 40, 16, 3);
+    for(size_t q = 0; q < quantities.size(); q++){
+        std::cout<<quantities[q]._name<<" : mean "<<one[q].mean()<<", first";
+        for(int i = 0; i < 3; i++){
+            std::cout<<" "<<one[q].first(i);
+        }
+        std::cout<<", total";
+        for(int i = 0; i < 3; i++){
+            std::cout<<" "<<one[q].total(i);
+        }
+        std::cout<<"\n";
+        if(one[q].first(1) != 0. || one[q].total(1) != 0.){
+            std::cout<<"The empty group has an effect\n";
+            failures++;
+        }
+        for(int i = 0; i < 3; i++){
+            if(one[q].first(i) != three[q].first(i) || one[q].total(i) != three[q].total(i)){
+                std::cout<<"The indices depend on the number of threads\n";
+                failures++;
+                break;
+            }
+        }
+    }
+
+    std::cout<<(failures == 0 ? "passed" : "FAILED")<<"\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,198 @@
+#include <iostream>
+#include <stdint.h>
+#include <cstring>
+#include <cmath>
+#include "../utils.h"
+#include "Eightdof.h"
+
+
+using namespace EightDOF;
+
+/*
+Test file for the tire functions. tireAdv4, which advances the 4 tires of a vehicle at once, has
+to give exactly the states of 4 calls of tireAdv, for the tire states of whole runs of the HMMWV
+and the dART (the HMMWV has a non linear steering map, so the rear tires get the angle of the
+map at 0 as with tireAdv). tmxy_combined_select has to give exactly the forces of tmxy_combined
+over a dense grid of (sx, sy, fz) and over curves that take every branch, and a derivative that
+matches finite differences.
+Usage : ./testTire
+*/
+
+
+// runs the free functions over the input file, with tireAdv4 on a copy of the tires before
+// every tireAdv - returns the number of steps where the two differ
+static int compareRun(const char* vehParamsJSON, const char* tireParamsJSON, const std::string& fileName,
+                      double endTime, int& steps){
+    VehicleParam v_params;
+    setVehParamsJSON(v_params, vehParamsJSON);
+    TMeasyParam t_params;
+    setTireParamsJSON(t_params, tireParamsJSON);
+    v_params._step = 0.001;
+    t_params._step = 0.001;
+    tireInit(t_params);
+
+    std::vector<Entry> driverData;
+    driverInput(driverData, fileName);
+
+    VehicleState veh_st;
+    vehInit(veh_st, v_params);
+    TMeasyState tires[4], corners[4];
+    std::vector<double> controls(4, 0.), mod_controls(4, 0.);
+    std::vector<double> fx(4), fy(4);
+    double delta[4];
+    int mismatches = 0;
+
+    double step = v_params._step;
+    double t = 0;
+    while(t < (endTime - step/10)){
+        getControls(controls, driverData, t);
+        mod_controls = controls;
+        mod_controls[1] = 0;
+        vehToTireTransform(tires[0], tires[1], tires[2], tires[3], veh_st, v_params, controls);
+
+        std::copy(tires, tires + 4, corners);
+        delta[0] = delta[1] = steerAngle(v_params, controls[1]);
+        delta[2] = delta[3] = steerAngle(v_params, 0.);
+        tireAdv4(corners, t_params, v_params, delta, controls[0]);
+
+        tireAdv(tires[0], t_params, veh_st, v_params, controls);
+        tireAdv(tires[1], t_params, veh_st, v_params, controls);
+        tireAdv(tires[2], t_params, veh_st, v_params, mod_controls);
+        tireAdv(tires[3], t_params, veh_st, v_params, mod_controls);
+        if(std::memcmp(corners, tires, sizeof(tires)) != 0){
+            mismatches++;
+        }
+
+        evalPowertrain(veh_st, tires[0], tires[1], tires[2], tires[3], v_params, t_params, controls);
+        tireToVehTransform(tires[0], tires[1], tires[2], tires[3], veh_st, v_params, controls);
+        for(int i = 0; i < 4; i++){
+            fx[i] = tires[i]._fx;
+            fy[i] = tires[i]._fy;
+        }
+        vehAdv(veh_st, v_params, fx, fy, tires[0]._rStat, tires[3]._rStat);
+        t += step;
+        steps++;
+    }
+    return mismatches;
+}
+
+
+// compares tmxy_combined_select with tmxy_combined at s for one curve - returns the number of
+// differences, counts the branch taken in branches (0 - none, 1 - adhesion, 2 - parabola 1,
+// 3 - parabola 2, 4 - cubic, 5 - sliding) and the largest derivative error in maxErr
+static int compareCurve(double s, double df0, double sm, double fm, double ss, double fs,
+                        int* branches, double& maxErr){
+    double f, fos, f2, fos2, dfds;
+    tmxy_combined(f, fos, s, df0, sm, fm, ss, fs);
+    tmxy_combined_select(f2, fos2, dfds, s, df0, sm, fm, ss, fs);
+    int bad = (std::memcmp(&f, &f2, sizeof(f)) != 0 || std::memcmp(&fos, &fos2, sizeof(fos)) != 0);
+
+    // the branch, and the points a finite difference cannot cross
+    double df0loc = sm > 0. ? std::max(2. * fm / sm, df0) : 0.;
+    double a = (fm / sm) * (fm / sm) / (df0loc * sm);
+    double sstar = sm + (fm - fs) / (a * (ss - sm));
+    int branch = 0;
+    if(s > 0. && df0loc > 0.){
+        branch = s > ss ? 5 : (s < sm ? 1 : (sstar <= ss ? (s <= sstar ? 2 : 3) : 4));
+    }
+    branches[branch]++;
+
+    double h = 1e-7 * std::max(s, 1e-3);
+    double edge = std::min(std::abs(s - sm), std::min(std::abs(s - ss), std::abs(s - sstar)));
+    if(branch != 0 && s > 2. * h && edge > 10. * h){
+        double fp, fm_, o;
+        tmxy_combined(fp, o, s + h, df0, sm, fm, ss, fs);
+        tmxy_combined(fm_, o, s - h, df0, sm, fm, ss, fs);
+        double err = std::abs((fp - fm_) / (2. * h) - dfds) / std::max(df0loc, 1.);
+        maxErr = std::max(maxErr, err);
+    }
+    return bad;
+}
+
+// the curve of a tire for the slips sx, sy and the load fz - the same expressions as tireSlip
+static int compareGrid(const TMeasyParam& p, int* branches, double& maxErr, int& points){
+    int bad = 0;
+    for(int k = 0; k <= 24; k++){
+        double fz = 1.2 * p._pnmax * k / 24.;
+        fz = fz > p._pnmax ? p._pnmax : fz;
+        double dfx0 = InterpQ(fz, p._dfx0Pn, p._dfx0P2n, p._pn);
+        double dfy0 = InterpQ(fz, p._dfy0Pn, p._dfy0P2n, p._pn);
+        double fxm = InterpQ(fz, p._fxmPn, p._fxmP2n, p._pn);
+        double fym = InterpQ(fz, p._fymPn, p._fymP2n, p._pn);
+        double fxs = InterpQ(fz, p._fxsPn, p._fxsP2n, p._pn);
+        double fys = InterpQ(fz, p._fysPn, p._fysP2n, p._pn);
+        double sxm = InterpL(fz, p._sxmPn, p._sxmP2n, p._pn);
+        double sym = InterpL(fz, p._symPn, p._symP2n, p._pn);
+        double sxs = InterpL(fz, p._sxsPn, p._sxsP2n, p._pn);
+        double sys = InterpL(fz, p._sysPn, p._sysP2n, p._pn);
+        double hsxn = sxm / (sxm + sym) + (fxm / dfx0) / (fxm / dfx0 + fym / dfy0);
+        double hsyn = sym / (sxm + sym) + (fym / dfy0) / (fxm / dfx0 + fym / dfy0);
+        for(int i = -60; i <= 60; i++){
+            for(int j = -60; j <= 60; j++){
+                double sxn = 0.025 * i / hsxn;
+                double syn = 0.025 * j / hsyn;
+                double sc = hypot(sxn, syn);
+                double calpha = sc > 0 ? sxn/sc : sqrt(2.) / 2.;
+                double salpha = sc > 0 ? syn/sc : sqrt(2.) / 2.;
+                double df0 = hypot(dfx0 * calpha * hsxn, dfy0 * salpha * hsyn);
+                double fm  = hypot(fxm * calpha, fym * salpha);
+                double sm = hypot(sxm * calpha / hsxn, sym * salpha / hsyn);
+                double fs = hypot(fxs * calpha, fys * salpha);
+                double ss = hypot(sxs * calpha / hsxn, sys * salpha / hsyn);
+                bad += compareCurve(sc, df0, sm, fm, ss, fs, branches, maxErr);
+                points++;
+            }
+        }
+    }
+    return bad;
+}
+
+
+int main(int argc, char *argv[]){
+
+    int steps = 0;
+    int mismatches = 0;
+    mismatches += compareRun("./jsons/HMMWV.json", "./jsons/TMeasy.json", "./inputs/acc3.txt", 10., steps);
+    mismatches += compareRun("./jsons/HMMWV.json", "./jsons/TMeasy.json", "./inputs/ramp_steer2.txt", 14.5, steps);
+    mismatches += compareRun("./jsons/HMMWV.json", "./jsons/TMeasy.json", "./inputs/st.txt", 10., steps);
+    mismatches += compareRun("./jsons/dART.json", "./jsons/dARTTM.json", "./inputs/st.txt", 10., steps);
+    mismatches += compareRun("../calibration/ART/jsons/dART_play.json", "../calibration/ART/jsons/dARTTM_play.json",
+                             "./inputs/multi_run_acc/ramp/test0.txt", 12., steps);
+    std::cout<<"Steps where tireAdv4 differs from tireAdv : "<<mismatches<<" of "<<steps<<"\n";
+
+    // the force characteristics, over the slips and loads of the HMMWV and the dART tires
+    int branches[6] = {0, 0, 0, 0, 0, 0};
+    double maxErr = 0.;
+    int points = 0;
+    int differ = 0;
+    const char* tireFiles[2] = {"./jsons/TMeasy.json", "./jsons/dARTTM.json"};
+    for(const char* file : tireFiles){
+        TMeasyParam t_params;
+        setTireParamsJSON(t_params, file);
+        tireInit(t_params);
+        differ += compareGrid(t_params, branches, maxErr, points);
+    }
+    // and over curves with sliding forces and slips far apart and close together, which take the
+    // cubic fallback as well
+    for(int i = 1; i <= 20; i++){
+        for(int j = 1; j <= 20; j++){
+            double fm = 1000., sm = 0.1, df0 = 25000.;
+            double fs = fm * (0.05 * i - 0.01);
+            double ss = sm * (1. + 0.2 * j);
+            for(int k = -10; k <= 400; k++){
+                differ += compareCurve(0.001 * k, df0, sm, fm, ss, fs, branches, maxErr);
+                points++;
+            }
+        }
+    }
+    std::cout<<"Points where tmxy_combined_select differs from tmxy_combined : "<<differ<<" of "<<points
+             <<", branches taken (none, adhesion, parabola 1, parabola 2, cubic, sliding) :";
+    for(int b = 0; b < 6; b++){
+        std::cout<<" "<<branches[b];
+        mismatches += (branches[b] == 0);
+    }
+    std::cout<<"\nLargest error of the derivative against finite differences : "<<maxErr<<"\n";
+    mismatches += differ + (maxErr > 1e-5);
+
+    return mismatches == 0 ? 0 : 1;
+}
@@ -38,16 +38,16 @@ def model(theta,fileName,endTime):
     # lets get a vector of entries going 
     driverData = rom.vector_entry()
 
-    # lets fill this up from our data file
-    rom.driverInput(driverData,fileName)
+    # lets fill this up from our data file - later runs read the binary cache next to it
+    rom.driverInput(driverData,fileName,True)
 
     # lets get our vector of doubles which will hold the controls at each time
     controls = rom.vector_double(4,0)
 
     veh1_param = rom.VehicleParam()
-    rom.setVehParamsJSON(veh1_param,fileName_veh)
+    rom.setVehParamsCached(veh1_param,fileName_veh)
     tire_param = rom.TMeasyParam()
-    rom.setTireParamsJSON(tire_param,fileName_tire)
+    rom.setTireParamsCached(tire_param,fileName_tire)
 
     # Initialize our vehicle state in each iteration 
     veh1_st = rom.VehicleState()
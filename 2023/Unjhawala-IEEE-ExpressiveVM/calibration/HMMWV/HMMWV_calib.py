@@ -20,146 +20,62 @@ import rom
 rpm2rad = np.pi / 30
 
 # since PyMC requires pickling of the step method, our likelihood function cannot have any references 
-# to C objects, we thus have this model function that generates all the references we need, does all the computations
-# required for the likelihood, and then return the required model response. As we leave the function call,
-# all the C references are popped anyways, so our likelihood can be pickled!
-def model(theta,fileName,endTime):
-    
-    # lets get a vector of entries going 
-    driverData = rom.vector_entry()
-
-    # lets fill this up from our data file
-    rom.driverInput(driverData,fileName)
-
-    # lets get our vector of doubles which will hold the controls at each time
-    controls = rom.vector_double(4,0)
-
-    veh1_param = rom.VehicleParam()
-    rom.setVehParamsJSON(veh1_param,fileName_veh)
-    tire_param = rom.TMeasyParam()
-    rom.setTireParamsJSON(tire_param,fileName_tire)
-
-    # Initialize our vehicle state in each iteration 
-    veh1_st = rom.VehicleState()
-    rom.vehInit(veh1_st,veh1_param)
-
-    tirelf_st = rom.TMeasyState()
-    tirerf_st = rom.TMeasyState()
-    tirelr_st = rom.TMeasyState()
-    tirerr_st = rom.TMeasyState()
-    rom.tireInit(tire_param)
-
-
-    veh1_param._step = 0.001
-    tire_param._step = 0.001
-    step = veh1_param._step
-
-    ########################################## Set the new parameters #########
-    # print(theta)
-    tire_param._dfy0Pn = tire_param._dfy0Pn * theta[0]
-    tire_param._dfy0P2n = tire_param._dfy0P2n * theta[0]
-
-    tire_param._fymPn = tire_param._fymPn * theta[1]
-    tire_param._fymP2n = tire_param._fymP2n * theta[1]
-
-    veh1_param._maxSteer = veh1_param._maxSteer * theta[1]
-    
-    tire_param._dfx0Pn = tire_param._dfx0Pn * theta[2]
-    tire_param._dfx0P2n = tire_param._dfx0P2n * theta[2]
-
-    tire_param._fxmPn = tire_param._fxmPn * theta[3]
-    tire_param._fxmP2n = tire_param._fxmP2n * theta[3]
-
-    # Map factors
-    tor_size = veh1_param._powertrainMap.size()
-    for p in range(tor_size):
-        veh1_param._powertrainMap[p]._y = veh1_param._powertrainMap[p]._y  * theta[5]
-
-    loss_size = veh1_param._lossesMap.size()
-    for k in range(loss_size):
-        veh1_param._lossesMap[k]._y = veh1_param._lossesMap[k]._y  * theta[3]
-
+# to C objects, we thus have this model function that runs the whole simulation in C++ (rom.simulate)
+# and only returns numpy arrays, so our likelihood can be pickled!
 
-    ##########################################################################
-    # solve the model
-    result = []
-    t = 0
-    timeStepNo = 0
-    while(t<endTime):
-        # get the controls for the time step
-        rom.getControls(controls, driverData, t)
+# parameters scaled by each entry of theta
+theta_params = ["dfy0Pn,dfy0P2n",
+                "fymPn,fymP2n,maxSteer",
+                "dfx0Pn,dfx0P2n",
+                "fxmPn,fxmP2n,lossesMapScale",
+                "",
+                "torqueMapScale"]
 
-        #transfrom vehicle velocities to tire velocites
-        rom.vehToTireTransform(tirelf_st,tirerf_st,tirelr_st,tirerr_st,veh1_st,veh1_param,controls)
+# outputs that are compared to the data
+model_outputs = ["u", "psi"]
 
-        # advanvce our 4 tires with this transformed velocity
-        rom.tireAdv(tirelf_st, tire_param, veh1_st, veh1_param, controls)
-        rom.tireAdv(tirerf_st, tire_param, veh1_st, veh1_param, controls)
-
-        # rear wheel does not steer, so need to give it modified controls
-        mod_controls = [controls[0],0,controls[2],controls[3]]
-
-        rom.tireAdv(tirelr_st, tire_param, veh1_st, veh1_param, mod_controls)
-        rom.tireAdv(tirerr_st, tire_param, veh1_st, veh1_param, mod_controls)
-
-        rom.evalPowertrain(veh1_st, tirelf_st, tirerf_st, tirelr_st, tirerr_st, veh1_param, tire_param, controls)
-
-        # transfrom tire forces into vehicle coordinate frame
-        rom.tireToVehTransform(tirelf_st,tirerf_st,tirelr_st,tirerr_st,veh1_st,veh1_param,controls)
-
-        # copy useful stuff needed for the vehicle to advance
-        fx = [tirelf_st._fx,tirerf_st._fx,tirelr_st._fx,tirerr_st._fx]
-        fy = [tirelf_st._fy,tirerf_st._fy,tirelr_st._fy,tirerr_st._fy]
-        huf = tirelf_st._rStat
-        hur = tirerr_st._rStat
-
-        # look at the vehicle go
-        rom.vehAdv(veh1_st,veh1_param,fx,fy,huf,hur)
-
-
-        #append timestep results
-        if(timeStepNo % 10 == 0):
-            result.append([t, veh1_st._x, veh1_st._y, veh1_st._u, veh1_st._v, veh1_st._phi,
-                            veh1_st._psi, veh1_st._wx, veh1_st._wz,tirelf_st._omega,
-                            tirerf_st._omega, tirelr_st._omega, tirerr_st._omega])
-
-        t += step
-        timeStepNo += 1
-    return result
+# the JSON files are parsed on the first call only, later calls copy the parsed parameters
+def model(theta,fileName,endTime):
+    out = rom.simulate(fileName_veh, fileName_tire, fileName, endTime, theta_params,
+                        np.asarray(theta[:len(theta_params)], dtype = np.float64), model_outputs)
+    # one row per output
+    return np.vstack([out[name][0] for name in model_outputs])
 
 
 
-#This is just a gaussian log likelihood
+#This is just a gaussian log likelihood - the simulations and the sums over the data run in C++
+# (rom.loglike), which reads the data files on the first call only and returns the mean over the files
 def loglike(theta,data):
+    sigmas = np.asarray(theta[-(data[0].shape[0]):], dtype = np.float64)
+    return rom.loglike(fileName_veh, fileName_tire, theta_params, np.asarray(theta[:len(theta_params)], dtype = np.float64),
+                        sigmas, fileName_con, endTimes, fileName_data, model_outputs)
+
+# model outputs along with their derivatives with respect to theta, from one run of the model on
+# dual numbers (rom.simulateGradient) instead of two runs per parameter for finite differences
+def model_grad(theta,fileName,endTime):
+    values, grads = rom.simulateGradient(fileName_veh, fileName_tire, fileName, endTime, theta_params,
+                        np.asarray(theta[:len(theta_params)], dtype = np.float64), model_outputs)
+    # (outputs, samples) and (outputs, len(theta_params), samples)
+    return np.vstack([values[name] for name in model_outputs]), np.stack([grads[name] for name in model_outputs])
+
+#The gradient of the log likelihood - Needed for gradient based methods
+def grad_loglike(theta,data):
     sigmas = np.array(theta[-(data[0].shape[0]):]).reshape(-1,1)
+    k = sigmas.shape[0]
+    grads = np.zeros(len(theta))
 
-    # print(theta)
-    likes = [None]*len(fileName_con)
-
-    # For each of the input controls, run the model and get the likelihood
     for i,fileName in enumerate(fileName_con):
         n = data[i].shape[1]
-        mod = model(theta,fileName,endTimes[i])
-        mod = np.array(mod)[:data[i].shape[1]].T # truncate the model output to how many ever points we have in the data
-        data_ = data[i]
-        likelihood = -np.sum(((n*np.log(2*np.pi * sigmas**2)/2) + np.sum((mod[[3,6],:] - data_)**2/(2.*sigmas**2)))/np.linalg.norm(data_,axis = 1))
-        # print(mod[[1,2],:])
-        likes[i] = likelihood
-
-
-    # just take the log like as the sum of our individual likes
-    return sum(likes)/len(likes)
-
-#The gradient of the log likelihood using finite differences - Needed for gradient based methods
-def grad_loglike(theta,data):
-	def ll(theta,data):
-		return loglike(theta,data)
-	
-	#We are not doing finite difference approximation and we define delx as the finite precision 
-	eps = np.sqrt(np.finfo(float).eps)
-	delx = eps * np.sqrt(np.abs(theta))
+        mod, dmod = model_grad(theta,fileName,endTimes[i])
+        res = mod[:,:n] - data[i]
+        dmod = dmod[:,:,:n]
+        # the likelihood of a file is -(W*sum(n*log(2*pi*sigma**2)/2) + k*W*S), with W the sum of the inverse
+        # norms of the data and S = sum((mod - data)**2/(2*sigma**2))
+        W = np.sum(1./np.linalg.norm(data[i],axis = 1))
+        grads[:len(theta_params)] += -k * W * np.einsum('os,ops->p', res / sigmas**2, dmod)
+        grads[-k:] += -W * n / sigmas[:,0] + k * W * np.sum(res**2, axis = 1) / sigmas[:,0]**3
 
-	return sp.optimize.approx_fprime(theta,ll,delx,data)
+    return grads/len(fileName_con)
 
 
 
@@ -300,6 +216,7 @@ if __name__ == "__main__":
 
     print(fileName_con)
     # open the data files
+    fileName_data = ["./data/" + f + "_shafts.npy" for f in [file1, file2, file3, file4, file5]]
     with open("./data/" + file1 + "_shafts.npy", 'rb') as f:
         file1_data = np.load(f)
     with open("./data/" + file2 + "_shafts.npy", 'rb') as f:
@@ -0,0 +1,56 @@
+import sys
+import struct
+import numpy as np
+
+"""
+Reader for the binary trajectory files written by Binary_writer (utils.h), e.g. the .bin
+outputs of sweep8DOF.
+
+    from read_trajectory import read_trajectory
+    traj = read_trajectory("../VM/outs/acc3.bin")
+    mpl.plot(traj["time"], traj["u"])
+
+Run as a script to print the fields and the number of rows of a file
+Command line arguments
+1) path to the .bin file
+"""
+
+
+def read_trajectory(fileName):
+    with open(fileName, 'rb') as f:
+        buf = f.read()
+
+    if buf[:8] != b"EDOFTRAJ":
+        raise ValueError(fileName + " is not a trajectory file")
+    version, value_size, decimation, num_fields = struct.unpack_from("<4I", buf, 8)
+    if version != 1:
+        raise ValueError("unknown trajectory file version {}".format(version))
+    dtype = np.dtype("<f4") if value_size == 4 else np.dtype("<f8")
+
+    pos = 24
+    names = []
+    for i in range(num_fields):
+        (length,) = struct.unpack_from("<I", buf, pos)
+        pos += 4
+        names.append(buf[pos:pos + length].decode())
+        pos += length
+
+    # every block holds rows for all the fields one after the other
+    columns = [[] for _ in names]
+    while pos + 4 <= len(buf):
+        (rows,) = struct.unpack_from("<I", buf, pos)
+        pos += 4
+        for k in range(num_fields):
+            columns[k].append(np.frombuffer(buf, dtype = dtype, count = rows, offset = pos))
+            pos += rows * value_size
+
+    traj = {}
+    for name, col in zip(names, columns):
+        traj[name] = np.concatenate(col) if len(col) > 0 else np.zeros(0, dtype = dtype)
+    return traj
+
+
+if __name__ == "__main__":
+    traj = read_trajectory(sys.argv[1])
+    for name, values in traj.items():
+        print(name, values.shape[0], values.dtype)
@@ -5,10 +5,120 @@
 #include <algorithm>
 #include <cmath>
 #include <stdint.h>
+#include <charconv>
+#include <cstring>
+#include <iterator>
+#include <filesystem>
+#include <chrono>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #include "utils.h"
 
 
 
+// skips the blanks that operator>> skips
+static const char* skipSpace(const char* p, const char* end){
+    while(p != end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\v' || *p == '\f')){
+        p++;
+    }
+    return p;
+}
+
+// reads one value like operator>> of an istream does, p is moved past it. from_chars does not
+// take a leading '+' but reads inf and nan, and it stops before an exponent without digits
+// where the stream fails - those cases are handled here so that both agree
+static bool parseValue(const char*& p, const char* end, double& v){
+    p = skipSpace(p, end);
+    const char* q = p;
+    if(p != end && *p == '+'){
+        p++;
+        q = p;
+    }
+    else if(p != end && *p == '-'){
+        q = p + 1;
+    }
+    if(q == end || !((*q >= '0' && *q <= '9') || *q == '.')){
+        return false;
+    }
+    std::from_chars_result r = std::from_chars(p, end, v);
+    if(r.ec != std::errc() || (r.ptr != end && (*r.ptr == 'e' || *r.ptr == 'E'))){
+        return false;
+    }
+    p = r.ptr;
+    return true;
+}
+
+// one line of a driver input file - false if it does not hold the 4 values
+static bool parseEntry(Entry& entry, const char* begin, const char* end){
+    double time, steering, throttle, braking;
+    if(!parseValue(begin, end, time) || !parseValue(begin, end, steering) ||
+       !parseValue(begin, end, throttle) || !parseValue(begin, end, braking)){
+        return false;
+    }
+    entry = Entry(time,steering,throttle,braking);
+    return true;
+}
+
+static bool parseEntry(Entry& entry, const std::string& line){
+    return parseEntry(entry, line.data(), line.data() + line.size());
+}
+
+// read only view of a whole file, memory mapped where possible
+class MappedFile {
+  public:
+    explicit MappedFile(const std::string& filename) : m_data(nullptr), m_size(0), m_mapped(false) {
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = open(filename.c_str(), O_RDONLY);
+        if(fd < 0){
+            return;
+        }
+        struct stat st;
+        if(fstat(fd, &st) == 0 && st.st_size > 0){
+            void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(p != MAP_FAILED){
+                madvise(p, st.st_size, MADV_SEQUENTIAL);
+                m_data = (const char*)p;
+                m_size = st.st_size;
+                m_mapped = true;
+            }
+        }
+        close(fd);
+        if(m_mapped){
+            return;
+        }
+#endif
+        // no mmap - read the file into memory
+        std::ifstream ifile(filename.c_str(), std::ios::binary);
+        m_copy.assign(std::istreambuf_iterator<char>(ifile), std::istreambuf_iterator<char>());
+        m_data = m_copy.data();
+        m_size = m_copy.size();
+    }
+
+    ~MappedFile(){
+#if defined(__unix__) || defined(__APPLE__)
+        if(m_mapped){
+            munmap((void*)m_data, m_size);
+        }
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* begin() const { return m_data; }
+    const char* end() const { return m_data + m_size; }
+
+  private:
+    const char* m_data;
+    size_t m_size;
+    bool m_mapped;
+    std::string m_copy;
+};
+
 /// Driver inputs from data file.
 /// A driver model based on user inputs provided as time series. If provided as a
 /// text file, each line in the file must contain 4 values:
@@ -16,27 +126,25 @@
 /// It is assumed that the time values are unique and soted from 0 to T
 void driverInput(std::vector <Entry>& m_data ,const std::string& filename){
 
-    std::ifstream ifile(filename.c_str());
-    std::string line;
+    MappedFile file(filename);
 
-    
-    // get each line
-    while(std::getline(ifile,line)){
-        std::istringstream iss(line);
-        
-        double time, steering, throttle, braking;
-
-        // put the stream into our varaibles
-        iss >> time >> steering >> throttle >> braking;
-
-        if (iss.fail())
+    // each line, the last one need not end with a newline. Reading stops at the first
+    // line that does not hold the 4 values, like getline and an istringstream did
+    Entry entry;
+    const char* p = file.begin();
+    const char* end = file.end();
+    while(p != end){
+        const char* eol = (const char*)std::memchr(p, '\n', end - p);
+        if(!eol){
+            eol = end;
+        }
+        if(!parseEntry(entry, p, eol))
             break;
 
         // push into our structure
-        m_data.push_back(Entry(time,steering,throttle,braking));
+        m_data.push_back(entry);
+        p = (eol == end) ? end : eol + 1;
     }
-
-    ifile.close();
 }
 
 
@@ -44,7 +152,11 @@ void driverInput(std::vector <Entry>& m_data ,const std::string& filename){
 /// Function to get the vehicle controls at a given time
 /// need to pass the data as well
 
-void getControls(std::vector <double>& controls, std::vector<Entry>& m_data, const double time){
+void getControls(std::vector <double>& controls, const std::vector<Entry>& m_data, const double time){
+    getControls(controls.data(), m_data, time);
+}
+
+void getControls(double* controls, const std::vector<Entry>& m_data, const double time){
     
     // if its before time or after time
     if(time <= m_data[0].m_time){
@@ -64,10 +176,10 @@ void getControls(std::vector <double>& controls, std::vector<Entry>& m_data, con
     // if its within the time, get an iterator and do linear interpolation
     // use compare fucntion earlier defined
 
-    std::vector<Entry>::iterator right =
+    std::vector<Entry>::const_iterator right =
         std::lower_bound(m_data.begin(), m_data.end(), Entry(time,0,0,0), compareTime); // return first value after Entry
     
-    std::vector<Entry>::iterator left = right - 1;
+    std::vector<Entry>::const_iterator left = right - 1;
 
     // linear interplolation
     
@@ -79,6 +191,121 @@ void getControls(std::vector <double>& controls, std::vector<Entry>& m_data, con
     controls[3] = left->m_braking + tbar * (right->m_braking - left->m_braking);
 }
 
+
+Driver_input::Driver_input(const std::vector<Entry>& data)
+    : m_data(&data), m_chunk(0), m_base(0), m_cur(1), m_eof(true), m_has_first(!data.empty()) {
+    if(m_has_first){
+        m_first = data[0];
+    }
+}
+
+Driver_input::Driver_input(const std::string& filename, size_t chunk_size)
+    : m_data(nullptr), m_filename(filename), m_chunk(std::max<size_t>(chunk_size, 1)),
+      m_base(0), m_cur(1), m_eof(false), m_has_first(false) {
+    m_window.reserve(m_chunk + 1);
+    restart();
+    if(!m_window.empty()){
+        m_first = m_window[0];
+        m_has_first = true;
+    }
+}
+
+void Driver_input::restart(){
+    m_file.close();
+    m_file.clear();
+    m_file.open(m_filename.c_str());
+    m_window.clear();
+    m_base = 0;
+    m_cur = 1;
+    m_eof = false;
+    read_chunk();
+}
+
+void Driver_input::read_chunk(){
+    // keep the last entry, it is the left end of the segment that continues into the new chunk
+    if(m_window.size() > 1){
+        size_t dropped = m_window.size() - 1;
+        m_window.erase(m_window.begin(), m_window.end() - 1);
+        m_base += dropped;
+        m_cur = 1;
+    }
+
+    std::string line;
+    Entry entry;
+    for(size_t n = 0; n < m_chunk; n++){
+        // the file ends at the first line that is not an entry, as in driverInput
+        if(!std::getline(m_file, line) || !parseEntry(entry, line)){
+            m_eof = true;
+            m_file.close();
+            return;
+        }
+        m_window.push_back(entry);
+    }
+}
+
+void Driver_input::setPosition(size_t position){
+    // when streaming only the entries in memory can be moved to, the next lookup finds the others
+    if(position >= m_base && position - m_base < entries().size()){
+        m_cur = position - m_base;
+    }
+}
+
+void Driver_input::getControls(double* controls, const double time){
+    controls[0] = time;
+    if(!m_has_first){
+        controls[1] = controls[2] = controls[3] = 0.;
+        return;
+    }
+
+    // before the first entry
+    if(time <= m_first.m_time){
+        controls[1] = m_first.m_steering;
+        controls[2] = m_first.m_throttle;
+        controls[3] = m_first.m_braking;
+        return;
+    }
+
+    // when streaming, get the entries around time into memory - reading until an entry is
+    // after time tells whether the last one in memory is also the last one of the file
+    if(!m_data){
+        if(m_base > 0 && time <= m_window[0].m_time){
+            restart();
+        }
+        while(!m_eof && m_window.back().m_time <= time){
+            read_chunk();
+        }
+    }
+
+    const std::vector<Entry>& e = entries();
+
+    // after the last entry
+    if(m_eof && time >= e.back().m_time){
+        controls[1] = e.back().m_steering;
+        controls[2] = e.back().m_throttle;
+        controls[3] = e.back().m_braking;
+        return;
+    }
+
+    // e[0] is before time and e.back() after it. Move the cursor to the first entry that is
+    // not before time - the entry lower_bound finds in getControls
+    size_t i = std::min(std::max<size_t>(m_cur, 1), e.size() - 1);
+    while(e[i].m_time < time){
+        i++;
+    }
+    while(e[i - 1].m_time >= time){
+        i--;
+    }
+    m_cur = i;
+
+    const Entry& left = e[i - 1];
+    const Entry& right = e[i];
+    double tbar = (time - left.m_time) / (right.m_time - left.m_time);
+
+    controls[1] = left.m_steering + tbar * (right.m_steering - left.m_steering);
+    controls[2] = left.m_throttle + tbar * (right.m_throttle - left.m_throttle);
+    controls[3] = left.m_braking + tbar * (right.m_braking - left.m_braking);
+}
+
 // sine step function for some smoothing operations
 double sineStep(double x, double x1, double y1, double x2, double y2){
     if (x <= x1)
@@ -93,7 +320,7 @@ double sineStep(double x, double x1, double y1, double x2, double y2){
 }
 
 
-double getMapY(std::vector<MapEntry>& map, const double x){
+double getMapY(const std::vector<MapEntry>& map, const double x){
     // if speed is less than or more than the min max, return the min max
     if(x <= map[0]._x){
         return map[0]._y;
@@ -104,10 +331,10 @@ double getMapY(std::vector<MapEntry>& map, const double x){
     // if its within the time, get an iterator and do linear interpolation
     // use compare fucntion earlier defined
 
-    std::vector<MapEntry>::iterator right =
+    std::vector<MapEntry>::const_iterator right =
         std::lower_bound(map.begin(), map.end(), MapEntry(x,0), compareRPM); // return first value after Entry
     
-    std::vector<MapEntry>::iterator left = right - 1;
+    std::vector<MapEntry>::const_iterator left = right - 1;
 
     // linear interplolation
     
@@ -117,6 +344,258 @@ double getMapY(std::vector<MapEntry>& map, const double x){
 }
 
 
+bool mapLUTInit(MapLUT& lut, const std::vector<MapEntry>& map){
+    lut = MapLUT();
+    unsigned int n = map.size();
+    if(n < 2){
+        return false;
+    }
+
+    // smallest spacing between the breakpoints
+    double min_dx = map[1]._x - map[0]._x;
+    for(unsigned int i = 1; i < n - 1; i++){
+        min_dx = std::min(min_dx, map[i+1]._x - map[i]._x);
+    }
+    double range = map.back()._x - map[0]._x;
+    if(!(min_dx > 0.) || (range / min_dx) > MAX_LUT_CELLS){
+        return false;
+    }
+
+    unsigned int cells = (unsigned int)std::ceil(range / min_dx);
+    if(cells < 1){
+        cells = 1;
+    }
+    lut._x0 = map[0]._x;
+    lut._invDx = cells / range;
+    lut._n = n;
+    lut._seg.resize(cells);
+
+    // segment i holds x if map[i]._x < x <= map[i+1]._x - same as the lower_bound in getMapY
+    unsigned int i = 0;
+    for(unsigned int c = 0; c < cells; c++){
+        double x = map[0]._x + c * (range / cells);
+        while(i + 2 < n && map[i+1]._x < x){
+            i++;
+        }
+        lut._seg[c] = i;
+    }
+    return true;
+}
+
+
+double getMapY(const std::vector<MapEntry>& map, const MapLUT& lut, const double x){
+    // grid not built or built for some other map
+    if(lut._n != map.size() || lut._seg.empty()){
+        return getMapY(map, x);
+    }
+
+    if(x <= map[0]._x){
+        return map[0]._y;
+    } else if(x >= map.back()._x){
+        return map.back()._y;
+    }
+
+    // cell of x and then the segment - at most one breakpoint lies inside a cell so this
+    // moves at most one step unless the map was changed after the grid was built
+    unsigned int c = (unsigned int)((x - lut._x0) * lut._invDx);
+    if(c >= lut._seg.size()){
+        c = lut._seg.size() - 1;
+    }
+    unsigned int i = lut._seg[c];
+    unsigned int n = map.size();
+    while(i + 2 < n && map[i+1]._x < x){
+        i++;
+    }
+    while(i > 0 && map[i]._x >= x){
+        i--;
+    }
+
+    // linear interplolation - same as getMapY
+    const MapEntry& left = map[i];
+    const MapEntry& right = map[i+1];
+    double mbar = (x - left._x) / (right._x - left._x);
+
+    return (left._y + mbar * (right._y - left._y));
+}
+
+
+/////////////////////////////////////////////////////////////////////// Binary_writer ///////////////////////////////////////////////////////////
+
+// copies n bytes of a value into dst in little endian order
+static void toLittleEndian(char* dst, const void* src, size_t n){
+    const uint16_t one = 1;
+    const char* s = (const char*)src;
+    if(*(const char*)&one == 1){
+        std::copy(s, s + n, dst);
+    }
+    else{
+        std::reverse_copy(s, s + n, dst);
+    }
+}
+
+static void writeUint32(std::ofstream& file, uint32_t v){
+    char b[4];
+    toLittleEndian(b, &v, 4);
+    file.write(b, 4);
+}
+
+Binary_writer::Binary_writer(const std::string& filename, const std::vector<std::string>& fields,
+                             unsigned int decimation, bool single, unsigned int block_rows)
+    : m_file(filename.c_str(), std::ios::binary), m_num_fields(fields.size()),
+      m_decimation(decimation == 0 ? 1 : decimation), m_value_size(single ? 4 : 8),
+      m_block_rows(block_rows == 0 ? 1 : block_rows), m_rows(0), m_count(0),
+      m_buffer(size_t(m_num_fields) * m_block_rows * m_value_size) {
+
+    m_file.write("EDOFTRAJ", 8);
+    writeUint32(m_file, 1);
+    writeUint32(m_file, m_value_size);
+    writeUint32(m_file, m_decimation);
+    writeUint32(m_file, m_num_fields);
+    for(const std::string& f : fields){
+        writeUint32(m_file, f.size());
+        m_file.write(f.data(), f.size());
+    }
+}
+
+Binary_writer::~Binary_writer(){
+    close();
+}
+
+void Binary_writer::write(const double* row){
+    if(!m_file.is_open() || (m_count++ % m_decimation) != 0){
+        return;
+    }
+    for(unsigned int f = 0; f < m_num_fields; f++){
+        char* dst = &m_buffer[(size_t(f) * m_block_rows + m_rows) * m_value_size];
+        if(m_value_size == 4){
+            float v = row[f];
+            toLittleEndian(dst, &v, 4);
+        }
+        else{
+            toLittleEndian(dst, &row[f], 8);
+        }
+    }
+    m_rows++;
+    if(m_rows == m_block_rows){
+        flush();
+    }
+}
+
+void Binary_writer::flush(){
+    if(m_rows == 0 || !m_file.is_open()){
+        return;
+    }
+    writeUint32(m_file, m_rows);
+    for(unsigned int f = 0; f < m_num_fields; f++){
+        m_file.write(&m_buffer[size_t(f) * m_block_rows * m_value_size], size_t(m_rows) * m_value_size);
+    }
+    m_rows = 0;
+}
+
+void Binary_writer::close(){
+    if(m_file.is_open()){
+        flush();
+        m_file.close();
+    }
+}
+
 
+/////////////////////////////////////////////////////////////////////// driver input cache ///////////////////////////////////////////////////////////
 
+// sidecar layout (little endian) - "EDOFINPT", uint32 version, uint64 size and int64
+// modification time of the text file, uint64 number of entries, then the 4 values of each entry
+static const char CACHE_MAGIC[8] = {'E', 'D', 'O', 'F', 'I', 'N', 'P', 'T'};
+static const uint32_t CACHE_VERSION = 1;
+static const size_t CACHE_HEADER = 8 + 4 + 8 + 8 + 8;
 
+// toLittleEndian swaps the bytes on big endian machines, so it also converts back
+template <typename V>
+static V fromLittleEndian(const char* src){
+    V v;
+    toLittleEndian((char*)&v, src, sizeof(V));
+    return v;
+}
+
+static bool loadInputCache(std::vector<Entry>& m_data, const std::string& cacheName,
+                           uint64_t size, int64_t mtime){
+    MappedFile file(cacheName);
+    const char* p = file.begin();
+    size_t bytes = file.end() - file.begin();
+    if(bytes < CACHE_HEADER || !std::equal(CACHE_MAGIC, CACHE_MAGIC + 8, p) ||
+       fromLittleEndian<uint32_t>(p + 8) != CACHE_VERSION ||
+       fromLittleEndian<uint64_t>(p + 12) != size || fromLittleEndian<int64_t>(p + 20) != mtime){
+        return false;
+    }
+    uint64_t n = fromLittleEndian<uint64_t>(p + 28);
+    if(bytes != CACHE_HEADER + n * 4 * sizeof(double)){
+        return false;
+    }
+    p += CACHE_HEADER;
+    m_data.reserve(m_data.size() + n);
+    for(uint64_t i = 0; i < n; i++, p += 4 * sizeof(double)){
+        m_data.push_back(Entry(fromLittleEndian<double>(p), fromLittleEndian<double>(p + 8),
+                               fromLittleEndian<double>(p + 16), fromLittleEndian<double>(p + 24)));
+    }
+    return true;
+}
+
+// written to a temporary file that is then renamed, so that a run reading the sidecar
+// at the same time never sees half of it. Failing to write it (read only folder) is not an error
+static void writeInputCache(const std::vector<Entry>& entries, const std::string& cacheName,
+                            uint64_t size, int64_t mtime){
+    std::vector<char> buf(CACHE_HEADER + entries.size() * 4 * sizeof(double));
+    char* p = buf.data();
+    uint64_t n = entries.size();
+    std::copy(CACHE_MAGIC, CACHE_MAGIC + 8, p);
+    toLittleEndian(p + 8, &CACHE_VERSION, 4);
+    toLittleEndian(p + 12, &size, 8);
+    toLittleEndian(p + 20, &mtime, 8);
+    toLittleEndian(p + 28, &n, 8);
+    p += CACHE_HEADER;
+    for(const Entry& e : entries){
+        toLittleEndian(p, &e.m_time, 8);
+        toLittleEndian(p + 8, &e.m_steering, 8);
+        toLittleEndian(p + 16, &e.m_throttle, 8);
+        toLittleEndian(p + 24, &e.m_braking, 8);
+        p += 4 * sizeof(double);
+    }
+
+    std::error_code ec;
+    std::string tmpName = cacheName + ".tmp" +
+        std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+    {
+        std::ofstream out(tmpName.c_str(), std::ios::binary);
+        if(!out.write(buf.data(), buf.size())){
+            out.close();
+            std::filesystem::remove(tmpName, ec);
+            return;
+        }
+    }
+    std::filesystem::rename(tmpName, cacheName, ec);
+    if(ec){
+        std::filesystem::remove(tmpName, ec);
+    }
+}
+
+void driverInput(std::vector <Entry>& m_data, const std::string& filename, bool cache){
+    std::error_code ec;
+    uint64_t size = std::filesystem::file_size(filename, ec);
+    int64_t mtime = 0;
+    if(!ec){
+        mtime = std::filesystem::last_write_time(filename, ec).time_since_epoch().count();
+    }
+    if(!cache || ec){
+        driverInput(m_data, filename);
+        return;
+    }
+
+    std::string cacheName = filename + ".edofcache";
+    if(loadInputCache(m_data, cacheName, size, mtime)){
+        return;
+    }
+
+    std::vector<Entry> entries;
+    driverInput(entries, filename);
+    writeInputCache(entries, cacheName, size, mtime);
+    m_data.insert(m_data.end(), entries.begin(), entries.end());
+}
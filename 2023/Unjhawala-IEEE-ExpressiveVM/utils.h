@@ -61,6 +61,11 @@ struct TiRainMapEntry{
 /// Driver inputs from data file.
 void driverInput(std::vector <Entry>& m_data ,const std::string& filename);
 
+/// Same as above, but with cache the entries are also kept in a binary sidecar file
+/// (filename + ".edofcache") that later calls load without any parsing. The sidecar records
+/// the size and modification time of the text file and is rebuilt when either changes
+void driverInput(std::vector <Entry>& m_data, const std::string& filename, bool cache);
+
 /// function needed to compare times for driver input
 inline bool compareTime(const Entry& a, const Entry& b){ return a.m_time < b.m_time; };
 
@@ -68,17 +73,94 @@ inline bool compareTime(const Entry& a, const Entry& b){ return a.m_time < b.m_t
 inline bool compareRPM(const MapEntry& a, const MapEntry& b){return a._x < b._x; };
 
 /// fucntion to get the Y of the map by linear interpolation
-double getMapY(std::vector<MapEntry>& map, const double x);
+double getMapY(const std::vector<MapEntry>& map, const double x);
+
+/// Uniform grid over the x range of a map. Each cell stores the segment of the map that
+/// holds the start of the cell, so that the segment of any x is found with one multiply
+/// and an index instead of a binary search. The interpolation itself still uses the
+/// original breakpoints, so the result is exactly that of getMapY
+struct MapLUT{
+    MapLUT() : _x0(0.), _invDx(0.), _n(0) {}
+
+    double _x0; // x of the first breakpoint
+    double _invDx; // 1 / width of a cell
+    unsigned int _n; // size of the map the grid was built for
+    std::vector<unsigned int> _seg; // left breakpoint of the segment at the start of each cell
+};
+
+/// Maximum number of cells of a MapLUT - maps that would need more are considered irregular
+static const unsigned int MAX_LUT_CELLS = 4096;
+
+/// Builds the uniform grid of a map. The cell width is the smallest breakpoint spacing so
+/// that a cell holds at most one breakpoint. Returns false and leaves the grid empty if the
+/// map is too irregular (or not strictly increasing) - getMapY then falls back to the binary search
+bool mapLUTInit(MapLUT& lut, const std::vector<MapEntry>& map);
+
+/// getMapY using the uniform grid of the map
+double getMapY(const std::vector<MapEntry>& map, const MapLUT& lut, const double x);
 
 /// Function to get the vehicle controls at a given time
 /// need to pass the data as well
-void getControls(std::vector <double>& controls, std::vector<Entry>& m_data, const double time);
+void getControls(std::vector <double>& controls, const std::vector<Entry>& m_data, const double time);
+
+/// Same as above but writes the 4 controls (time, steering, throttle, braking) into
+/// a plain array so that no vector is needed
+void getControls(double* controls, const std::vector<Entry>& m_data, const double time);
+
+/// Driver inputs looked up at increasing times. A cursor stays on the segment of the last
+/// lookup and only moves forward from there, so a whole run costs amortized O(1) per step
+/// instead of a binary search every step. The controls are exactly those of getControls.
+/// Earlier times still work - the cursor moves back. The entries either live in a vector
+/// (not copied, it has to outlive the Driver_input) or are streamed from a file in chunks,
+/// in which case only about chunk_size entries are in memory. The file is parsed like
+/// driverInput does, and going back to before the entries in memory reads it again from the start
+class Driver_input {
+  public:
+    explicit Driver_input(const std::vector<Entry>& data);
+    explicit Driver_input(const std::string& filename, size_t chunk_size = 4096);
+
+    Driver_input(const Driver_input&) = delete;
+    Driver_input& operator=(const Driver_input&) = delete;
+
+    /// false if there are no entries (for example the file could not be read)
+    bool good() const { return m_has_first; }
+
+    /// controls (time, steering, throttle, braking) at the given time
+    void getControls(double* controls, const double time);
+    void getControls(std::vector<double>& controls, const double time) { getControls(controls.data(), time); }
+
+    /// index of the entry the cursor is on. setPosition puts the cursor of this or of another
+    /// Driver_input over the same entries there, e.g. when a saved simulation state is restored.
+    /// Any position gives the same controls, a good one only saves moving the cursor
+    size_t position() const { return m_base + m_cur; }
+    void setPosition(size_t position);
+
+  private:
+    // reads the next chunk of the file - all but the last entry already in memory are dropped
+    void read_chunk();
+    // back to the start of the file
+    void restart();
+    const std::vector<Entry>& entries() const { return m_data ? *m_data : m_window; }
+
+    const std::vector<Entry>* m_data; // entries in memory, null when streaming
+    std::vector<Entry> m_window;      // entries of the file in memory
+    std::ifstream m_file;
+    std::string m_filename;
+    size_t m_chunk;
+    size_t m_base;                    // index in the file of m_window[0]
+    size_t m_cur;                     // first entry with time >= the time of the last lookup
+    bool m_eof;                       // all entries are in memory
+    bool m_has_first;
+    Entry m_first;
+};
 
-// linear interpolation function
-inline double InterpL(double fz, double w1, double w2, double pn) { return w1 + (w2 - w1) * (fz / pn - 1.); }
+// linear interpolation function - the weights and pn may be of another scalar type P than fz
+template <typename T, typename P>
+inline T InterpL(T fz, P w1, P w2, P pn) { return w1 + (w2 - w1) * (fz / pn - T(1.)); }
 
 // quadratic interpolation function
-inline double InterpQ(double fz, double w1, double w2, double pn) { return (fz/pn) * (2. * w1 - 0.5 * w2 - (w1 - 0.5 * w2) * (fz/pn)); }
+template <typename T, typename P>
+inline T InterpQ(T fz, P w1, P w2, P pn) { return (fz/pn) * (P(2.) * w1 - P(0.5) * w2 - (w1 - P(0.5) * w2) * (fz/pn)); }
 
 // temlate safe signum function 
 template <typename T> int sgn(T val) {
@@ -154,4 +236,49 @@ inline CSV_writer& operator<<(CSV_writer& out, const std::vector<T>& vec) {
 }
 
 
-#endif
\ No newline at end of file
+/// Streaming trajectory writer. Rows are kept in a fixed size buffer and written to the
+/// file one block at a time, so memory does not grow with the length of the run.
+/// File layout (all little endian):
+///   header - "EDOFTRAJ", uint32 version, uint32 bytes per value (4 or 8), uint32 decimation,
+///            uint32 number of fields, then for each field a uint32 length and the name
+///   blocks - uint32 number of rows, then each field's values for those rows one after the other
+/// plotting/read_trajectory.py reads these files back into numpy arrays
+class Binary_writer {
+  public:
+    /// fields - names of the values in a row, decimation - only every decimation-th row is
+    /// kept, single - store float32 instead of float64, block_rows - rows per block
+    Binary_writer(const std::string& filename, const std::vector<std::string>& fields,
+                  unsigned int decimation = 1, bool single = false, unsigned int block_rows = 1024);
+
+    /// flushes and closes the file
+    ~Binary_writer();
+
+    Binary_writer(const Binary_writer&) = delete;
+    Binary_writer& operator=(const Binary_writer&) = delete;
+
+    /// adds one row - row has one value per field in the order given to the constructor
+    void write(const double* row);
+    void write(const std::vector<double>& row) { write(row.data()); }
+
+    /// writes the rows in the buffer as a block
+    void flush();
+
+    /// flushes and closes the file, nothing can be written afterwards
+    void close();
+
+    bool good() const { return m_file.good(); }
+    unsigned int num_fields() const { return m_num_fields; }
+
+  private:
+    std::ofstream m_file;
+    unsigned int m_num_fields;
+    unsigned int m_decimation;
+    unsigned int m_value_size;  // 4 or 8 bytes
+    unsigned int m_block_rows;
+    unsigned int m_rows;        // rows in the buffer
+    unsigned long m_count;      // rows given to write, kept or not
+    std::vector<char> m_buffer; // little endian values, field after field
+};
+
+
+#endif